@@ -77,11 +77,10 @@ public:
   ~thread_guard()
   {
     std::cout<<"ʼ"<<std::endl;
-//    if(t.joinable()) // 1
-//    {
-    assert(t.joinable());
+    if(t.joinable()) // 1 ߳̿Ѿڱ𴦻룬assertڷв
+    {
       t.join();      // 2
-//    }
+    }
   }
   thread_guard(thread_guard const&)=delete;   // 3
   thread_guard& operator=(thread_guard const&)=delete;
@@ -1,5 +1,12 @@
 #include <iostream>
 #include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <cassert>
+#include <stdexcept>
+#include "thread_group.h"
 
 void some_function()
 {
@@ -98,6 +105,97 @@ void scope()
   std::cout<<"scope"<<std::endl;
 } // 5
 
+///䣺һ̣߳Ǽʱͣ
+/*
+ﳣмʮ̣߳رʱҪȫͣ²롣thread_group(include/thread_group.h)
+Ϊÿ̴߳stop_tokenѭÿּһstop_requested()ֻһԭӶ
+ϵ߳interruptible_wait()ֹͣʱᱻصѡ
+*/
+struct stoppable_func
+{
+  int& i;
+  stoppable_func(int& i_) : i(i_) {}
+  void operator() (stop_token token)
+  {
+    for(;;)  // funcͬѭһֱܵҪֹͣ
+    {
+      for (unsigned j=0 ; j<1000000 && !token.stop_requested() ; ++j)
+        ++i;
+      if(token.stop_requested())
+        return;
+    }
+  }
+};
+
+void thread_group_example()
+{
+  std::mutex m;
+  std::condition_variable cond;
+  std::queue<int> jobs;
+  std::vector<int> counters(8);
+
+  thread_group group;
+  for(auto& c : counters)
+    group.create_thread(stoppable_func(c));
+  for(unsigned i=0;i<8;++i)
+  {
+    group.create_thread([&](stop_token token)
+    {
+      std::unique_lock<std::mutex> lk(m);
+      while(interruptible_wait(cond,lk,token,[&]{return !jobs.empty();}))  // ûʱһֱ
+        jobs.pop();
+    });
+  }
+  group.create_thread(some_function);  // Ҫstop_token̺߳ճʹ
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  thread_group::shutdown_report const report=group.stop_and_join();
+  auto const us=[](thread_group::clock::duration d)
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  };
+  std::cout<<group.size()<<" threads stopped in "<<us(report.total)<<"us, slowest #"
+           <<report.slowest<<" ("<<us(report.per_thread[report.slowest])<<"us)"<<std::endl;
+}
+
+/*
+pred()Ҳ׳쳣interruptible_wait()ǼǵĻصԼջ֡ϣ
+쳣뿪ʱͬ᳷֮request_stop()ѾٵĶ
+*/
+void throwing_predicate_example()
+{
+  std::mutex m;
+  std::condition_variable cond;
+  bool broken=false;
+  stop_source source;
+  std::thread waiter([&]
+  {
+    std::unique_lock<std::mutex> lk(m);
+    try
+    {
+      interruptible_wait(cond,lk,source.get_token(),[&]
+      {
+        if(broken)
+          throw std::runtime_error("queue broken");
+        return false;
+      });
+      assert(false);
+    }
+    catch(std::runtime_error const&)
+    {
+      assert(lk.owns_lock());  // һ쳣뿪ʱlkȻ
+    }
+  });
+  {
+    std::lock_guard<std::mutex> lk(m);
+    broken=true;
+  }
+  cond.notify_all();
+  waiter.join();
+  assert(source.request_stop());  // صѾûжԵ
+  std::cout<<"throwing predicate unlinked"<<std::endl;
+}
+
 int main()
 {
     std::thread t1(some_function);            // 1
@@ -148,5 +246,7 @@ std::thread
     Ѽ˹캯Тڣҵ̲߳ɻʱ׳쳣
     */
     scope();
+    thread_group_example();
+    throwing_predicate_example();
     return 0;
 }
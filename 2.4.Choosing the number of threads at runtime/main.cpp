@@ -75,11 +75,134 @@ T parallel_accumulate(Iterator first,Iterator last,T init)
     return std::accumulate(results.begin(),results.end(),init); // 11нۼ
 }
 
+///䣺ͬķֿ鷽ʵֵ㷨
+/*
+include/parallel_algorithms.hparallel_accumulateķֿ鷽ʵaccumulatefor_eachtransform
+findpartial_sumpartitionsort齻ִ̳߳СݺͶӦstd::㷨
+ȽϽٷֱ1hardware_concurrency()߳(̳߳صĹ߳ϵ߳)ʱ
+*/
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include "parallel_algorithms.h"
+
+void parallel_algorithms_test(thread_pool& pool,std::size_t n)
+{
+    std::mt19937 gen(static_cast<unsigned>(n));
+    std::vector<int> data(n);
+    for(auto& x : data)
+        x=static_cast<int>(gen()%1000);
+
+    assert(parallel_accumulate(pool,data.begin(),data.end(),0L)==std::accumulate(data.begin(),data.end(),0L));
+
+    std::vector<int> expected=data,actual=data;
+    std::for_each(expected.begin(),expected.end(),[](int& x){x=x*3+1;});
+    parallel_for_each(pool,actual.begin(),actual.end(),[](int& x){x=x*3+1;});
+    assert(actual==expected);
+
+    std::vector<long> squares(n),expected_squares(n);
+    std::transform(data.begin(),data.end(),expected_squares.begin(),[](int x){return long(x)*x;});
+    auto const out=parallel_transform(pool,data.begin(),data.end(),squares.begin(),[](int x){return long(x)*x;});
+    assert(squares==expected_squares && out==squares.end());
+
+    for(int value : {-1,0,500,999})
+    {
+        assert(parallel_find(pool,data.begin(),data.end(),value)==std::find(data.begin(),data.end(),value));
+    }
+    if(n)
+    {
+        int const last_value=data.back();
+        assert(parallel_find(pool,data.begin(),data.end(),last_value)==std::find(data.begin(),data.end(),last_value));
+    }
+
+    std::vector<long> sums(n),expected_sums(n);
+    std::partial_sum(squares.begin(),squares.end(),expected_sums.begin());
+    parallel_partial_sum(pool,squares.begin(),squares.end(),sums.begin());
+    assert(sums==expected_sums);
+    parallel_partial_sum(pool,squares.begin(),squares.end(),squares.begin());  // ԭؼ
+    assert(squares==expected_sums);
+
+    auto const is_even=[](int x){return x%2==0;};
+    std::vector<int> partitioned=data;
+    auto const mid=parallel_partition(pool,partitioned.begin(),partitioned.end(),is_even);
+    assert(mid-partitioned.begin()==std::count_if(data.begin(),data.end(),is_even));
+    assert(std::all_of(partitioned.begin(),mid,is_even) && std::none_of(mid,partitioned.end(),is_even));
+    std::vector<int> sorted_data=data,sorted_partitioned=partitioned;
+    std::sort(sorted_data.begin(),sorted_data.end());
+    std::sort(sorted_partitioned.begin(),sorted_partitioned.end());
+    assert(sorted_data==sorted_partitioned);  // ֻ
+
+    std::vector<int> sorted=data;
+    parallel_sort(pool,sorted.begin(),sorted.end(),std::greater<int>());
+    std::reverse(sorted.begin(),sorted.end());
+    assert(sorted==sorted_data);
+}
+
+template<typename Function>
+double elapsed_ms(Function f)
+{
+    auto const start=std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+}
+
+void parallel_algorithms_example()
+{
+    for(unsigned workers=0;workers<4;++workers)
+    {
+        thread_pool pool(workers);
+        for(std::size_t n : {0u,1u,24u,25u,26u,100u,1001u,100000u})
+            parallel_algorithms_test(pool,n);
+    }
+
+    thread_pool pool(3);
+    std::vector<int> small(1000,1);  // һڹִ߳У׳쳣ᴫ
+    try
+    {
+        parallel_for_each(pool,small.begin(),small.end(),[&small](int& x){if(&x==&small[10]) throw std::runtime_error("bad element");});
+        assert(false);
+    }
+    catch(std::runtime_error const&)
+    {}
+    std::vector<std::future<int>> nested;  // й̶߳ڳеȴʱҲ
+    for(int i=0;i<4;++i)
+        nested.push_back(pool.submit([&pool]{
+            std::vector<int> v(1000,1);
+            parallel_for_each(pool,v.begin(),v.end(),[](int& x){++x;});
+            return std::accumulate(v.begin(),v.end(),0);
+        }));
+    for(auto& f : nested)
+        assert(f.get()==2000);
+
+    std::size_t const n=4000000;
+    std::vector<double> input(n),output(n);
+    std::mt19937 gen(42);
+    for(auto& x : input)
+        x=std::uniform_real_distribution<double>(0,1)(gen);
+    unsigned const max_threads=std::max(2u,std::thread::hardware_concurrency());
+    std::cout<<n<<" elements, ms (for_each/transform/find/partial_sum/partition/sort)"<<std::endl;
+    for(unsigned threads=1;threads<=max_threads;++threads)
+    {
+        thread_pool pool(threads-1);  // ߳Ҳһ
+        std::vector<double> work=input;
+        std::cout<<"  "<<threads<<" threads:"
+                 <<" "<<elapsed_ms([&]{parallel_for_each(pool,work.begin(),work.end(),[](double& x){x=x*x+1.0;});})
+                 <<" "<<elapsed_ms([&]{parallel_transform(pool,input.begin(),input.end(),output.begin(),[](double x){return x*0.5;});})
+                 <<" "<<elapsed_ms([&]{parallel_find(pool,input.begin(),input.end(),2.0);})  // Ҳɨȫ
+                 <<" "<<elapsed_ms([&]{parallel_partial_sum(pool,input.begin(),input.end(),output.begin());})
+                 <<" "<<elapsed_ms([&]{parallel_partition(pool,work.begin(),work.end(),[](double x){return x<1.5;});})
+                 <<" "<<elapsed_ms([&]{parallel_sort(pool,work.begin(),work.end());})<<std::endl;
+    }
+}
+
 int main()
 {
     std::vector<int> data{1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17};
     int ret = 0;
     ret = parallel_accumulate(data.begin(), data.end(), ret);
     std::cout<<ret<<std::endl;
+    parallel_algorithms_example();
     return 0;
 }
@@ -1,5 +1,13 @@
 #include <iostream>
 #include <thread>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "per_thread.h"
 
 /*
 ̱߳ʶΪstd::thread::idַͣͨʽмһ֣
@@ -42,8 +50,101 @@ void some_core_part_of_algorithm()
 Դ洢ƿÿ̵߳Ϣڶ߳лϢ
 */
 
+///䣺̷߳Ƭͳ
+/*
+std::unordered_map<std::thread::id, T>ÿ̵߳ͳʱÿۼӶҪס
+per_thread<T>(include/per_thread.h)ÿ߳һġжĲۣ
+ۼʱֻԼĲۣʱвۣۼӵ̡߳
+*/
+struct work_stats
+{
+  std::atomic<long> master_work{0};
+  std::atomic<long> common_work{0};
+  std::array<std::atomic<long>,8> latency_buckets{};  // 2ݻֵĺʱֱͼ(΢)
+};
+
+per_thread<work_stats> stats;
+
+void counted_core_part_of_algorithm(std::chrono::microseconds elapsed)
+{
+  work_stats& local=stats.local();
+  if(std::this_thread::get_id()==master_thread)
+    local.master_work.store(local.master_work.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+  local.common_work.store(local.common_work.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+  unsigned bucket=0;
+  for(auto us=elapsed.count();us>1 && bucket+1<local.latency_buckets.size();us>>=1)
+    ++bucket;
+  local.latency_buckets[bucket].fetch_add(1,std::memory_order_relaxed);
+}
+
+void per_thread_example()
+{
+  master_thread=std::this_thread::get_id();
+  std::vector<std::thread> workers;
+  for(unsigned i=0;i<4;++i)
+    workers.emplace_back([]{
+      for(unsigned j=0;j<1000;++j)
+        counted_core_part_of_algorithm(std::chrono::microseconds(j));
+    });
+  for(unsigned j=0;j<1000;++j)
+    counted_core_part_of_algorithm(std::chrono::microseconds(j));
+  for(auto& t : workers)
+    t.join();
+
+  long const master=stats.combine(0L,[](long n,work_stats& s){return n+s.master_work.load();});
+  long const common=stats.combine(0L,[](long n,work_stats& s){return n+s.common_work.load();});
+  assert(master==1000 && common==5000 && stats.slot_count()<=5);  // ˳̵߳Ĳۻᱻ̸߳
+  std::cout<<"latency histogram:";
+  for(unsigned b=0;b<8;++b)
+    std::cout<<" "<<stats.combine(0L,[b](long n,work_stats& s){return n+s.latency_buckets[b].load();});
+  std::cout<<std::endl;
+}
+
+/**threads̸߳ۼnΣÿۼӴ()*/
+template<typename Increment>
+double increments_per_us(unsigned threads,unsigned n,Increment increment)
+{
+  std::vector<std::thread> workers;
+  auto const start=std::chrono::steady_clock::now();
+  for(unsigned i=0;i<threads;++i)
+    workers.emplace_back([&]{
+      for(unsigned j=0;j<n;++j)
+        increment();
+    });
+  for(auto& t : workers)
+    t.join();
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  return threads*double(n)/std::chrono::duration<double,std::micro>(elapsed).count();
+}
+
+void counter_benchmark()
+{
+  unsigned const n=1000000;
+  for(unsigned threads : {1u,4u,std::thread::hardware_concurrency()})
+  {
+    std::mutex m;
+    std::unordered_map<std::thread::id,long> map;
+    double const map_rate=increments_per_us(threads,n,[&]{
+      std::lock_guard<std::mutex> lk(m);
+      ++map[std::this_thread::get_id()];
+    });
+
+    std::atomic<long> shared(0);
+    double const atomic_rate=increments_per_us(threads,n,[&]{shared.fetch_add(1,std::memory_order_relaxed);});
+
+    sharded_counter sharded;
+    double const sharded_rate=increments_per_us(threads,n,[&]{sharded.add();});
+    assert(sharded.read()==static_cast<std::int64_t>(threads)*n && shared==static_cast<long>(threads)*n);
+
+    std::cout<<threads<<" threads, increments/us: mutex+unordered_map "<<map_rate
+             <<", shared atomic "<<atomic_rate<<", sharded_counter "<<sharded_rate<<std::endl;
+  }
+}
+
 int main()
 {
     some_core_part_of_algorithm();
+    per_thread_example();
+    counter_benchmark();
     return 0;
 }
@@ -7,6 +7,24 @@
 #include <exception>
 #include <memory>
 #include <stack>
+#include <cassert>
+#include <chrono>
+#include <shared_mutex>
+#include <sstream>
+#include <vector>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <map>
+#include <string>
+#include "hierarchical_mutex.h"
+#include "instrumented_mutex.h"
+#include "lock_order.h"
+#include "seqlock.h"
+#include "spin_mutex.h"
+#include "synchronized.h"
 
 /*
 ͨʵstd::mutexʵԱlock()ɶԻunlock()Ϊ
@@ -64,10 +82,11 @@ public:
   }
 };
 
+template<typename Data=some_data>
 class data_wrapper
 {
 private:
-  some_data data;
+  Data data;
   std::mutex m;
 public:
   template<typename Function>
@@ -85,7 +104,7 @@ void malicious_function(some_data& protected_data)
   unprotected=&protected_data;
 }
 
-data_wrapper x;
+data_wrapper<> x;
 void foo()
 {
   x.process_data(malicious_function);    // 2 һ⺯
@@ -140,83 +159,474 @@ public:
 */
 
 
-struct empty_stack: std::exception
+#include "threadsafe_stack.h"
+/*
+ջԿ캯Իٿջ캯ТٵĿ
+ʹûȷƽȷԣķʽȳԱʼбá
+
+֮ǰtop()pop()УΪ̫СѾ֣ҪĲδȫǵ
+Ŀȹͬ⡣һ⣬һȫֻҪȥȫݣ
+һϵͳддĹʱ߳̿ǿУԷʲͬλõݣ
+˲һΪദϵͳLinuxںУʹһȫں
+˫˴ϵͳϵҪϵͳܲܶ࣬ĺϵͳ͸ˡ
+̫ȥռںˣʹڴе߳ûа취ܺõĹLinuxں˼һ
+ϸΪ˺ܶں˾ʱĺ˴ϵͳܾͺ͵˴ıˡ
+
+ʹöеݣϸҲ⡣ǰ󻥳ݵʱֻҪסһ
+ַǷ֮ĺ׼һʵ״̬һ׶Σ뿪򻹸û
+жĻȥȫʵַʽôá
+
+һҪϵĻʱһǱڵ⽫֣
+ȫ෴̻ͬ߳ụȴӶʲôû
+*/
+
+///䣺ҳصĻ
+/*
+instrumented_mutex<>(include/instrumented_mutex.h)ֱ滻std::mutexͳƻȡ
+ȴȴ/ʱֲ͵ȴĵλáΪ쾺һ߳
+˯ߣֻ߳ܵȴȻͳƽıJSON
+*/
+std::list<int> profiled_list;
+instrumented_mutex<> profiled_mutex("profiled_mutex");
+
+void slow_add_to_list(int new_value)
 {
-  const char* what() const throw() {
-	return "empty stack!";
-  };
-};
+  std::lock_guard<instrumented_mutex<>> guard(profiled_mutex);
+  profiled_list.push_back(new_value);
+  std::this_thread::sleep_for(std::chrono::microseconds(200));  // Ϊٽ
+}
 
-/**̰߳ȫջ*/
-template<typename T>
-class threadsafe_stack
+bool profiled_list_contains(int value_to_find)
 {
-private:
-  std::stack<T> data;
-  mutable std::mutex m;
+  std::unique_lock<instrumented_mutex<>> guard(profiled_mutex);
+  return std::find(profiled_list.begin(),profiled_list.end(),value_to_find) != profiled_list.end();
+}
 
-public:
-  threadsafe_stack()
-	: data(std::stack<T>()){}
+void contention_example()
+{
+  std::vector<std::thread> threads;
+  for(int t=0;t<4;++t)
+  {
+    threads.emplace_back([t]{
+      for(int i=0;i<50;++i)
+      {
+        if(t==0)
+          slow_add_to_list(i);
+        else
+          profiled_list_contains(i);
+      }
+    });
+  }
+  for(auto& th : threads)
+    th.join();
+
+  lock_stats const stats=profiled_mutex.stats();
+  assert(stats.acquisitions==200 && stats.contended>0);
+  assert(stats.wait.total()==stats.contended && !stats.top_sites.empty());
+  assert(stats.hold.max_ns>=200000);  // ĳʱܻᱻ¼
+
+  threadsafe_stack<int,instrumented_mutex<>> stack;  // threadsafe_stackĴ
+  stack.push(1);
+  stack.pop();
+  assert(stack.empty() && profiled_mutex.get_name()=="profiled_mutex");
 
-  threadsafe_stack(const threadsafe_stack& other)
+  instrumented_mutex<std::shared_mutex> entry_mutex("dns_cache::entry_mutex");
   {
-    std::lock_guard<std::mutex> lock(other.m);
-    data = other.data; // 1 ڹ캯еִп
+    std::shared_lock<instrumented_mutex<std::shared_mutex>> reader1(entry_mutex);
+    std::thread second_reader([&entry_mutex]{  // ͬһ߳ظӹʱtry_lock()δΪһ߳
+      std::shared_lock<instrumented_mutex<std::shared_mutex>> reader2(entry_mutex);
+    });
+    second_reader.join();
+    std::thread writer([&entry_mutex]{
+      assert(!entry_mutex.try_lock());  // reader1й
+    });
+    writer.join();
   }
+  {
+    std::lock_guard<instrumented_mutex<std::shared_mutex>> writer(entry_mutex);
+  }
+  lock_stats const shared_stats=entry_mutex.stats();
+  assert(shared_stats.shared_acquisitions==2 && shared_stats.acquisitions==1 && shared_stats.failed_try_locks==1);
 
-  threadsafe_stack& operator=(const threadsafe_stack&) = delete;
+  mutex_registry::instance().dump_text(std::cout);
+  std::ostringstream json;
+  mutex_registry::instance().dump_json(json);
+  assert(json.str().find("\"name\":\"profiled_mutex\"")!=std::string::npos);
+  std::cout<<json.str();
+}
 
-  void push(T new_value)
+///䣺ٽõ
+/*
+add_to_list()threadsafe_stack::push()ٽֻмʮ룬std::mutexʱ
+futex˯ߣһҪ΢롣spin_mutexadaptive_mutex(include/spin_mutex.h)
+˯()Ƚϲͬٽÿ΢ɵļ
+*/
+volatile unsigned critical_sink;
+
+/**threads̸߳nΣÿworkοѭÿ΢ļ*/
+template<typename Mutex>
+double locks_per_us(unsigned threads,unsigned n,unsigned work)
+{
+  Mutex m;
+  unsigned long long shared_counter=0;
+  std::vector<std::thread> workers;
+  auto const start=std::chrono::steady_clock::now();
+  for(unsigned t=0;t<threads;++t)
   {
-    std::lock_guard<std::mutex> lock(m);
-    data.push(new_value);
+    workers.emplace_back([&]{
+      for(unsigned i=0;i<n;++i)
+      {
+        std::lock_guard<Mutex> lk(m);
+        ++shared_counter;
+        for(unsigned w=0;w<work;++w)
+          critical_sink=w;
+      }
+    });
   }
+  for(auto& w : workers)
+    w.join();
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  assert(shared_counter==static_cast<unsigned long long>(threads)*n);
+  return threads*double(n)/std::chrono::duration<double,std::micro>(elapsed).count();
+}
 
-  std::shared_ptr<T> pop()
+template<typename Mutex>
+double stack_ops_per_us(unsigned threads,unsigned n)
+{
+  threadsafe_stack<int,Mutex> stack;
+  std::vector<std::thread> workers;
+  auto const start=std::chrono::steady_clock::now();
+  for(unsigned t=0;t<threads;++t)
   {
-    std::lock_guard<std::mutex> lock(m);
-    if(data.empty()) throw empty_stack(); // ڵpopǰջǷΪ
+    workers.emplace_back([&]{
+      int value;
+      for(unsigned i=0;i<n;++i)
+      {
+        stack.push(static_cast<int>(i));
+        stack.pop(value);
+      }
+    });
+  }
+  for(auto& w : workers)
+    w.join();
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  assert(stack.empty());
+  return threads*2.0*n/std::chrono::duration<double,std::micro>(elapsed).count();
+}
 
-    std::shared_ptr<T> const res(std::make_shared<T>(data.top())); // ޸Ķջǰֵ
-    data.pop();
-    return res;
+void spin_mutex_example()
+{
+  adaptive_mutex m1;
+  spin_mutex m2;
+  {
+    std::scoped_lock lk(m1,m2);  // std::mutexһstd::lock
+    assert(!m1.try_lock() && !m2.try_lock());
   }
+  assert(m1.try_lock() && m2.try_lock());
+  m1.unlock();
+  m2.unlock();
 
-  void pop(T& value)
+  std::condition_variable_any cond;  // Ҫ_any汾Զ廥
+  bool ready=false;
+  std::thread notifier([&]{
+    std::lock_guard<adaptive_mutex> lk(m1);
+    ready=true;
+    cond.notify_one();
+  });
   {
-    std::lock_guard<std::mutex> lock(m);
-    if(data.empty()) throw empty_stack();
+    std::unique_lock<adaptive_mutex> lk(m1);
+    cond.wait(lk,[&]{return ready;});
+  }
+  notifier.join();
 
-    value=data.top();
-    data.pop();
+  unsigned const threads=std::max(2u,std::thread::hardware_concurrency());
+  unsigned const n=200000;
+  std::cout<<threads<<" threads, locks/us"<<std::endl;
+  for(unsigned work : {0u,16u,256u,4096u})
+  {
+    unsigned const iterations=work>=256 ? n/16 : n;
+    std::cout<<"  critical section of "<<work<<" iterations: std::mutex "
+             <<locks_per_us<std::mutex>(threads,iterations,work)
+             <<", spin_mutex "<<locks_per_us<spin_mutex>(threads,iterations,work)
+             <<", adaptive_mutex "<<locks_per_us<adaptive_mutex>(threads,iterations,work)<<std::endl;
   }
+  std::cout<<"  threadsafe_stack push+pop: std::mutex "<<stack_ops_per_us<std::mutex>(threads,n)
+           <<", spin_mutex "<<stack_ops_per_us<spin_mutex>(threads,n)
+           <<", adaptive_mutex "<<stack_ops_per_us<adaptive_mutex>(threads,n)<<std::endl;
+}
+
+///䣺ڵ԰зּ˳һ
+/*
+߳෴˳ȡͿֻʱʱŻĿס
+checked_mutex<M>(include/lock_order.h)¼ÿ"AʱȡB"˳һ෴
+˳ͱĵջͬһ߳ϡû
+hierarchical_mutexҪ󰴲㼶ӸߵͼһΥʱ׳쳣
+Щֻڵ԰дڣNDEBUGȫ
+ThreadSanitizerʱͬᱨaudit_report()йߵļ˳
+*/
+checked_mutex<std::mutex> accounts_mutex("accounts_mutex");
+checked_mutex<std::mutex> audit_mutex("audit_mutex");
+
+void transfer()
+{
+  std::lock_guard<checked_mutex<std::mutex>> accounts(accounts_mutex);
+  std::lock_guard<checked_mutex<std::mutex>> audit(audit_mutex);
+}
+
+void audit_report()
+{
+  std::lock_guard<checked_mutex<std::mutex>> audit(audit_mutex);
+  std::lock_guard<checked_mutex<std::mutex>> accounts(accounts_mutex);  // transfer()˳෴
+}
+
+hierarchical_mutex high_level_mutex(10000,"high_level_mutex");
+hierarchical_mutex low_level_mutex(5000,"low_level_mutex");
+
+void lock_order_example()
+{
+#if LOCK_ORDER_CHECKING
+  std::vector<lock_order_violation> violations;
+  auto const previous=lock_order_graph::instance().set_violation_handler(
+    [&](lock_order_violation const& v){violations.push_back(v);});
+
+  transfer();
+  transfer();  // ͬ˳ֻ¼һ
+  assert(violations.empty());
+  std::thread(audit_report).join();  // һ̡߳һʱ䣬ûҲܷ
+  assert(violations.size()==1);
+  assert(violations[0].first=="audit_mutex" && violations[0].second=="accounts_mutex");
+  assert(!violations[0].current_stack.empty() && !violations[0].previous_stack.empty());
+  std::cout<<violations[0].describe();
 
-  bool empty() const
   {
-    std::lock_guard<std::mutex> lock(m);
-    return data.empty();
+    std::lock_guard<hierarchical_mutex> high(high_level_mutex);
+    std::lock_guard<hierarchical_mutex> low(low_level_mutex);  // Ӹߵͣû
   }
-};
+  std::lock_guard<hierarchical_mutex> low(low_level_mutex);
+  try
+  {
+    std::lock_guard<hierarchical_mutex> high(high_level_mutex);
+    assert(false);
+  }
+  catch(std::logic_error const&)
+  {}
+  lock_order_graph::instance().set_violation_handler(previous);
+#else
+  static_assert(sizeof(hierarchical_mutex)==sizeof(std::mutex),"checks are compiled out");
+  transfer();
+  audit_report();  // вκμ
+#endif
+}
+
+///䣺дٵСṹseqlock
 /*
-ջԿ캯Իٿջ캯ТٵĿ
-ʹûȷƽȷԣķʽȳԱʼбá
+ֻм֡öдٵ(áͳֵdns_entryСļ¼)data_wrapperӻ
+ʱÿζȡҪ޸ĻڵĻУ֮Ҳ໥
+seqlock<T>(include/seqlock.h)Ķ߲дκιڴ棬дʱԡ
+ѹдÿΰֶθĳͬһֵ߼ĿմӲ¾д롢
+汾Ҳᵹˣ-fsanitize=threadʱӦκα档
+*/
+struct route_config
+{
+  std::uint64_t version;
+  std::uint32_t address[4];
+  std::uint32_t ttl;
+  std::uint32_t weight;
+  std::uint64_t checksum;
+};
 
-֮ǰtop()pop()УΪ̫СѾ֣ҪĲδȫǵ
-Ŀȹͬ⡣һ⣬һȫֻҪȥȫݣ
-һϵͳддĹʱ߳̿ǿУԷʲͬλõݣ
-˲һΪദϵͳLinuxںУʹһȫں
-˫˴ϵͳϵҪϵͳܲܶ࣬ĺϵͳ͸ˡ
-̫ȥռںˣʹڴе߳ûа취ܺõĹLinuxں˼һ
-ϸΪ˺ܶں˾ʱĺ˴ϵͳܾͺ͵˴ıˡ
+route_config make_route_config(std::uint64_t v)
+{
+  route_config c;
+  c.version=v;
+  for(auto& a : c.address)
+    a=static_cast<std::uint32_t>(v*2654435761u);
+  c.ttl=static_cast<std::uint32_t>(v);
+  c.weight=static_cast<std::uint32_t>(~v);
+  c.checksum=v^0x9e3779b97f4a7c15ull;
+  return c;
+}
 
-ʹöеݣϸҲ⡣ǰ󻥳ݵʱֻҪסһ
-ַǷ֮ĺ׼һʵ״̬һ׶Σ뿪򻹸û
-жĻȥȫʵַʽôá
+bool consistent(route_config const& c)
+{
+  route_config const expected=make_route_config(c.version);
+  return std::memcmp(&c,&expected,sizeof(c))==0;
+}
 
-һҪϵĻʱһǱڵ⽫֣
-ȫ෴̻ͬ߳ụȴӶʲôû
+/**readers߳һд߳µͬʱȡÿ΢Ķȡ*/
+template<typename Read,typename Write>
+double reads_per_us(unsigned readers,unsigned n,Read read,Write write)
+{
+  std::atomic<bool> done(false);
+  std::thread writer([&]{
+    for(std::uint64_t v=1;!done.load(std::memory_order_relaxed);++v)
+    {
+      write(make_route_config(v));
+      std::this_thread::sleep_for(std::chrono::microseconds(50));  // д
+    }
+  });
+  std::vector<std::thread> workers;
+  auto const start=std::chrono::steady_clock::now();
+  for(unsigned t=0;t<readers;++t)
+  {
+    workers.emplace_back([&]{
+      std::uint64_t last=0;
+      for(unsigned i=0;i<n;++i)
+      {
+        route_config const c=read();
+        assert(consistent(c) && c.version>=last);
+        last=c.version;
+      }
+    });
+  }
+  for(auto& w : workers)
+    w.join();
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  done=true;
+  writer.join();
+  return readers*double(n)/std::chrono::duration<double,std::micro>(elapsed).count();
+}
+
+void seqlock_example()
+{
+  seqlock<route_config> config(make_route_config(0));
+  assert(config.version()==0 && consistent(config.load()));
+  config.modify([](route_config& c){c=make_route_config(c.version+1);});
+  assert(config.version()==1 && config.load().version==1);
+  try
+  {
+    config.modify([](route_config&){throw std::runtime_error("rejected");});
+  }
+  catch(std::runtime_error const&)
+  {}
+  assert(config.load().version==1);  // ׳쳣޸ĲӰݣҲῨס
+
+  // ѹԣд߽ͬʱ
+  {
+    std::atomic<bool> done(false);
+    std::atomic<unsigned long long> reads(0),retries(0);
+    std::vector<std::thread> threads;
+    for(unsigned w=0;w<2;++w)
+      threads.emplace_back([&]{
+        for(unsigned i=0;i<5000;++i)
+        {
+          config.modify([](route_config& c){c=make_route_config(c.version+1);});
+          std::this_thread::yield();  // ˻Ҳ
+        }
+      });
+    for(unsigned r=0;r<3;++r)
+      threads.emplace_back([&]{
+        std::uint64_t last=0;
+        unsigned long long local_reads=0,local_retries=0;
+        while(!done.load(std::memory_order_relaxed))
+        {
+          route_config c;
+          if(!config.try_load(c))
+          {
+            ++local_retries;
+            continue;
+          }
+          assert(consistent(c) && c.version>=last);
+          last=c.version;
+          if(++local_reads%64==0)
+            std::this_thread::yield();
+        }
+        reads+=local_reads;
+        retries+=local_retries;
+      });
+    threads[0].join();
+    threads[1].join();
+    done=true;
+    for(std::size_t i=2;i<threads.size();++i)
+      threads[i].join();
+    assert(config.load().version==10001 && config.version()==10002);  // ׳쳣һ
+    std::cout<<"seqlock stress: "<<reads<<" consistent reads, "<<retries<<" retries"<<std::endl;
+  }
+
+  unsigned const readers=std::max(2u,std::thread::hardware_concurrency());
+  unsigned const n=500000;
+  data_wrapper<route_config> guarded;
+  guarded.process_data([](route_config& c){c=make_route_config(0);});
+  double const locked=reads_per_us(readers,n,
+    [&]{route_config c; guarded.process_data([&](route_config& d){c=d;}); return c;},
+    [&](route_config const& c){guarded.process_data([&](route_config& d){d=c;});});
+  seqlock<route_config> lockless(make_route_config(0));
+  double const optimistic=reads_per_us(readers,n,
+    [&]{return lockless.load();},
+    [&](route_config const& c){lockless.store(c);});
+  std::cout<<readers<<" readers, reads/us: data_wrapper "<<locked<<", seqlock "<<optimistic<<std::endl;
+}
+
+///䣺ܱݵӳ
+/*
+synchronized<T,Mutex>(include/synchronized.h)ٰý⺯
+with_lock()Ļصܷûָ룬wlock()/rlock()صlocked_ptrɸƣ
+ߡдڱھͻᱻܾ
+  synchronized<some_data> safe_data;
+  some_data& leaked=safe_data.with_lock([](some_data& d)->some_data&{return d;});
+acquire_locked()ַ˳סתͬʱҲ
+std::shared_mutexʱֻ߿ͬʱrlock()
 */
+struct account
+{
+  long balance;
+};
+
+void transfer_between(synchronized<account>& from,synchronized<account>& to,long amount)
+{
+  auto locked=acquire_locked(from,to);
+  locked.first->balance-=amount;
+  locked.second->balance+=amount;
+}
+
+void synchronized_example()
+{
+  synchronized<std::vector<int>> values;
+  values.wlock()->push_back(1);
+  values.with_lock([](std::vector<int>& v){v.push_back(2);});
+  std::size_t const n=values.with_lock([](std::vector<int> const& v){return v.size();});  // ֵ
+  assert(n==2 && values.copy().back()==2);
+  {
+    auto locked=values.wlock();
+    locked->push_back(3);
+    locked.unlock();  // ǰͷţ֮locked
+    assert(!locked);
+    values.wlock()->pop_back();
+  }
+
+  synchronized<account> a(account{1000}),b(account{1000});
+  std::thread t1([&]{for(int i=0;i<10000;++i) transfer_between(a,b,1);});
+  std::thread t2([&]{for(int i=0;i<10000;++i) transfer_between(b,a,1);});  // ˳෴
+  t1.join();
+  t2.join();
+  assert(a.copy().balance==1000 && b.copy().balance==1000);
+  try
+  {
+    transfer_between(a,a,1);
+    assert(false);
+  }
+  catch(std::logic_error const&)
+  {}
+
+  synchronized<std::map<std::string,std::string>,std::shared_mutex> hosts;
+  hosts.wlock()->emplace("www.example.com","93.184.216.34");
+  std::atomic<int> readers_inside(0);
+  auto reader=[&]{
+    hosts.with_rlock([&](std::map<std::string,std::string> const& h){
+      assert(h.count("www.example.com"));
+      ++readers_inside;
+      while(readers_inside.load()<2)  // ͬʱڣstd::mutexԶȥ
+        std::this_thread::yield();
+    });
+  };
+  std::thread r1(reader),r2(reader);
+  r1.join();
+  r2.join();
+  auto const host=hosts.rlock();
+  static_assert(std::is_same<decltype(*host),std::map<std::string,std::string> const&>::value,
+                "rlock() only gives const access");
+  std::cout<<"www.example.com -> "<<host->at("www.example.com")<<std::endl;
+}
 
 int main()
 {
@@ -227,5 +637,10 @@ int main()
         std::cout << "42 included" << std::endl;
     foo();
     std::cout << "" << std::endl;
+    contention_example();
+    spin_mutex_example();
+    lock_order_example();
+    seqlock_example();
+    synchronized_example();
     return 0;
 }
@@ -215,35 +215,7 @@ std::shared_timed_mutex
 ݣʹstd::shared_mutexб
 */
 //3.13 ʹstd::shared_mutexݽṹб
-#include <map>
-#include <string>
-#include <mutex>
-#include <shared_mutex>
-
-class dns_entry
-{
-
-};
-
-class dns_cache
-{
-  std::map<std::string,dns_entry> entries;
-  mutable std::shared_mutex entry_mutex;
-public:
-  dns_entry find_entry(std::string const& domain) const
-  {
-    std::shared_lock<std::shared_mutex> lk(entry_mutex);  // 1
-    std::map<std::string,dns_entry>::const_iterator const it=
-       entries.find(domain);
-    return (it==entries.end())?dns_entry():it->second;
-  }
-  void update_or_add_entry(std::string const& domain,
-                           dns_entry const& dns_details)
-  {
-    std::lock_guard<std::shared_mutex> lk(entry_mutex);  // 2
-    entries[domain]=dns_details;
-  }
-};
+#include "dns_cache.h"
 /*3.13Уfind_entry()ʹstd::shared_lock<>ֻȨޢ١
 ʹö߳̿ͬʱfind_entry()Ҳһ棬
 update_or_add_entry()ʹstd::lock_guard<>ʵҪʱڣΪṩ
@@ -270,6 +242,429 @@ std::mutex
 ȡһΪ˽гԱ˽гԱԻ(ǰ)
 ȻҪϸһ£ºʱݵ״̬
 */
+///䣺߼ɢеĶд
+/*
+std::shared_mutexֻһ߼еfind_entry()ĺ˶޸ͬһС
+distributed_shared_mutex(include/distributed_shared_mutex.h)ÿֻ߳޸Լ
+һУдҪеСȽֻԼдʱ
+д߲ᱻԴԴϵĶ߶
+*/
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include "distributed_shared_mutex.h"
+
+/**threads̸߳nfind_entry()ÿ΢ĲҴ*/
+template<typename Policy>
+double lookups_per_us(dns_cache<Policy> const& cache,unsigned threads,unsigned n)
+{
+  std::vector<std::thread> readers;
+  auto const start=std::chrono::steady_clock::now();
+  for(unsigned t=0;t<threads;++t)
+  {
+    readers.emplace_back([&cache,n,t]{
+      std::string const domain="host"+std::to_string(t%16)+".example.com";
+      dns_entry entry;
+      for(unsigned i=0;i<n;++i)
+      {
+        volatile bool const found=cache.find_entry(domain,entry);  // ýʱҿܱŻ
+        (void)found;
+      }
+    });
+  }
+  for(auto& r : readers)
+    r.join();
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  return threads*double(n)/std::chrono::duration<double,std::micro>(elapsed).count();
+}
+
+void shared_mutex_benchmark()
+{
+  dns_cache<std::shared_mutex> plain;
+  dns_cache<distributed_shared_mutex<>> distributed;
+  for(int i=0;i<16;++i)
+  {
+    std::string const domain="host"+std::to_string(i)+".example.com";
+    plain.update_or_add_entry(domain,dns_entry());
+    distributed.update_or_add_entry(domain,dns_entry());
+  }
+
+  unsigned const n=500000;
+  unsigned const max_threads=std::max(4u,std::thread::hardware_concurrency());
+  std::cout<<"find_entry() lookups/us"<<std::endl;
+  for(unsigned threads=1;threads<=max_threads;threads*=2)
+  {
+    std::cout<<"  "<<threads<<" readers: std::shared_mutex "<<lookups_per_us(plain,threads,n)
+             <<", distributed_shared_mutex "<<lookups_per_us(distributed,threads,n)<<std::endl;
+  }
+
+  std::atomic<bool> stop(false);  // һֱڶдȻõ
+  std::atomic<unsigned> updates(0);
+  std::vector<std::thread> readers;
+  for(unsigned t=0;t<4;++t)
+    readers.emplace_back([&]{
+      while(!stop)
+        distributed.find_entry("host1.example.com");
+    });
+  std::thread writer([&]{
+    for(int i=0;i<1000;++i)
+    {
+      distributed.update_or_add_entry("host"+std::to_string(i)+".example.com",dns_entry());
+      ++updates;
+    }
+  });
+  writer.join();
+  stop=true;
+  for(auto& r : readers)
+    r.join();
+  assert(updates==1000);
+}
+
+///䣺
+/*
+ʹ߼ɢˣдȻҪж뿪ҲҪдߡdns_cacheĵڶ
+dns_skiplist_mapconcurrent_skiplist_map(include/concurrent_skiplist_map.h)ҡ
+¡ɾͰǰ׺ɾĽڵepoch_domainƳٵû߳ٶʱͷš
+ȼڲ޸µȷԣÿֻ߳޸Լǲּ(key%threads==t)
+ͬʱ̲߳ͣر˳ֵǷһ¡
+*/
+#include <random>
+#include <set>
+#include "concurrent_skiplist_map.h"
+
+void skiplist_map_example()
+{
+  concurrent_skiplist_map<int,int> small;
+  assert(small.insert_or_assign(2,20) && small.insert_or_assign(1,10) && small.insert_or_assign(3,30));
+  assert(!small.insert_or_assign(2,21));
+  int value=0;
+  assert(small.find(2,value) && value==21 && !small.find(4,value));
+  assert(small.erase(1) && !small.erase(1) && small.size()==2);
+  std::vector<int> keys;
+  small.scan(0,[&keys](int key,int){keys.push_back(key);return true;});
+  assert((keys==std::vector<int>{2,3}));
+
+  unsigned const threads=4;
+  int const key_space=512;
+  concurrent_skiplist_map<int,int> map;
+  std::atomic<bool> done(false);
+  std::atomic<unsigned> scans(0);
+  std::thread scanner([&]{
+    while(!done)
+    {
+      int previous=-1;
+      map.scan(0,[&](int key,int value){
+        assert(key>previous && value/1000==key);  // ˳ȷֵûбǰͷ
+        previous=key;
+        return true;
+      });
+      ++scans;
+    }
+  });
+  std::vector<std::set<int>> expected(threads);
+  std::vector<std::thread> writers;
+  for(unsigned t=0;t<threads;++t)
+    writers.emplace_back([&,t]{
+      std::mt19937 rng(t);
+      for(int i=0;i<20000;++i)
+      {
+        int const key=int(rng()%(key_space/threads))*threads+t;
+        int value=0;
+        if(rng()%3==0)
+        {
+          assert(map.erase(key)==(expected[t].erase(key)==1));
+        }
+        else
+        {
+          assert(map.insert_or_assign(key,key*1000+i%1000)==expected[t].insert(key).second);
+        }
+        assert(map.find(key,value)==(expected[t].count(key)==1));
+        if(expected[t].count(key))
+          assert(value/1000==key);
+      }
+    });
+  for(auto& w : writers)
+    w.join();
+  done=true;
+  scanner.join();
+
+  std::vector<int> all;
+  map.scan(0,[&all](int key,int){all.push_back(key);return true;});
+  std::set<int> wanted;
+  for(auto const& e : expected)
+    wanted.insert(e.begin(),e.end());
+  assert(all==std::vector<int>(wanted.begin(),wanted.end()));
+  assert(map.size()==wanted.size());
+  map.reclamation().collect();
+  std::cout<<"skiplist: "<<all.size()<<" keys after concurrent updates, "<<scans<<" scans, "
+           <<map.reclamation().pending()<<" retired nodes left in exited threads' slots"<<std::endl;
+
+  dns_cache<dns_skiplist_map> cache;
+  for(int i=0;i<16;++i)
+    cache.update_or_add_entry("host"+std::to_string(i)+".example.com",dns_entry());
+  cache.remove_entry("host12.example.com");
+  std::vector<std::string> found;
+  cache.for_each_with_prefix("host1",[&found](std::string const& domain,dns_entry const&){found.push_back(domain);});
+  assert((found==std::vector<std::string>{"host1.example.com","host10.example.com","host11.example.com",
+                                          "host13.example.com","host14.example.com","host15.example.com"}));
+
+  dns_cache<std::shared_mutex> plain;
+  for(int i=0;i<16;++i)
+    plain.update_or_add_entry("host"+std::to_string(i)+".example.com",dns_entry());
+  unsigned const n=500000;
+  std::cout<<"find_entry() lookups/us with 4 readers: std::shared_mutex "<<lookups_per_us(plain,4,n)
+           <<", dns_skiplist_map "<<lookups_per_us(cache,4,n)<<std::endl;
+}
+
+///䣺ǩǰ׺
+/*
+Ҫa.b.example.comġм¼ϼ򣬻ƥ*.example.comͨ
+std::mapֻÿȥһǩٲһΣdns_trie_maplabel_trie(
+include/label_trie.h)ǩ(com -> example -> b -> a)֯ѹǰ׺
+һδӸ߾͵õȷƥ䡢ϼ߲ͨд߸
+޸ĵ·һλµĸƥ䡢ɾڵĺϲԼд߲ͣ
+ʱ߿İ汾
+*/
+#include <utility>
+#include "label_trie.h"
+
+void label_trie_example()
+{
+  label_trie<int> trie;
+  assert(trie.insert_or_assign("example.com",1) && trie.insert_or_assign("www.example.com",2));
+  assert(trie.insert_or_assign("*.example.com",3) && trie.insert_or_assign("b.example.com.",4));
+  assert(!trie.insert_or_assign("www.example.com",5) && trie.size()==4);
+
+  auto m=trie.lookup("a.b.example.com");
+  assert(!m.exact && m.enclosing && m.enclosing_labels==3 && m.enclosing_value==4);
+  assert(m.wildcard && m.wildcard_labels==2 && m.wildcard_value==3);
+  m=trie.lookup("www.example.com");
+  assert(m.exact && m.exact_value==5 && m.enclosing_labels==3);
+  m=trie.lookup("example.org");
+  assert(!m.exact && !m.enclosing && !m.wildcard);
+  trie.insert_or_assign("*.b.example.org",6);  // org -> example -> b -> *һѹı
+  m=trie.lookup("x.b.example.org");
+  assert(m.wildcard && m.wildcard_labels==3 && m.wildcard_value==6 && !m.enclosing);
+  assert(trie.erase("*.b.example.org"));
+
+  assert(trie.erase("b.example.com") && !trie.erase("b.example.com") && !trie.erase("nothing.example.com"));
+  m=trie.lookup("a.b.example.com");
+  assert(m.enclosing_labels==2 && m.enclosing_value==1);
+  assert(trie.erase("example.com") && trie.erase("*.example.com"));  // ֻʣwww.example.com·ϲ
+  int value=0;
+  assert(trie.find("www.example.com",value) && value==5 && !trie.find("example.com",value));
+  std::vector<std::string> zone;
+  trie.for_each_in_zone("com",[&zone](std::string const& domain,int){zone.push_back(domain);});
+  assert((zone==std::vector<std::string>{"www.example.com"}));
+
+  dns_cache<dns_trie_map> cache;
+  dns_cache<std::shared_mutex> plain;
+  std::vector<std::pair<std::string,dns_entry>> records;
+  for(char const* domain : {"example.com","*.example.com","mail.example.com","example.org"})
+    records.emplace_back(domain,dns_entry());
+  cache.update_or_add_entries(records.begin(),records.end());
+  plain.update_or_add_entries(records.begin(),records.end());
+  dns_entry entry;
+  std::string found_zone,plain_zone;
+  assert(cache.find_closest_enclosing("x.y.example.com",found_zone,entry) &&
+         plain.find_closest_enclosing("x.y.example.com",plain_zone,entry));
+  assert(found_zone=="example.com" && plain_zone==found_zone);
+  assert(cache.find_with_wildcard("x.y.example.com",entry) && plain.find_with_wildcard("x.y.example.com",entry));
+  assert(!cache.find_with_wildcard("x.example.net",entry) && !plain.find_with_wildcard("x.example.net",entry));
+  assert(!cache.find_closest_enclosing("net",found_zone,entry) && !plain.find_closest_enclosing("net",plain_zone,entry));
+
+  label_trie<int> versions;  // ÿ汾zoneµֵͬ
+  std::atomic<bool> done(false);
+  std::atomic<unsigned> checks(0);
+  std::vector<std::thread> readers;
+  for(unsigned t=0;t<2;++t)
+    readers.emplace_back([&]{
+      while(!done)
+      {
+        int first=-1;
+        versions.for_each_in_zone("zone",[&](std::string const&,int v){
+          if(first<0)
+            first=v;
+          assert(v==first);  // ֻһİ汾
+        });
+        auto const r=versions.lookup("x.h3.zone");
+        assert(!r.enclosing || (r.enclosing_labels==2 && r.enclosing_value>=0));
+        ++checks;
+      }
+    });
+  for(int round=0;round<200;++round)
+    versions.update([round](label_trie<int>::writer& w){
+      for(int i=0;i<64;++i)
+        w.insert_or_assign("h"+std::to_string(i)+".zone",round);
+      if(round%2)
+        w.erase("h3.zone");
+      else
+        w.insert_or_assign("h3.zone",round);
+    });
+  done=true;
+  for(auto& r : readers)
+    r.join();
+  std::cout<<"label_trie: "<<versions.size()<<" names, "<<versions.label_count()<<" distinct labels, "
+           <<checks<<" consistent reads during updates"<<std::endl;
+}
+
+///䣺յĴ洢
+/*
+dns_cache<std::shared_mutex>ÿ¼һstd::mapڵ(ָ롢ɫټ
+std::stringdns_entry)һҪһڴ档dns_compact_map(
+include/dns_cache.hinclude/string_interner.h)׷ӵڴϣ
+ֻ32λıţdns_entryŷСͬ
+Ƚϲҽmemory_usage()ÿ¼ֽ
+*/
+#include "string_interner.h"
+
+void compact_storage_example()
+{
+  string_interner names;
+  std::uint32_t const a=names.intern("example.com");
+  assert(names.intern("www.example.com")==a+1 && names.intern("example.com")==a);
+  assert(names[a]=="example.com" && names.find("example.org")==string_interner::npos);
+  assert(names.hash_of(a)==string_interner::hash("example.com"));
+
+  dns_cache<std::shared_mutex> plain;
+  dns_cache<dns_compact_map<>> compact;
+  unsigned const domains=200000;
+  for(unsigned i=0;i<domains;++i)
+  {
+    std::string const domain=(i%3 ? "www.site" : "mail.server-")+std::to_string(i)+".example.com";
+    plain.update_or_add_entry(domain,dns_entry());
+    compact.update_or_add_entry(domain,dns_entry());
+  }
+  dns_entry entry;
+  for(unsigned i=0;i<domains;i+=997)
+  {
+    std::string const domain=(i%3 ? "www.site" : "mail.server-")+std::to_string(i)+".example.com";
+    assert(compact.find_entry(domain,entry) && plain.find_entry(domain,entry));
+  }
+  assert(!compact.find_entry("www.site1.example.org",entry));
+  assert(compact.remove_entry("www.site1.example.com") && !compact.remove_entry("www.site1.example.com"));
+  assert(!compact.find_entry("www.site1.example.com",entry));
+  compact.update_or_add_entry("www.site1.example.com",dns_entry());  // ԭı
+  assert(compact.find_entry("www.site1.example.com",entry));
+
+  dns_memory_usage const before=plain.memory_usage();
+  dns_memory_usage const after=compact.memory_usage();
+  assert(before.entries==domains && after.entries==domains);
+  std::cout<<"bytes per entry for "<<domains<<" domains: std::map "<<before.bytes_per_entry()
+           <<" (estimated), dns_compact_map "<<after.bytes_per_entry()<<std::endl;
+
+  dns_compact_map<> churning;  // ÿһֻȫɾᱻգڴ治һֱ
+  unsigned const per_round=20000;
+  auto const churn_name=[](unsigned round,unsigned i){return "r"+std::to_string(round)+".host"+std::to_string(i)+".example.com";};
+  std::size_t first_round_bytes=0;
+  for(unsigned round=0;round<20;++round)
+  {
+    for(unsigned i=0;i<per_round;++i)
+      churning.update_or_add(churn_name(round,i),dns_entry());
+    if(round)
+      for(unsigned i=0;i<per_round;++i)
+        assert(churning.remove(churn_name(round-1,i)));
+    dns_memory_usage const usage=churning.memory_usage();
+    assert(usage.entries==per_round && usage.dead_bytes<usage.bytes);
+    if(!round)
+      first_round_bytes=usage.bytes;
+    assert(usage.bytes<=3*first_round_bytes);
+  }
+  assert(churning.find(churn_name(19,7),entry) && !churning.find(churn_name(18,7),entry));
+  assert(churning.remove(churn_name(19,7)) && churning.memory_usage().dead_bytes>0);
+  churning.compact();
+  dns_memory_usage const compacted=churning.memory_usage();
+  assert(compacted.entries==per_round-1 && compacted.dead_bytes==0);
+  assert(churning.find(churn_name(19,8),entry) && !churning.find(churn_name(19,7),entry));
+  std::cout<<"after 20 rounds of churn: "<<compacted.bytes<<" bytes for "<<compacted.entries<<" domains"<<std::endl;
+}
+
+///䣺
+/*
+֮󻺴ǿյģ֮ǰеĲѯҪתΡsave_snapshot()ѻ
+дɿֱӳļ(include/mapped_table.h)дʱճң½
+load_snapshot()ӳֻУͣҲ룬find_entry()Ͼܲ鵽Ȼ
+migrate_snapshot()ں̨Ѽ¼ƽ滹鱻ضϺͱĶļᱻ֡
+*/
+#include <filesystem>
+#include <fstream>
+
+void snapshot_example()
+{
+  namespace fs=std::filesystem;
+  fs::path const file=fs::temp_directory_path()/"dns_cache_example.snapshot";
+  unsigned const domains=100000;
+  auto const name=[](unsigned i){return "host"+std::to_string(i)+".zone"+std::to_string(i%97)+".example";};
+
+  dns_cache<std::shared_mutex> running;
+  for(unsigned i=0;i<domains;++i)
+    running.update_or_add_entry(name(i),dns_entry());
+  std::atomic<bool> saving(true);
+  std::atomic<unsigned> lookups(0);
+  std::thread reader([&]{
+    dns_entry entry;
+    for(unsigned i=0;saving;++i)
+    {
+      assert(running.find_entry(name(i%domains),entry));
+      ++lookups;
+    }
+  });
+  running.save_snapshot(file.string());
+  saving=false;
+  reader.join();
+
+  auto const start=std::chrono::steady_clock::now();
+  dns_cache<dns_compact_map<>> restarted;
+  assert(restarted.load_snapshot(file.string())==snapshot_status::ok);
+  auto const loaded=std::chrono::steady_clock::now();
+  dns_entry entry;
+  assert(restarted.find_entry(name(12345),entry) && restarted.snapshot_pending()==domains);
+  restarted.update_or_add_entry(name(1),dns_entry());  // Ǩ֮ǰ޸ĺɾΪ׼
+  assert(restarted.remove_entry(name(2)) && !restarted.find_entry(name(2),entry));
+  assert(restarted.snapshot_pending()==domains-2);
+
+  std::atomic<bool> migrating(true);
+  std::thread checker([&]{  // Ǩƹÿ¼һֱõ
+    for(unsigned i=0;migrating;i=(i+7919)%domains)
+      if(i!=2)
+        assert(restarted.find_entry(name(i),entry));
+  });
+  while(restarted.migrate_snapshot(4096))
+    std::this_thread::yield();
+  migrating=false;
+  checker.join();
+  for(unsigned i=0;i<domains;i+=101)
+    assert(restarted.find_entry(name(i),entry)==(i!=2));
+  assert(restarted.memory_usage().entries==domains-1 && restarted.snapshot_pending()==0);
+  auto const migrated=std::chrono::steady_clock::now();
+
+  dns_cache<dns_compact_map<>> refilled;
+  for(unsigned i=0;i<domains;++i)
+    refilled.update_or_add_entry(name(i),dns_entry());
+  auto const refill_end=std::chrono::steady_clock::now();
+  typedef std::chrono::duration<double,std::milli> ms;
+  std::cout<<"snapshot of "<<domains<<" domains: "<<fs::file_size(file)<<" bytes, "<<lookups
+           <<" lookups while saving; serving after "<<ms(loaded-start).count()<<" ms, migrated after "
+           <<ms(migrated-start).count()<<" ms (refill by update_or_add_entry: "<<ms(refill_end-migrated).count()
+           <<" ms)"<<std::endl;
+
+  fs::path const damaged=file.string()+".damaged";
+  fs::copy_file(file,damaged,fs::copy_options::overwrite_existing);
+  {
+    std::fstream f(damaged,std::ios::in|std::ios::out|std::ios::binary);
+    f.seekp(std::streamoff(fs::file_size(damaged)/2));
+    f.put('\x7f');
+  }
+  dns_cache<> other;
+  assert(other.load_snapshot(damaged.string())==snapshot_status::bad_checksum);
+  fs::resize_file(damaged,fs::file_size(file)-10);  // дһļ
+  assert(other.load_snapshot(damaged.string())==snapshot_status::truncated);
+  fs::remove(damaged);
+  assert(other.load_snapshot(damaged.string())==snapshot_status::missing);
+  assert(!other.find_entry(name(0),entry));
+  fs::remove(file);
+}
+
 int main()
 {
     std::vector<int> v{ 0, 1, 2};
@@ -278,5 +673,10 @@ int main()
     for (auto x : v2)
         std::cout << x<<std::endl; // 123
     print(1, "shjs", "dsjak", "dsjak", 3, 7);
+    shared_mutex_benchmark();
+    skiplist_map_example();
+    label_trie_example();
+    compact_storage_example();
+    snapshot_example();
     return 0;
 }
@@ -3,6 +3,12 @@
 #include <mutex>
 #include <queue>
 #include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <vector>
 ///4 ͬ
 /*
 Ҫ
@@ -297,78 +303,7 @@ wait_and_pop()
 
 4.5 ʹ̰߳ȫ()*/
 
-#include <queue>
-#include <memory>
-#include <mutex>
-#include <condition_variable>
-
-template<typename T>
-class threadsafe_queue
-{
-private:
-  mutable std::mutex mut;  // 1 ǿɱ
-  std::queue<T> data_queue;
-  std::condition_variable data_cond;
-public:
-  threadsafe_queue()
-  {}
-  threadsafe_queue(threadsafe_queue const& other)
-  {
-    //ֵʱֹڿֵ
-    std::lock_guard<std::mutex> lk(other.mut);
-    data_queue=other.data_queue;
-  }
-
-  void push(T new_value)
-  {
-    std::lock_guard<std::mutex> lk(mut);
-    data_queue.push(new_value);
-    data_cond.notify_one();
-  }
-
-  void wait_and_pop(T& value)
-  {
-    std::unique_lock<std::mutex> lk(mut);
-    data_cond.wait(lk,[this]{return !data_queue.empty();});
-    value=data_queue.front();
-    data_queue.pop();
-  }
-
-  std::shared_ptr<T> wait_and_pop()
-  {
-    std::unique_lock<std::mutex> lk(mut);
-    data_cond.wait(lk,[this]{return !data_queue.empty();});
-    std::shared_ptr<T> res(std::make_shared<T>(data_queue.front()));
-    data_queue.pop();
-    return res;
-  }
-
-  bool try_pop(T& value)
-  {
-    std::lock_guard<std::mutex> lk(mut);
-    if(data_queue.empty())
-      return false;
-    value=data_queue.front();
-    data_queue.pop();
-    return true;
-  }
-
-  std::shared_ptr<T> try_pop()
-  {
-    std::lock_guard<std::mutex> lk(mut);
-    if(data_queue.empty())
-      return std::shared_ptr<T>();
-    std::shared_ptr<T> res(std::make_shared<T>(data_queue.front()));
-    data_queue.pop();
-    return res;
-  }
-
-  bool empty() const
-  {
-    std::lock_guard<std::mutex> lk(mut);
-    return data_queue.empty();
-  }
-};
+#include "threadsafe_queue.h"
 /*
 empty()һconstԱҴ뿽캯otherβһconstáΪ
 ߳̿зconstö󣬲ñֳԱбҪԻ
@@ -393,8 +328,254 @@ notify_one()
 ˽һfutureĲ㡣
 */
 
+///䣺ȼӵ̰߳ȫ
+/*
+Ҫȴֹʱthreadsafe_queueֻȽȳ
+threadsafe_priority_queue.hеthreadsafe_priority_queueӿͬڲkԴĶѣ
+ʱȡŵһ˳ǽƵġk=1ʱϸȶС
+*/
+#include "threadsafe_priority_queue.h"
+
+struct deadline_job
+{
+  std::chrono::steady_clock::time_point deadline;
+  int id;
+};
+
+struct later_deadline  // ֹʱԽȼԽͣstd::greaterͬ
+{
+  bool operator()(deadline_job const& lhs,deadline_job const& rhs) const
+  {
+    return lhs.deadline>rhs.deadline;
+  }
+};
+
+/**order˳ȡ0..n-1ʱÿԪȡʱжٸŵԪڶ(״)*/
+std::vector<unsigned> rank_errors(std::vector<unsigned> const& order,unsigned n)
+{
+  std::vector<unsigned> present(n+1,0);
+  auto const add=[&](unsigned key,int delta)
+  {
+    for(unsigned i=key+1;i<=n;i+=i&(0u-i))
+      present[i]+=delta;
+  };
+  auto const below=[&](unsigned key)  // Сڵkeyĸ
+  {
+    unsigned total=0;
+    for(unsigned i=key+1;i;i-=i&(0u-i))
+      total+=present[i];
+    return total;
+  };
+  for(unsigned key=0;key<n;++key)
+    add(key,1);
+  std::vector<unsigned> ranks;
+  unsigned remaining=n;
+  for(unsigned key : order)
+  {
+    ranks.push_back(remaining-below(key));  // keyĶ
+    add(key,-1);
+    --remaining;
+  }
+  return ranks;
+}
+
+std::vector<unsigned> pop_ranks(threadsafe_priority_queue<unsigned>& q,unsigned n)
+{
+  std::vector<unsigned> order;
+  unsigned key;
+  while(q.try_pop(key))
+    order.push_back(key);
+  return rank_errors(order,n);
+}
+
+double mean_of(std::vector<unsigned> const& ranks)
+{
+  double mean=0;
+  for(unsigned r : ranks)
+    mean+=r;
+  return ranks.empty() ? 0 : mean/ranks.size();
+}
+
+void priority_queue_example()
+{
+  using namespace std::chrono;
+  auto const now=steady_clock::now();
+  threadsafe_priority_queue<deadline_job,later_deadline> strict(1);
+  strict.push({now+30ms,3});
+  strict.push({now+10ms,1});
+  strict.push({now+20ms,2});
+  deadline_job job;
+  for(int expected=1;expected<=3;++expected)
+  {
+    strict.wait_and_pop(job);
+    assert(job.id==expected);
+  }
+  assert(!strict.try_pop(job) && strict.empty());
+
+  unsigned const n=20000;  // ˳nͬļ߳ȫȡͳ
+  std::vector<unsigned> keys(n);
+  for(unsigned i=0;i<n;++i)
+    keys[i]=i;
+  std::shuffle(keys.begin(),keys.end(),std::mt19937(42));
+  for(std::size_t k : {std::size_t(1),std::size_t(8),std::size_t(32)})
+  {
+    threadsafe_priority_queue<unsigned> q(k);
+    for(unsigned key : keys)
+      q.push(key);
+    std::vector<unsigned> const ranks=pop_ranks(q,n);
+    assert(ranks.size()==n);
+    double const mean=mean_of(ranks);
+    assert(k>1 || mean==0);
+    assert(mean<=2.0*k);
+    std::cout<<"k="<<k<<": mean rank error "<<mean<<", max "
+             <<*std::max_element(ranks.begin(),ranks.end())<<std::endl;
+  }
+
+  {
+    threadsafe_priority_queue<unsigned> q(8);  // ĸ߳ͬʱȡоʱҲҪȽ
+    for(unsigned key : keys)
+      q.push(key);
+    std::vector<unsigned> order(n);
+    std::atomic<unsigned> next{0};
+    std::vector<std::thread> consumers;
+    for(unsigned c=0;c<4;++c)
+      consumers.emplace_back([&]
+      {
+        unsigned key;
+        while(q.try_pop(key))
+          order[next.fetch_add(1)]=key;  // ȡͱܱ̲֮߳ӣԴһЩ
+      });
+    for(auto& t : consumers)
+      t.join();
+    assert(next==n);
+    double const mean=mean_of(rank_errors(order,n));
+    assert(mean<=4.0*8);
+    std::cout<<"k=8, 4 consumers: mean rank error "<<mean<<std::endl;
+  }
+
+  unsigned const per_producer=20000;  // ߡߣÿԪǡȡһ
+  threadsafe_priority_queue<unsigned> shared;
+  std::vector<unsigned char> seen(2*per_producer,0);
+  std::vector<std::thread> threads;
+  for(unsigned p=0;p<2;++p)
+    threads.emplace_back([&,p]
+    {
+      for(unsigned i=0;i<per_producer;++i)
+        shared.push(p*per_producer+i);
+    });
+  std::vector<std::vector<unsigned>> received(2);
+  for(unsigned c=0;c<2;++c)
+    threads.emplace_back([&,c]
+    {
+      for(unsigned i=0;i<per_producer;++i)
+      {
+        unsigned value;
+        shared.wait_and_pop(value);
+        received[c].push_back(value);
+      }
+    });
+  for(auto& t : threads)
+    t.join();
+  for(auto const& r : received)
+    for(unsigned value : r)
+      ++seen[value];
+  assert(std::all_of(seen.begin(),seen.end(),[](unsigned char c){return c==1;}));
+  assert(shared.empty());
+}
+
+///䣺òԲöкջ
+/*
+threadsafe_queuethreadsafe_stackĻײ֪ͨʽͷͶ
+ģ(container_policies.h)ڱѡûѡеĹܲռռҲɴ롣
+Ǽãн/߶Сring_bufferԪزֻ˵ȴʱ֪ͨ
+ֻһ߳ʹõnull_mutex汾ԼԵȴջ
+*/
+#include <optional>
+#include <string>
+#include "container_policies.h"
+#include "threadsafe_stack.h"
+
+typedef threadsafe_queue<int,policy::capacity<4>,policy::return_optional> bounded_queue;
+typedef threadsafe_queue<std::string,policy::storage<ring_buffer>,policy::notify_waiters> ring_queue;
+typedef threadsafe_queue<int,policy::lock<null_mutex>> local_queue;
+
+static_assert(std::is_same<bounded_queue::result_type,std::optional<int>>::value,"");
+static_assert(std::is_same<threadsafe_queue<int>::result_type,std::shared_ptr<int>>::value,"");
+static_assert(sizeof(local_queue)<sizeof(threadsafe_queue<int>),"null_mutex drops the mutex and the condition variable");
+static_assert(sizeof(threadsafe_stack<int>)==sizeof(threadsafe_stack<int,std::mutex>),"a bare mutex type is policy::lock");
+
+void policy_example()
+{
+  bounded_queue bounded;  // 1 Ϊ4߻ڶʱȴ
+  std::thread producer([&]
+  {
+    for(int i=0;i<1000;++i)
+      bounded.push(i);
+  });
+  int max_size=0;
+  for(int expected=0;expected<1000;++expected)
+  {
+    max_size=std::max(max_size,int(bounded.size()));
+    std::optional<int> const value=bounded.wait_and_pop();
+    assert(value && *value==expected);
+  }
+  producer.join();
+  assert(max_size<=4 && !bounded.try_pop());
+  for(int i=0;i<4;++i)
+    assert(bounded.try_push(i));
+  assert(!bounded.try_push(4));
+
+  ring_queue strings;  // 2 ring_bufferҪʱ2Ƚȳ˳򲻱
+  for(int i=0;i<100;++i)
+    strings.push(std::to_string(i));
+  for(int i=0;i<100;++i)
+    assert(*strings.try_pop()==std::to_string(i));
+  std::thread waiter([&]
+  {
+    std::string s;
+    strings.wait_and_pop(s);
+    assert(s=="late");
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  strings.push("late");
+  waiter.join();
+
+  local_queue local;  // 3 ̣߳Ҳûֻtry_pop()
+  local.push(1);
+  local.push(2);
+  assert(*local.try_pop()==1 && local.size()==1);
+
+  threadsafe_stack<int,policy::storage<std::vector>,policy::capacity<2>,policy::return_optional> small;
+  small.push(1);
+  small.push(2);
+  bool threw=false;
+  try
+  {
+    small.push(3);
+  }
+  catch(full_stack const&)
+  {
+    threw=true;
+  }
+  assert(threw && *small.pop()==2 && *small.pop()==1 && small.empty());
+
+  threadsafe_stack<int,policy::notify_always,policy::return_unique_ptr> waiting;  // 4 ֪ͨԺջҲܵȴ
+  std::thread popper([&]
+  {
+    std::unique_ptr<int> const value=waiting.wait_and_pop();
+    assert(*value==42);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  waiting.push(42);
+  popper.join();
+  std::cout<<"queue sizes: default "<<sizeof(threadsafe_queue<int>)<<", null_mutex "<<sizeof(local_queue)
+           <<", bounded "<<sizeof(bounded_queue)<<std::endl;
+}
+
 int main()
 {
     std::cout << "Hello world!" << std::endl;
+    priority_queue_example();
+    policy_example();
     return 0;
 }
@@ -1,4 +1,21 @@
 #include <future>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "pending_table.h"
+#include "thread_pool.h"
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "connection_reactor.h"
+#endif
 
 ///ʹfutureȴ¼
 /*
@@ -378,12 +395,14 @@ std::shared_future
 ͬ״̬ȨôȨʹstd::moveȨݵstd::shared_future
 ĬϹ캯£
 */
+/*
 std::promise<int> p;
 std::future<int> f(p.get_future());
 assert(f.valid());  // 1 ֵ f ǺϷ
 std::shared_future<int> sf(std::move(f));
 assert(!f.valid());  // 2 ֵ f ǲϷ
 assert(sf.valid());  // 3 sf ǺϷ
+*/
 
 /*ֵfʼǺϷĢ٣Ϊõpromise pͬ״̬תsf״̬
 fͲϷˢڣsfǺϷˢۡ
@@ -391,8 +410,10 @@ f
 ƶһתȨǶֵʽԿͨstd::promise
 ĳԱget_future()ķֱֵӹһstd::shared_future磺*/
 
+/*
 std::promise<std::string> p;
 std::shared_future<std::string> sf(p.get_future());  // 1 ʽתȨ
+*/
 
 /*תȨʽģֵstd::shared_future<>õstd::future<std::string>
 ͵ʵ١
@@ -401,9 +422,11 @@ std::future
 ƶϣӶʼ͵ı(¼AA.6)std::futureһshare()Ա
 µstd::shared_future ҿֱתfutureȨҲܱ
 ܶͣʹô޸ģ*/
+/*
 std::promise< std::map< SomeIndexType, SomeDataType, SomeComparator,
      SomeAllocator>::iterator> p;
 auto sf=p.get_future().share();
+*/
 /*УsfƵΪstd::shared_future<std::map<SomeIndexType, SomeDataType, SomeComparator, SomeAllocator>::iterator>
 ĳȽĶֻҪpromiseͽ޸ļɡfuture
 ͻԶpromise޸Ľƥ䡣
@@ -413,3 +436,472 @@ auto sf=p.get_future().share();
 ҪȴܶԳʱָ
 */
 
+///䣺̳߳شÿεö̵߳std::async
+/*
+f6ʹstd::launch::asyncʵֶΪÿε½һ̣߳f7ʹ
+std::launch::deferredûκβСǧСͬʱʱǰߵ߳
+ԶԶCPUasync_on()(include/thread_pool.h)Ĳstd::asyncֻͬ
+ִԣնڹ̶Ĺִ߳С
+*/
+struct X
+{
+  int foo(int i,std::string const& s) { return i+static_cast<int>(s.size()); }
+};
+
+struct Y
+{
+  double operator()(double d) { return d*2; }
+};
+
+void async_on_example()
+{
+  thread_pool pool;
+  X x;
+  auto f1=async_on(pool,launch_policy::pool,&X::foo,&x,42,"hello");  // f1һp->foo(42, "hello")
+  auto f6=async_on(pool,launch_policy::inline_if_saturated,Y(),1.2);  // æʱֱڵǰִ߳
+  auto f7=async_on(pool,launch_policy::deferred,Y(),2.718);  // wait()get()ʱִ
+  assert(f1.get()==47);
+  assert(f6.get()==2.4);
+  assert(f7.get()==5.436);
+
+  auto f=async_on(pool,launch_policy::pool,[]()->int{throw std::out_of_range("x<0");});
+  try
+  {
+    f.get();
+    assert(false);
+  }
+  catch(std::out_of_range const&)  // 쳣ͬfuture
+  {}
+}
+
+/**ȳnС첽ãget()ܣغʱ()*/
+template<typename Launch>
+long long fan_out(unsigned n,Launch launch)
+{
+  auto const start=std::chrono::steady_clock::now();
+  std::vector<std::future<unsigned>> results;
+  results.reserve(n);
+  for(unsigned i=0;i<n;++i)
+    results.push_back(launch([](unsigned v){return v%7;},i));
+  unsigned long long sum=0;
+  for(auto& r : results)
+    sum+=r.get();
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  assert(sum!=0);
+  return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+void fan_out_benchmark()
+{
+  unsigned const n=100000;
+  thread_pool pool;
+  std::cout<<"fan-out of "<<n<<" async calls, "<<pool.size()<<" pool threads"<<std::endl;
+
+  try
+  {
+    std::cout<<"std::launch::async                 "
+             <<fan_out(n,[](auto f,unsigned i){return std::async(std::launch::async,f,i);})<<"ms"<<std::endl;
+  }
+  catch(std::system_error const& e)  // ߳ϵͳʱstd::asyncֱ׳쳣
+  {
+    std::cout<<"failed: "<<e.what()<<std::endl;
+  }
+  std::cout<<"std::launch::deferred              "
+           <<fan_out(n,[](auto f,unsigned i){return std::async(std::launch::deferred,f,i);})<<"ms"<<std::endl;
+  std::cout<<"launch_policy::pool                "
+           <<fan_out(n,[&](auto f,unsigned i){return async_on(pool,launch_policy::pool,f,i);})<<"ms"<<std::endl;
+  std::cout<<"launch_policy::inline_if_saturated "
+           <<fan_out(n,[&](auto f,unsigned i){return async_on(pool,launch_policy::inline_if_saturated,f,i);})<<"ms"<<std::endl;
+  std::cout<<"launch_policy::deferred            "
+           <<fan_out(n,[&](auto f,unsigned i){return async_on(pool,launch_policy::deferred,f,i);})<<"ms"<<std::endl;
+}
+
+///䣺epollprocess_connections()æѯ
+/*
+4.10ѭһֱÿӣûʱҲռһˡconnection_reactor.h
+reactor߳epoll_wait()ֻ׽־ʱȥpromise
+socketpairģӣݰɢreactor߳ϴ
+*/
+#ifdef __linux__
+long long cpu_time_us()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+  return (usage.ru_utime.tv_sec+usage.ru_stime.tv_sec)*1000000LL
+         +usage.ru_utime.tv_usec+usage.ru_stime.tv_usec;
+}
+
+void reactor_example()
+{
+  reactor r(2);
+  buffer_pool::pointer pool=buffer_pool::create();
+  auto filled=[&](std::size_t size,char c)
+  {
+    return pool->make(size,[c](char* p,std::size_t,std::size_t len){std::memset(p,c,len);});
+  };
+  std::vector<std::pair<std::shared_ptr<connection>,std::shared_ptr<connection>>> pairs;
+  for(int i=0;i<4;++i)
+  {
+    int sv[2];
+    if(socketpair(AF_UNIX,SOCK_STREAM,0,sv)!=0)
+      throw std::system_error(errno,std::generic_category(),"socketpair");
+    pairs.emplace_back(r.add(sv[0]),r.add(sv[1]));
+  }
+  int const file=::open("/dev/null",O_RDONLY);  // epollļadd()ʧʱҲѾرfd
+  assert(file>=0);
+  try
+  {
+    r.add(file);
+    assert(false);
+  }
+  catch(std::system_error const&)
+  {}
+  assert(::fcntl(file,F_GETFD)==-1 && errno==EBADF);
+
+  std::vector<std::future<payload_type>> incoming;
+  std::vector<std::future<bool>> sent;
+  for(auto& p : pairs)
+  {
+    for(std::uint32_t id=0;id<100;++id)
+    {
+      incoming.push_back(p.first->expect(id));  // ൱connection->get_promise(data.id)
+      sent.push_back(p.second->send(id,filled(id*100,static_cast<char>(id))));
+    }
+    incoming.push_back(p.first->expect(100));
+    sent.push_back(p.second->send(100,filled(1<<20,'x')));  // 1MBɶɣҪֶд
+  }
+  for(auto& f : sent)
+    assert(f.get());
+  for(std::size_t i=0;i<incoming.size();++i)
+  {
+    payload_type const data=incoming[i].get();
+    std::uint32_t const id=i%101;
+    if(id<100)
+      assert(data.to_vector()==std::vector<char>(id*100,static_cast<char>(id)));
+    else
+      assert(data.size()==(1u<<20));
+  }
+
+  long long const before=cpu_time_us();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));  // Ӷţû
+  std::cout<<"reactor: "<<incoming.size()<<" packets on "<<r.shard_count()<<" shards, cpu time while idle "
+           <<(cpu_time_us()-before)<<"us"<<std::endl;
+
+  auto late=pairs[1].first->expect(2000,std::chrono::milliseconds(20));  // Էһֱظ
+  try
+  {
+    late.get();
+    assert(false);
+  }
+  catch(request_timeout const&)
+  {}
+
+  std::size_t const packets=2000;  // 64KBݰշ˶payload
+  auto const payload=filled(64*1024,'y');
+  std::vector<std::future<payload_type>> replies;
+  auto const start=std::chrono::steady_clock::now();
+  for(std::uint32_t id=0;id<packets;++id)
+  {
+    replies.push_back(pairs[2].first->expect(id));
+    pairs[2].second->send(id,payload);  // buffer_chainֻü
+    if(replies.size()==256)  // ;󲻳pending_table
+    {
+      for(auto& f : replies)
+        assert(f.get().size()==payload.size());
+      replies.clear();
+    }
+  }
+  for(auto& f : replies)
+    assert(f.get().size()==payload.size());
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  std::cout<<"reactor: "<<packets<<" x 64KB packets, "
+           <<packets*64*1000/std::max<long long>(1,std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count())/1024
+           <<" MB/s"<<std::endl;
+
+  auto orphan=pairs[0].first->expect(1000);
+  pairs[0].second->close();  // Զ˹رգڵȴfutureõconnection_closed쳣
+  try
+  {
+    orphan.get();
+    assert(false);
+  }
+  catch(connection_closed const&)
+  {}
+}
+#endif
+
+///䣺idֱӶλ;
+/*
+connection->get_promise(data.id)std::unordered_mapʵ֣ÿݰҪϣ
+ͰңɺҪͷŽڵ㡣idʱpending_tableidĵλֱ
+λλģⴰwindow;󣺵Ǽidϵidȡ
+*/
+template<typename Add,typename Fulfil>
+long long pending_requests(std::uint32_t n,std::uint32_t window,Add add,Fulfil fulfil)
+{
+  std::vector<std::future<int>> futures(window);
+  auto const start=std::chrono::steady_clock::now();
+  long long sum=0;
+  for(std::uint32_t id=0;id<n+window;++id)
+  {
+    if(id>=window)  // ϵյظ
+    {
+      std::uint32_t const done=id-window;
+      fulfil(done,static_cast<int>(done&0xff));
+      sum+=futures[done%window].get();
+    }
+    if(id<n)
+      futures[id%window]=add(id);
+  }
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  assert(sum>0);
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void pending_table_benchmark()
+{
+  std::uint32_t const n=1000000;
+  for(std::uint32_t window : {16u,1024u,65536u})
+  {
+    std::unordered_map<std::uint32_t,std::promise<int>> map;
+    long long const map_us=pending_requests(n,window,
+      [&](std::uint32_t id){return map[id].get_future();},
+      [&](std::uint32_t id,int v)
+      {
+        auto const it=map.find(id);
+        it->second.set_value(v);
+        map.erase(it);
+      });
+
+    pending_table<int> table(window);
+    long long const table_us=pending_requests(n,window,
+      [&](std::uint32_t id){return table.add(id);},
+      [&](std::uint32_t id,int v){table.fulfil(id,v);});
+
+    std::cout<<"window "<<window<<": unordered_map "<<n*1000LL/map_us<<" req/ms, pending_table "
+             <<n*1000LL/table_us<<" req/ms"<<std::endl;
+  }
+}
+
+///䣺Ĺȡ˫˶
+/*
+εÿ̴߳Լеĵײȡ񣬿е̴߳ӱ˶еĶ͵
+work_stealing_deque.hChaseCLevУownerpush()/pop()steal()
+compare_exchangeȡԼownerԪأʱepoch_domainա
+ѹԴ2ʼownerpush()һpop()һ룬߳ͬʱsteal()
+ȡͬʱownerÿ֮óCPUȡ͵Ԫغٺһȡ꣬
+һԪءÿǡñȡһ(ûжʧҲûظ)ȡȷʵȡ
+*/
+#include <atomic>
+#include <random>
+#include <thread>
+#include "work_stealing_deque.h"
+
+void work_stealing_example()
+{
+  std::uint32_t const n=200000;
+  work_stealing_deque<std::uint32_t> deque(2);
+  std::atomic<bool> done(false);
+  std::vector<std::vector<std::uint32_t>> taken(4);
+  std::vector<std::thread> thieves;
+  std::atomic<unsigned> lost_races(0);
+  std::atomic<unsigned> stolen(0);
+  for(unsigned k=1;k<4;++k)
+    thieves.emplace_back([&,k]
+    {
+      for(;;)
+      {
+        bool const finished=done.load(std::memory_order_acquire);  // 1 ȶ־ΪtrueʱownerѾpush͵һΪվͽ
+        std::uint32_t value;
+        switch(deque.steal(value))
+        {
+        case work_stealing_deque<std::uint32_t>::steal_result::stolen:
+          taken[k].push_back(value);
+          stolen.fetch_add(1,std::memory_order_relaxed);
+          continue;
+        case work_stealing_deque<std::uint32_t>::steal_result::lost_race:
+          lost_races.fetch_add(1,std::memory_order_relaxed);
+          continue;
+        case work_stealing_deque<std::uint32_t>::steal_result::empty:
+          if(finished)
+            return;
+          std::this_thread::yield();
+        }
+      }
+    });
+
+  std::mt19937 rng(7);
+  std::uint32_t next=0;
+  while(next<n)
+  {
+    std::uint32_t const batch=std::min<std::uint32_t>(n-next,rng()%64+1);
+    for(std::uint32_t i=0;i<batch;++i)
+      deque.push(next++);
+    for(std::uint32_t i=rng()%(batch/2+1);i>0;--i)
+    {
+      std::uint32_t value;
+      if(deque.pop(value))
+        taken[0].push_back(value);
+    }
+    if(rng()%16==0)
+      std::this_thread::yield();  // 2 Ҳȡлowner push()/pop()ļ϶
+  }
+  while(!stolen.load(std::memory_order_relaxed))
+    std::this_thread::yield();
+  std::uint32_t value;
+  while(deque.pop(value))
+    taken[0].push_back(value);
+  done.store(true,std::memory_order_release);
+  for(auto& t : thieves)
+    t.join();
+
+  std::vector<unsigned char> seen(n,0);
+  for(auto const& values : taken)
+    for(std::uint32_t v : values)
+      ++seen[v];
+  assert(std::all_of(seen.begin(),seen.end(),[](unsigned char c){return c==1;}));
+  assert(taken[1].size()+taken[2].size()+taken[3].size()>0);
+  assert(deque.empty() && deque.capacity()>=2);
+  std::cout<<"work_stealing_deque: owner took "<<taken[0].size()<<", thieves took "
+           <<taken[1].size()+taken[2].size()+taken[3].size()<<", lost races "<<lost_races.load()
+           <<", capacity "<<deque.capacity()<<std::endl;
+}
+
+///䣺ݹʱfork_joinstd::async
+/*
+std::asyncݹزֿÿһ㶼̣߳async_quick_sortͳͬʱ
+߳һǼǧǴ󲿷ʱget()ϡ
+fork_join.hеparallel_quick_sortparallel_invokeݹ飬̶߳Ϊfork_join_pool
+̼߳ϵ̣߳ȴ̰߳æִбtree_sumfork_joinspawn()/sync()
+ͳƲ̣߳ټ׳쳣sync()ʱߡ
+*/
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include "fork_join.h"
+
+void async_quick_sort(std::vector<int>::iterator first,std::vector<int>::iterator last,
+                      std::atomic<int>& live,std::atomic<int>& peak)
+{
+  if(last-first<=2048)
+  {
+    std::sort(first,last);
+    return;
+  }
+  int const pivot=*(first+(last-first)/2);
+  auto const lower_end=std::partition(first,last,[pivot](int x){return x<pivot;});
+  auto const upper_begin=std::partition(lower_end,last,[pivot](int x){return !(pivot<x);});
+  auto lower=std::async(std::launch::async,[&,first,lower_end]
+  {
+    int const now=live.fetch_add(1)+1;
+    int seen=peak.load();
+    while(now>seen && !peak.compare_exchange_weak(seen,now))
+      ;
+    async_quick_sort(first,lower_end,live,peak);
+    live.fetch_sub(1);
+  });
+  async_quick_sort(upper_begin,last,live,peak);
+  lower.get();  // ߳ʲôҲ
+}
+
+long long tree_sum(fork_join_pool& pool,unsigned depth,std::mutex& m,std::set<std::thread::id>& threads)
+{
+  if(depth==0)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    threads.insert(std::this_thread::get_id());
+    return 1;
+  }
+  long long left=0,right=0;
+  fork_join group(pool);
+  group.spawn([&]{left=tree_sum(pool,depth-1,m,threads);});
+  right=tree_sum(pool,depth-1,m,threads);
+  group.sync();
+  return left+right;
+}
+
+void fork_join_example()
+{
+  std::vector<int> data(1<<20);
+  std::mt19937 gen(3);
+  for(auto& x : data)
+    x=int(gen()%100000);  // 1 ظļ
+  std::vector<int> expected(data);
+  std::sort(expected.begin(),expected.end());
+
+  std::vector<int> work(data);
+  std::atomic<int> live(1),peak(1);
+  auto start=std::chrono::steady_clock::now();
+  try
+  {
+    async_quick_sort(work.begin(),work.end(),live,peak);
+    assert(work==expected);
+    std::cout<<"std::async quick sort: "<<std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now()-start).count()<<"ms, up to "<<peak.load()<<" threads"<<std::endl;
+  }
+  catch(std::system_error const& e)
+  {
+    std::cout<<"std::async quick sort failed: "<<e.what()<<std::endl;
+  }
+
+  fork_join_pool pool(3);  // 2 ڵ˵ĻҲй߳̿ȡ
+  work=data;
+  start=std::chrono::steady_clock::now();
+  parallel_quick_sort(pool,work.begin(),work.end());
+  assert(work==expected);
+  std::cout<<"fork_join quick sort: "<<std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now()-start).count()<<"ms, "<<pool.size()+1<<" threads"<<std::endl;
+
+  work=data;
+  parallel_quick_sort(work.begin(),work.end());  // Ĭ̳߳أ߳Ϊhardware_concurrency()
+  assert(work==expected);
+
+  std::vector<int> pipe(1<<16);  // 󽵣cutoff=2ʱһֱֵףȳ2*log2(n)Ĳֽstd::sort
+  for(std::size_t i=0;i<pipe.size();++i)
+    pipe[i]=int(i<pipe.size()/2 ? i : pipe.size()-i);
+  parallel_quick_sort(pool,pipe.begin(),pipe.end(),std::less<>(),2);
+  assert(std::is_sorted(pipe.begin(),pipe.end()));
+
+  std::mutex m;
+  std::set<std::thread::id> threads;
+  assert(tree_sum(pool,14,m,threads)==(1<<14));
+  assert(threads.size()<=pool.size()+1);
+
+  int calls=0;
+  try
+  {
+    parallel_invoke(pool,[&]{++calls;},[]{throw std::runtime_error("task failed");});
+    assert(false);
+  }
+  catch(std::runtime_error const& e)
+  {
+    assert(calls==1 && std::string(e.what())=="task failed");
+  }
+  fork_join group(pool);
+  group.spawn([]{throw std::logic_error("first");});
+  group.spawn([]{});
+  try
+  {
+    group.sync();
+    assert(false);
+  }
+  catch(std::logic_error const&)
+  {}
+  group.spawn([&]{++calls;});
+  group.sync();  // 쳣Ѿȡߣ֮Լʹ
+  assert(calls==2);
+}
+
+int main()
+{
+    async_on_example();
+    fan_out_benchmark();
+#ifdef __linux__
+    reactor_example();
+#endif
+    pending_table_benchmark();
+    work_stealing_example();
+    fork_join_example();
+    return 0;
+}
@@ -1,3 +1,18 @@
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <cassert>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <mutex>
+#include "fast_clock.h"
+#include "pending_table.h"
+#include "threadsafe_queue.h"
+#include "timer_wheel.h"
+
 ///4.3 ʱȴ
 
 /*ûὫ̹߳һ(ȷ)ʱ䣬ֱӦ¼ͨ£
@@ -100,9 +115,11 @@ minutes(1)-seconds(55)
 ʱεĵȴstd::chrono::duration<>ɡ磺ȴfuture״̬Ϊ
 Ҫ35룺
 */
+/*
 std::future<int> f=std::async(some_task);
 if(f.wait_for(std::chrono::milliseconds(35))==std::future_status::ready)
   do_something_with(f.get());
+*/
 
 /*ȴ᷵״ֵ̬ʾǵȴʱǼȴȴfutureʱʱ᷵
 std::future_status::timeoutfuture״̬ı䣬᷵std::future_status::ready
@@ -131,3 +148,165 @@ std::future_status::timeout
 
 
 
+
+///䣺Ѵֹʱ佻ʱ
+/*
+f.wait_for(35ms)ÿζһʱȴͬʱмʮԴŽֹ
+ʱʱtimer_wheel.hеķֲʱְǼйӡȡO(1)ͬһtick
+ڵĶʱһλȫʱֱadvance(now)ƽ
+manual_clock(fast_clock.h)Ϊ
+*/
+void timer_wheel_example()
+{
+  timer_wheel<manual_clock> wheel(1ms);
+  std::vector<int> fired;
+  auto const t0=manual_clock::now();
+  wheel.arm(t0+5ms,[&]{fired.push_back(5);});
+  auto const cancelled=wheel.arm(t0+3ms,[&]{fired.push_back(3);});
+  wheel.arm(t0+300ms,[&]{fired.push_back(300);});  // ڵ1㣬256msʱ·䵽0
+  wheel.arm(t0+70s,[&]{fired.push_back(70000);});  // ڵ2
+  assert(wheel.cancel(cancelled));
+  assert(!wheel.cancel(cancelled));  // ͬһhandleֻȡһ
+  assert(wheel.next_expiry()==t0+5ms);
+
+  assert(wheel.advance(t0+4ms)==0);
+  assert(wheel.advance(t0+5ms)==1);
+  assert(wheel.advance(t0+299ms)==0);
+  assert(wheel.advance(t0+300ms)==1);
+  assert(wheel.advance(t0+69999ms)==0);
+  assert(wheel.advance(t0+70s)==1);
+  assert((fired==std::vector<int>{5,300,70000}));
+  assert(wheel.size()==0 && wheel.next_expiry()==manual_clock::time_point::max());
+
+  auto const h=wheel.arm(t0+71s,[&]{fired.push_back(71000);});
+  wheel.advance(t0+71s);
+  assert(!wheel.cancel(h));  // Ѿ
+}
+
+void queue_timeout_example()
+{
+  threadsafe_queue<int> q;
+  timer_service<> timers;
+  int value=0;
+  auto const start=std::chrono::steady_clock::now();
+  assert(!q.wait_and_pop_for(value,35ms,timers));
+  assert(std::chrono::steady_clock::now()-start>=35ms);
+  assert(!q.wait_and_pop_for(value,1ms));
+
+  std::thread producer([&]{std::this_thread::sleep_for(5ms);q.push(42);});
+  assert(q.wait_and_pop_for(value,10s,timers) && value==42);
+  producer.join();
+
+  deadline_promise<int> late(timers,std::chrono::steady_clock::now()+10ms);
+  std::future<int> f=late.get_future();
+  try
+  {
+    f.get();  // Ҫwait_forʱ쳣ʽ͵
+    assert(false);
+  }
+  catch(request_timeout const&)
+  {}
+  assert(!late.set_value(1));
+}
+
+/*
+nÿ100~500ms֮Ľֹʱ䣬дԼųڵǰͱȡ(ʱ)
+timer_serviceֻ߳ĶʱʱĴԶڶʱĸ
+*/
+void timer_benchmark()
+{
+  unsigned const n=200000;
+  timer_service<> timers;
+  std::atomic<unsigned> fired(0);
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> timeout_ms(100,500);
+  std::vector<timer_service<>::handle> handles;
+  handles.reserve(n);
+
+  auto const start=std::chrono::steady_clock::now();
+  for(unsigned i=0;i<n;++i)
+    handles.push_back(timers.arm_after(std::chrono::milliseconds(timeout_ms(rng)),[&]{++fired;}));
+  auto const armed=std::chrono::steady_clock::now();
+  unsigned cancelled=0;
+  for(unsigned i=0;i<n;++i)
+    if(i%10 && timers.cancel(handles[i]))
+      ++cancelled;
+  auto const done=std::chrono::steady_clock::now();
+  while(fired+cancelled<n)  // size()Ϊ0ʱ󼸸صִܻ
+    std::this_thread::sleep_for(10ms);
+  assert(timers.size()==0);
+
+  auto const ns_per=[n](std::chrono::steady_clock::duration d)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()/n;
+  };
+  std::cout<<n<<" timers: arm "<<ns_per(armed-start)<<"ns, cancel "<<ns_per(done-armed)
+           <<"ns each; "<<fired<<" fired in "<<timers.wakeup_count()<<" wakeups"<<std::endl;
+}
+
+///䣺Сʱ
+/*
+4.3.1ܵļʱӣnow()Linux϶ҪһvDSOáfast_clock(fast_clock.h)
+ֱӶȡУ׼TSCͬʱӵҪԿֱӽwait_until()
+manual_clockֶֻʱߣԳʱ·Ҫ˯ߡ
+*/
+template<typename Clock>
+double now_cost_ns(unsigned n)
+{
+  auto const start=std::chrono::steady_clock::now();
+  unsigned long long sink=0;
+  for(unsigned i=0;i<n;++i)
+    sink^=static_cast<unsigned long long>(Clock::now().time_since_epoch().count());
+  auto const elapsed=std::chrono::steady_clock::now()-start;
+  assert(sink!=0);
+  return std::chrono::duration<double,std::nano>(elapsed).count()/n;
+}
+
+void clock_example()
+{
+  unsigned const n=10000000;
+  std::cout<<"fast_clock "<<(fast_clock::uses_tsc() ? "uses TSC at " : "falls back to steady_clock")
+           <<(fast_clock::uses_tsc() ? fast_clock::tsc_frequency()/1e9 : 0)<<"GHz"<<std::endl;
+  std::cout<<"now() cost: system_clock "<<now_cost_ns<std::chrono::system_clock>(n)
+           <<"ns, steady_clock "<<now_cost_ns<std::chrono::steady_clock>(n)
+           <<"ns, high_resolution_clock "<<now_cost_ns<std::chrono::high_resolution_clock>(n)
+           <<"ns, fast_clock "<<now_cost_ns<fast_clock>(n)<<"ns"<<std::endl;
+
+  auto const steady_start=std::chrono::steady_clock::now();
+  auto const fast_start=fast_clock::now();
+  std::this_thread::sleep_for(20ms);
+  auto const steady_ms=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-steady_start);
+  auto const fast_ms=std::chrono::duration_cast<std::chrono::milliseconds>(fast_clock::now()-fast_start);
+  assert(fast_ms-steady_ms<=1ms && steady_ms-fast_ms<=1ms);
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::unique_lock<std::mutex> lk(m);
+  auto const deadline=fast_clock::now()+10ms;
+  while(cv.wait_until(lk,deadline)!=std::cv_status::timeout)  // ʱӵ÷һ
+    ;
+  assert(fast_clock::now()>=deadline);
+
+  pending_table<int,manual_clock> table(16);  // ˯ߣֱӰʱӲֹʱ
+  auto f=table.add(1,manual_clock::now()+35ms);
+  manual_clock::advance(34ms);
+  assert(table.expire(manual_clock::now())==0);
+  manual_clock::advance(1ms);
+  assert(table.expire(manual_clock::now())==1);
+  try
+  {
+    f.get();
+    assert(false);
+  }
+  catch(request_timeout const&)
+  {}
+}
+
+int main()
+{
+    clock_example();
+    timer_wheel_example();
+    queue_timeout_example();
+    timer_benchmark();
+    return 0;
+}
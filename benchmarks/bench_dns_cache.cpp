@@ -0,0 +1,71 @@
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "distributed_shared_mutex.h"
+#include "dns_cache.h"
+
+/*
+dns_cacheӳ٣find_entry()дupdate_or_add_entry()
+Ƚstd::shared_mutexdistributed_shared_mutexdns_skiplist_mapͰŴŵ
+dns_compact_mapشСĳȣ255ֽ(DNSֵ)
+Ԥȷdomain_count߳ԲͬĲʡ
+*/
+
+unsigned const domain_count=1024;
+
+std::vector<std::string> make_domains(std::size_t length)
+{
+  std::vector<std::string> domains;
+  for(unsigned i=0;i<domain_count;++i)
+  {
+    std::string domain="host"+std::to_string(i)+".example.com";
+    if(domain.size()<length)
+      domain.insert(0,length-domain.size(),'w');
+    domains.push_back(domain);
+  }
+  return domains;
+}
+
+template<typename Policy>
+bench::operation cache_operation(bench::config const& cfg)
+{
+  struct state
+  {
+    dns_cache<Policy> cache;
+    std::vector<std::string> domains;
+  };
+  auto const s=std::make_shared<state>();
+  s->domains=make_domains(cfg.payload);
+  for(auto const& domain : s->domains)
+    s->cache.update_or_add_entry(domain,dns_entry());
+  return [s](unsigned thread,std::uint64_t i,bool read)
+  {
+    std::string const& domain=s->domains[(i*(2*thread+1))%domain_count];
+    if(read)
+    {
+      dns_entry entry;
+      volatile bool const found=s->cache.find_entry(domain,entry);  // ûõʱܰѲɾ
+      (void)found;
+    }
+    else
+      s->cache.update_or_add_entry(domain,dns_entry());
+  };
+}
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=200000;
+  defaults.read_percents={100,99,90};
+  defaults.payloads={16,64};
+  defaults.max_payload=string_interner::max_length;  // dns_compact_mapܾ
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+  h.run("dns_cache<std::shared_mutex>",cache_operation<std::shared_mutex>);
+  h.run("dns_cache<distributed_shared_mutex<>>",cache_operation<distributed_shared_mutex<>>);
+  h.run("dns_cache<dns_skiplist_map>",cache_operation<dns_skiplist_map>);
+  h.run("dns_cache<dns_compact_map<>>",cache_operation<dns_compact_map<>>);
+  return h.finish();
+}
@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "dns_cache.h"
+
+/*
+ϼͨңdns_cache<std::shared_mutex>ÿȥһǩһstd::map
+dns_cache<dns_trie_map>ӵǩǰ׺һΡpayloadǺϳɵ
+16µsiteKÿwwwmail*¼ѯЩǰ
+ټһǩԼ˷֮һڲڵĶϡңдһе
+¼(ǰ׺ҪƴӸҶӵ·ڵӽڵܴдȶö)
+ͬһpayloadĻֻһΣ֮乲á
+*/
+
+unsigned const tld_count=16;
+unsigned const query_count=1<<16;
+
+std::string synthetic_zone(std::uint64_t site)
+{
+  return "site"+std::to_string(site)+".tld"+std::to_string(site%tld_count);
+}
+
+std::vector<std::string> make_records(std::size_t domain_count)
+{
+  std::vector<std::string> records;
+  records.reserve(domain_count);
+  char const* const hosts[]={"","www.","mail.","*."};
+  for(std::uint64_t i=0;records.size()<domain_count;++i)
+    records.push_back(hosts[i%4]+synthetic_zone(i/4));
+  return records;
+}
+
+std::vector<std::string> make_queries(std::size_t domain_count)
+{
+  std::vector<std::string> queries;
+  std::uint64_t const sites=(domain_count+3)/4;
+  std::uint64_t x=88172645463325252ull;  // xorshiftÿеĲѯͬ
+  for(unsigned i=0;i<query_count;++i)
+  {
+    x^=x<<13;
+    x^=x>>7;
+    x^=x<<17;
+    std::string zone=synthetic_zone(x%sites);
+    if(x%8==0)
+      zone+="x";  // ڵĶ
+    switch((x>>8)%3)
+    {
+    case 0: queries.push_back("host"+std::to_string(x%100)+"."+zone); break;
+    case 1: queries.push_back("a.b.www."+zone); break;
+    default: queries.push_back("mail."+zone); break;
+    }
+  }
+  return queries;
+}
+
+template<typename Policy>
+struct suffix_state
+{
+  dns_cache<Policy> cache;
+  std::vector<std::string> records;
+  std::vector<std::string> queries;
+};
+
+template<typename Policy>
+std::shared_ptr<suffix_state<Policy>> shared_state(std::size_t domain_count)
+{
+  static std::map<std::size_t,std::shared_ptr<suffix_state<Policy>>> built;
+  auto& s=built[domain_count];
+  if(!s)
+  {
+    s=std::make_shared<suffix_state<Policy>>();
+    s->records=make_records(domain_count);
+    s->queries=make_queries(domain_count);
+    std::vector<std::pair<std::string,dns_entry>> batch;
+    batch.reserve(s->records.size());
+    for(auto const& record : s->records)
+      batch.emplace_back(record,dns_entry());
+    s->cache.update_or_add_entries(batch.begin(),batch.end());
+  }
+  return s;
+}
+
+template<typename Policy,bool Wildcard>
+bench::operation suffix_operation(bench::config const& cfg)
+{
+  auto const s=shared_state<Policy>(cfg.payload ? cfg.payload : 1);
+  return [s](unsigned thread,std::uint64_t i,bool read)
+  {
+    std::uint64_t const k=i*(2*thread+1);
+    if(read)
+    {
+      std::string const& query=s->queries[k%query_count];
+      dns_entry entry;
+      if(Wildcard)
+      {
+        volatile bool const found=s->cache.find_with_wildcard(query,entry);
+        (void)found;
+      }
+      else
+      {
+        std::string zone;
+        volatile bool const found=s->cache.find_closest_enclosing(query,zone,entry);
+        (void)found;
+      }
+    }
+    else
+      s->cache.update_or_add_entry(s->records[k%s->records.size()],dns_entry());
+  };
+}
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=100000;
+  defaults.read_percents={100,99};
+  defaults.payloads={1000000};
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+  h.run("closest_enclosing dns_cache<std::shared_mutex>",suffix_operation<std::shared_mutex,false>);
+  h.run("closest_enclosing dns_cache<dns_trie_map>",suffix_operation<dns_trie_map,false>);
+  h.run("wildcard dns_cache<std::shared_mutex>",suffix_operation<std::shared_mutex,true>);
+  h.run("wildcard dns_cache<dns_trie_map>",suffix_operation<dns_trie_map,true>);
+  return h.finish();
+}
@@ -0,0 +1,36 @@
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "benchmark.h"
+#include "parallel_algorithms.h"
+
+/*
+parallel_accumulatestd::accumulateıȽϡÿβǶpayloaddoubleһͣ
+߳Ϊ̳߳صĹ߳ϵ̡߳
+*/
+
+volatile double sink;
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=20;
+  defaults.payloads={1<<20,1<<23};
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+  h.run("std::accumulate",[](bench::config const& cfg) -> bench::operation
+  {
+    auto const data=std::make_shared<std::vector<double>>(cfg.payload,1.0);
+    return [data](unsigned,std::uint64_t,bool){sink=std::accumulate(data->begin(),data->end(),0.0);};
+  },bench::mode::serial);
+  h.run("parallel_accumulate",[](bench::config const& cfg) -> bench::operation
+  {
+    auto const data=std::make_shared<std::vector<double>>(cfg.payload,1.0);
+    auto const pool=std::make_shared<thread_pool>(cfg.threads-1);
+    return [data,pool](unsigned,std::uint64_t,bool)
+    {
+      sink=parallel_accumulate(*pool,data->begin(),data->end(),0.0);
+    };
+  },bench::mode::collective);
+  return h.finish();
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "fork_join.h"
+#include "parallel_algorithms.h"
+
+/*
+parallel_algorithms.hи㷨Ӧstd::㷨ıȽϡÿβǶpayloaddouble
+һã߳Ϊ̳߳صĹ߳ϵ̡߳޸㷨(for_each
+partitionsort)ÿȰԭʼݸƵƵʱҲڡ
+һȽͬĵݹ֣ÿstd::async(std::launch::async)ʱ߳
+fork_joinparallel_quick_sortֻʹfork_join_poolthreads-1̼߳ӵ̡߳
+*/
+
+volatile long found_at;
+
+struct algorithm_state
+{
+  std::vector<double> input;
+  std::vector<double> work;
+  std::vector<double> output;
+  std::unique_ptr<thread_pool> pool;
+
+  algorithm_state(bench::config const& cfg): input(cfg.payload),work(cfg.payload),output(cfg.payload),
+    pool(new thread_pool(cfg.threads-1))
+  {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(0,1);
+    for(auto& x : input)
+      x=dist(gen);
+  }
+
+  void restore()
+  {
+    std::copy(input.begin(),input.end(),work.begin());
+  }
+};
+
+/**parallel_quick_sortͬĻ֣ÿһ㶼std::asyncһ߳*/
+template<typename RandomIt>
+void async_quick_sort(RandomIt first,RandomIt last)
+{
+  if(last-first<=2048)
+  {
+    std::sort(first,last);
+    return;
+  }
+  auto const pivot=*(first+(last-first)/2);
+  RandomIt const lower_end=std::partition(first,last,[&](auto const& x){return x<pivot;});
+  RandomIt const upper_begin=std::partition(lower_end,last,[&](auto const& x){return !(pivot<x);});
+  auto lower=std::async(std::launch::async,[=]{async_quick_sort(first,lower_end);});
+  async_quick_sort(upper_begin,last);
+  lower.get();
+}
+
+/**f(algorithm_state&)װoperation*/
+template<typename Function>
+bench::factory algorithm(Function f)
+{
+  return [f](bench::config const& cfg) -> bench::operation
+  {
+    auto const s=std::make_shared<algorithm_state>(cfg);
+    return [s,f](unsigned,std::uint64_t,bool){f(*s);};
+  };
+}
+
+/**f(algorithm_state&,fork_join_pool&)װoperationֻЩԲŴfork_join_pool*/
+template<typename Function>
+bench::factory fork_join_algorithm(Function f)
+{
+  return [f](bench::config const& cfg) -> bench::operation
+  {
+    auto const s=std::make_shared<algorithm_state>(cfg);
+    auto const tasks=std::make_shared<fork_join_pool>(cfg.threads-1);
+    return [s,tasks,f](unsigned,std::uint64_t,bool){f(*s,*tasks);};
+  };
+}
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=10;
+  defaults.payloads={1<<20};
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+
+  auto const square=[](double& x){x=x*x+1.0;};
+  auto const half=[](double x){return x*0.5;};
+  auto const small=[](double x){return x<0.5;};
+  bench::mode const serial=bench::mode::serial;
+  bench::mode const parallel=bench::mode::collective;
+
+  h.run("std::for_each (copy+run)",algorithm([&](algorithm_state& s){
+    s.restore();
+    std::for_each(s.work.begin(),s.work.end(),square);}),serial);
+  h.run("parallel_for_each (copy+run)",algorithm([&](algorithm_state& s){
+    s.restore();
+    parallel_for_each(*s.pool,s.work.begin(),s.work.end(),square);}),parallel);
+  h.run("std::transform",algorithm([&](algorithm_state& s){
+    std::transform(s.input.begin(),s.input.end(),s.output.begin(),half);}),serial);
+  h.run("parallel_transform",algorithm([&](algorithm_state& s){
+    parallel_transform(*s.pool,s.input.begin(),s.input.end(),s.output.begin(),half);}),parallel);
+  h.run("std::find (no match)",algorithm([&](algorithm_state& s){
+    found_at=std::find(s.input.begin(),s.input.end(),2.0)-s.input.begin();}),serial);
+  h.run("parallel_find (no match)",algorithm([&](algorithm_state& s){
+    found_at=parallel_find(*s.pool,s.input.begin(),s.input.end(),2.0)-s.input.begin();}),parallel);
+  h.run("std::partial_sum",algorithm([&](algorithm_state& s){
+    std::partial_sum(s.input.begin(),s.input.end(),s.output.begin());}),serial);
+  h.run("parallel_partial_sum",algorithm([&](algorithm_state& s){
+    parallel_partial_sum(*s.pool,s.input.begin(),s.input.end(),s.output.begin());}),parallel);
+  h.run("std::partition (copy+run)",algorithm([&](algorithm_state& s){
+    s.restore();
+    std::partition(s.work.begin(),s.work.end(),small);}),serial);
+  h.run("parallel_partition (copy+run)",algorithm([&](algorithm_state& s){
+    s.restore();
+    parallel_partition(*s.pool,s.work.begin(),s.work.end(),small);}),parallel);
+  h.run("std::sort (copy+run)",algorithm([&](algorithm_state& s){
+    s.restore();
+    std::sort(s.work.begin(),s.work.end());}),serial);
+  h.run("parallel_sort (copy+run)",algorithm([&](algorithm_state& s){
+    s.restore();
+    parallel_sort(*s.pool,s.work.begin(),s.work.end());}),parallel);
+  h.run("std::async quick sort (copy+run)",algorithm([&](algorithm_state& s){
+    s.restore();
+    async_quick_sort(s.work.begin(),s.work.end());}),serial);
+  h.run("parallel_quick_sort (copy+run)",fork_join_algorithm([&](algorithm_state& s,fork_join_pool& tasks){
+    s.restore();
+    parallel_quick_sort(tasks,s.work.begin(),s.work.end());}),parallel);
+  return h.finish();
+}
@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "benchmark.h"
+#include "threadsafe_priority_queue.h"
+
+/*
+threadsafe_priority_queue(kĶ)std::priority_queueȽϣ
+try_pop()дpush()ÿֿʼǰԤƵĶ
+һЩԪء
+*/
+
+template<typename Payload>
+struct prioritized
+{
+  std::uint64_t key;
+  Payload body;
+};
+
+template<typename Payload>
+struct lower_key
+{
+  bool operator()(prioritized<Payload> const& lhs,prioritized<Payload> const& rhs) const
+  {
+    return lhs.key<rhs.key;
+  }
+};
+
+/**飺һstd::priority_queue*/
+template<typename T,typename Compare>
+class locked_priority_queue
+{
+  std::mutex m;
+  std::priority_queue<T,std::vector<T>,Compare> data;
+
+public:
+  void push(T value)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    data.push(std::move(value));
+  }
+
+  bool try_pop(T& value)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if(data.empty())
+      return false;
+    value=data.top();
+    data.pop();
+    return true;
+  }
+};
+
+template<template<typename,typename> class Queue>
+bench::factory priority_queue_operation()
+{
+  return [](bench::config const& cfg)
+  {
+    return bench::with_payload(cfg.payload,[&](auto tag) -> bench::operation
+    {
+      typedef prioritized<typename decltype(tag)::type> value_type;
+      auto const queue=std::make_shared<Queue<value_type,lower_key<typename decltype(tag)::type>>>();
+      unsigned long const expected_reads=cfg.ops*cfg.threads/100*cfg.read_percent;
+      for(unsigned long i=0;i<expected_reads+expected_reads/10+1000;++i)
+        queue->push(value_type{(i*0x9e3779b97f4a7c15ull)>>16,{}});
+      return [queue](unsigned thread,std::uint64_t i,bool read)
+      {
+        if(read)
+        {
+          value_type value;
+          queue->try_pop(value);
+        }
+        else
+          queue->push(value_type{((i<<8|thread)*0x9e3779b97f4a7c15ull)>>16,{}});
+      };
+    });
+  };
+}
+
+template<typename T,typename Compare>
+using multi_queue=threadsafe_priority_queue<T,Compare>;
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=100000;
+  defaults.read_percents={50};
+  defaults.payloads={8,64};
+  defaults.payload_sizes=bench::payload_type_sizes();
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+  h.run("std::priority_queue+std::mutex",priority_queue_operation<locked_priority_queue>());
+  h.run("threadsafe_priority_queue",priority_queue_operation<multi_queue>());
+  return h.finish();
+}
@@ -0,0 +1,68 @@
+#include <memory>
+#include <type_traits>
+
+#include "benchmark.h"
+#include "spin_mutex.h"
+#include "threadsafe_queue.h"
+
+/*
+threadsafe_queueӳ٣try_pop()дpush()ÿ̰߳
+ִСÿֿʼǰԤƵĶһЩԪأtry_pop()ȡ
+漸container_policies.hеĲԣֻеȴʱ֪ͨring_bufferԪءн
+(㹻ֻĿ)Լtry_pop()shared_ptroptionalĲ
+null_mutexİ汾ֻһ߳ʹãΪûͬĵ̲߳ա
+*/
+
+template<bool ByResult,typename... Options>
+bench::factory queue_factory()
+{
+  return [](bench::config const& cfg)
+  {
+    return bench::with_payload(cfg.payload,[&](auto tag) -> bench::operation
+    {
+      typedef typename decltype(tag)::type value_type;
+      typedef threadsafe_queue<value_type,Options...> queue_type;
+      auto const queue=std::make_shared<queue_type>();
+      unsigned long const expected_reads=cfg.ops*cfg.threads/100*cfg.read_percent;
+      for(unsigned long i=0;i<expected_reads+expected_reads/10+1000;++i)
+        queue->push(value_type());
+      return [queue](unsigned,std::uint64_t i,bool read)
+      {
+        if constexpr(std::is_same<typename queue_type::mutex_type,null_mutex>::value)
+          read=(i&1)!=0;  // 1 serialģʽֻж̲߳ոΪpush/pop棬50%Ӧ
+        if(!read)
+          queue->push(value_type());
+        else if constexpr(ByResult)
+        {
+          typename queue_type::result_type const value=queue->try_pop();  // ֵķ䷽ʽɲԾ
+          volatile bool const found=bool(value);
+          (void)found;
+        }
+        else
+        {
+          value_type value;
+          queue->try_pop(value);
+        }
+      };
+    });
+  };
+}
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=100000;
+  defaults.read_percents={50};
+  defaults.payloads={8,256};
+  defaults.payload_sizes=bench::payload_type_sizes();
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+  h.run("threadsafe_queue",queue_factory<false>());
+  h.run("threadsafe_queue<notify_waiters>",queue_factory<false,policy::notify_waiters>());
+  h.run("threadsafe_queue<storage<ring_buffer>>",queue_factory<false,policy::storage<ring_buffer>>());
+  h.run("threadsafe_queue<capacity<1<<22>>",queue_factory<false,policy::capacity<(1<<22)>>());
+  h.run("threadsafe_queue<lock<spin_mutex>>",queue_factory<false,policy::lock<spin_mutex>>());
+  h.run("threadsafe_queue try_pop() shared_ptr",queue_factory<true>());
+  h.run("threadsafe_queue try_pop() return_optional",queue_factory<true,policy::return_optional>());
+  h.run("threadsafe_queue<lock<null_mutex>>",queue_factory<false,policy::lock<null_mutex>>(),bench::mode::serial);
+  return h.finish();
+}
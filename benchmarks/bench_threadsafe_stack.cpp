@@ -0,0 +1,77 @@
+#include <memory>
+#include <type_traits>
+#include <mutex>
+#include <vector>
+
+#include "benchmark.h"
+#include "spin_mutex.h"
+#include "threadsafe_stack.h"
+
+/*
+threadsafe_stackڲͬµӳ٣pop()дpush()
+ÿֿʼǰԤƵĶѹһЩԪأpop()ջ
+༸Ƚcontainer_policies.hеĲԣstd::vectorײ֪ͨ
+pop()shared_ptroptionalnull_mutexǵ̵߳Ĳա
+*/
+
+template<bool ByResult,typename... Options>
+bench::factory stack_factory()
+{
+  return [](bench::config const& cfg)
+  {
+    return bench::with_payload(cfg.payload,[&](auto tag) -> bench::operation
+    {
+      typedef typename decltype(tag)::type value_type;
+      typedef threadsafe_stack<value_type,Options...> stack_type;
+      auto const stack=std::make_shared<stack_type>();
+      unsigned long const expected_reads=cfg.ops*cfg.threads/100*cfg.read_percent;
+      for(unsigned long i=0;i<expected_reads+expected_reads/10+1000;++i)
+        stack->push(value_type());
+      return [stack](unsigned,std::uint64_t i,bool read)
+      {
+        if constexpr(std::is_same<typename stack_type::mutex_type,null_mutex>::value)
+          read=(i&1)!=0;  // 1 serialģʽֻж̲߳ոΪpush/pop棬50%Ӧ
+        if(!read)
+        {
+          stack->push(value_type());
+          return;
+        }
+        try
+        {
+          if constexpr(ByResult)
+          {
+            typename stack_type::result_type const value=stack->pop();
+            volatile bool const found=bool(value);
+            (void)found;
+          }
+          else
+          {
+            value_type value;
+            stack->pop(value);
+          }
+        }
+        catch(empty_stack const&)
+        {}
+      };
+    });
+  };
+}
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=100000;
+  defaults.read_percents={50};
+  defaults.payloads={8,256};
+  defaults.payload_sizes=bench::payload_type_sizes();
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+  h.run("threadsafe_stack<std::mutex>",stack_factory<false,std::mutex>());
+  h.run("threadsafe_stack<spin_mutex>",stack_factory<false,spin_mutex>());
+  h.run("threadsafe_stack<adaptive_mutex>",stack_factory<false,adaptive_mutex>());
+  h.run("threadsafe_stack<storage<std::vector>>",stack_factory<false,policy::storage<std::vector>>());
+  h.run("threadsafe_stack<notify_waiters>",stack_factory<false,policy::notify_waiters>());
+  h.run("threadsafe_stack pop() shared_ptr",stack_factory<true>());
+  h.run("threadsafe_stack pop() return_optional",stack_factory<true,policy::return_optional>());
+  h.run("threadsafe_stack<null_mutex>",stack_factory<false,null_mutex>(),bench::mode::serial);
+  return h.finish();
+}
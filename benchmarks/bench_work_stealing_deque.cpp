@@ -0,0 +1,121 @@
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "benchmark.h"
+#include "work_stealing_deque.h"
+
+/*
+work_stealing_dequeһstd::dequeȽϣԪ8ֽڵţpayloadá
+owner飺ÿֻ߳ԼĶУpop()дpush()ûȡowner
+·Ŀsteal飺߳0ownerpush()/pop()ֻ߳Ķ
+steal()ԽownerµԪԽ٣ȡownerһԪصĻԽࡣ
+ÿֿʼǰ㹻Ԫأpop()steal()նС
+*/
+
+/**飺һstd::deque*/
+template<typename T>
+class locked_deque
+{
+  std::mutex m;
+  std::deque<T> data;
+
+public:
+  void push(T value)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    data.push_back(value);
+  }
+
+  bool pop(T& value)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if(data.empty())
+      return false;
+    value=data.back();
+    data.pop_back();
+    return true;
+  }
+
+  bool try_steal(T& value)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if(data.empty())
+      return false;
+    value=data.front();
+    data.pop_front();
+    return true;
+  }
+};
+
+template<template<typename> class Deque>
+bench::factory owner_factory()
+{
+  return [](bench::config const& cfg) -> bench::operation
+  {
+    auto const deques=std::make_shared<std::vector<std::unique_ptr<Deque<std::uint64_t>>>>();
+    unsigned long const expected_pops=cfg.ops/100*cfg.read_percent;
+    for(unsigned t=0;t<cfg.threads;++t)
+    {
+      deques->push_back(std::make_unique<Deque<std::uint64_t>>());
+      for(unsigned long i=0;i<expected_pops+expected_pops/10+1000;++i)
+        deques->back()->push(i);
+    }
+    return [deques](unsigned thread,std::uint64_t i,bool read)
+    {
+      Deque<std::uint64_t>& own=*(*deques)[thread];
+      if(read)
+      {
+        std::uint64_t value;
+        volatile bool const found=own.pop(value);
+        (void)found;
+      }
+      else
+        own.push(i);
+    };
+  };
+}
+
+template<template<typename> class Deque>
+bench::factory steal_factory()
+{
+  return [](bench::config const& cfg) -> bench::operation
+  {
+    auto const deque=std::make_shared<Deque<std::uint64_t>>();
+    unsigned long const expected_takes=cfg.ops/100*cfg.read_percent+cfg.ops*(cfg.threads-1);
+    for(unsigned long i=0;i<expected_takes+expected_takes/10+1000;++i)  // 1 owner߳0ǰԤȷ룬ﻹûȡ
+      deque->push(i);
+    return [deque](unsigned thread,std::uint64_t i,bool read)
+    {
+      std::uint64_t value;
+      if(thread!=0)
+      {
+        volatile bool const found=deque->try_steal(value);
+        (void)found;
+      }
+      else if(read)
+      {
+        volatile bool const found=deque->pop(value);
+        (void)found;
+      }
+      else
+        deque->push(i);
+    };
+  };
+}
+
+int main(int argc,char** argv)
+{
+  bench::options defaults;
+  defaults.ops=100000;
+  defaults.read_percents={50,90};
+  defaults.payloads={8};
+  bench::harness h(bench::parse_options(argc,argv,defaults));
+  h.run("owner std::deque+std::mutex",owner_factory<locked_deque>());
+  h.run("owner work_stealing_deque",owner_factory<work_stealing_deque>());
+  h.run("steal std::deque+std::mutex",steal_factory<locked_deque>());
+  h.run("steal work_stealing_deque",steal_factory<work_stealing_deque>());
+  return h.finish();
+}
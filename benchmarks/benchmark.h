@@ -0,0 +1,551 @@
+#ifndef BENCHMARK_H_INCLUDED
+#define BENCHMARK_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "fast_clock.h"
+
+/*
+׼ԳõĲԿܡÿעɸ(+)ܰ
+߳ x  x شС ÿһϣ
+  1. ùõһµoperation(״̬Լ)
+  2. ̲߳ΰ󶨵ͬCPU߳̾ͬʱʼ
+  3. ÿִ߳opsoperation(thread, i, read)read
+     ÿsampleβfast_clock¼һεӳ٣
+  4. warmupֲrepeat֣ƽ֮ıϵ
+     Լֺϲp50/p99/p999ӳ١
+collectiveģʽڲ㷨ֻһ̣߳threads̳߳شС
+ÿoperationһ㷨ãserialģʽڶӦstd::㷨ֻһΡ
+
+Ա׼ҲдCSV(--csv)JSON(--json)
+--baselineȡǰCSV½p99--thresholdٷֱʱع飬
+ʱ򷵻1ֱڽű
+*/
+
+namespace bench
+{
+  struct config
+  {
+    unsigned threads;
+    unsigned read_percent;
+    std::size_t payload;  // ԪػֽcollectiveģʽԪظ
+    unsigned long ops;    // ÿ̵߳Ĳ
+  };
+
+  typedef std::function<void(unsigned thread,std::uint64_t i,bool read)> operation;
+  typedef std::function<operation(config const&)> factory;
+
+  enum class mode
+  {
+    concurrent,  // threads߳ͬʱִoperation
+    collective,  // һִ߳operationthreadsoperationԼʹ
+    serial       // threads޹صĵ̲߳գֻthreads=1ʱһ
+  };
+
+  struct options
+  {
+    std::vector<unsigned> threads;
+    std::vector<unsigned> read_percents;
+    std::vector<std::size_t> payloads;
+    std::vector<std::size_t> payload_sizes;  // ǿʱ--payloadֻȡеֵpayload_type_sizes()
+    std::size_t max_payload=std::size_t(-1);
+    unsigned long ops=100000;
+    unsigned repeat=5;
+    unsigned warmup=1;
+    unsigned sample=1;
+    bool pin=true;
+    double threshold=10.0;  // ٷֱ
+    std::string csv_path;
+    std::string json_path;
+    std::string baseline_path;
+    std::string filter;  // ֻаַĲ
+  };
+
+  struct result
+  {
+    std::string name;
+    config cfg;
+    double throughput;  // ÿ΢repeatֵƽֵ
+    double cv_percent;  // ıϵ
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+  };
+
+  /**124ֱhardware_concurrency()һӲ߳(Ϊ2)*/
+  inline std::vector<unsigned> thread_counts()
+  {
+    unsigned const max_threads=std::max(2u,std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for(unsigned t=1;t<max_threads;t*=2)
+      counts.push_back(t);
+    counts.push_back(max_threads);
+    return counts;
+  }
+
+  namespace detail
+  {
+    template<typename T>
+    std::vector<T> parse_list(std::string const& text)
+    {
+      std::vector<T> values;
+      std::istringstream in(text);
+      std::string item;
+      while(std::getline(in,item,','))
+        values.push_back(static_cast<T>(std::strtoull(item.c_str(),nullptr,10)));
+      return values;
+    }
+
+    inline std::vector<unsigned> available_cpus()
+    {
+      std::vector<unsigned> cpus;
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if(sched_getaffinity(0,sizeof(set),&set)==0)
+      {
+        for(unsigned cpu=0;cpu<CPU_SETSIZE;++cpu)
+          if(CPU_ISSET(cpu,&set))
+            cpus.push_back(cpu);
+      }
+#endif
+      return cpus;
+    }
+
+    inline void pin_this_thread(unsigned index)
+    {
+#ifdef __linux__
+      static std::vector<unsigned> const cpus=available_cpus();
+      if(cpus.empty())
+        return;
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpus[index%cpus.size()],&set);
+      pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+#else
+      (void)index;
+#endif
+    }
+
+    /**ÿ߳ԼβǶд*/
+    struct xorshift
+    {
+      std::uint64_t state;
+      explicit xorshift(std::uint64_t seed): state(seed*0x9e3779b97f4a7c15ull+1) {}
+      std::uint64_t operator()()
+      {
+        state^=state<<13;
+        state^=state>>7;
+        state^=state<<17;
+        return state;
+      }
+    };
+
+    struct run_result
+    {
+      double throughput;
+      std::vector<std::uint32_t> latencies_ns;
+    };
+
+    inline run_result run_once(operation const& op,config const& cfg,unsigned workers,options const& opts)
+    {
+      std::vector<std::vector<std::uint32_t>> samples(workers);
+      std::atomic<unsigned> ready(0);
+      std::atomic<bool> go(false);
+      std::vector<std::thread> threads;
+      std::chrono::steady_clock::time_point start,finish;
+      for(unsigned t=0;t<workers;++t)
+      {
+        threads.emplace_back([&,t]{
+          if(opts.pin)
+            pin_this_thread(t);
+          std::vector<std::uint32_t>& local=samples[t];
+          local.reserve(cfg.ops/opts.sample+1);
+          xorshift rng(t+1);
+          ++ready;
+          while(!go.load(std::memory_order_acquire))  // 1 ߳ͬʱʼ
+            std::this_thread::yield();
+          for(std::uint64_t i=0;i<cfg.ops;++i)
+          {
+            bool const read=rng()%100<cfg.read_percent;
+            if(i%opts.sample)
+            {
+              op(t,i,read);
+              continue;
+            }
+            auto const t0=fast_clock::now();
+            op(t,i,read);
+            auto const t1=fast_clock::now();
+            auto const ns=std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count();
+            local.push_back(static_cast<std::uint32_t>(std::min<long long>(ns,UINT32_MAX)));
+          }
+        });
+      }
+      while(ready.load()<workers)
+        std::this_thread::yield();
+      start=std::chrono::steady_clock::now();
+      go.store(true,std::memory_order_release);
+      for(auto& t : threads)
+        t.join();
+      finish=std::chrono::steady_clock::now();
+
+      run_result r;
+      double const us=std::chrono::duration<double,std::micro>(finish-start).count();
+      r.throughput=workers*double(cfg.ops)/us;
+      for(auto& s : samples)
+        r.latencies_ns.insert(r.latencies_ns.end(),s.begin(),s.end());
+      return r;
+    }
+
+    inline double percentile(std::vector<std::uint32_t>& values,double p)
+    {
+      if(values.empty())
+        return 0;
+      std::size_t const index=static_cast<std::size_t>(p/100.0*(values.size()-1));
+      std::nth_element(values.begin(),values.begin()+index,values.end());
+      return values[index];
+    }
+
+    inline std::string json_escape(std::string const& s)
+    {
+      std::string res;
+      for(char c : s)
+      {
+        if(c=='"' || c=='\\')
+          res+='\\';
+        res+=c;
+      }
+      return res;
+    }
+
+    typedef std::tuple<std::string,unsigned,unsigned,std::size_t> result_key;
+
+    inline result_key key_of(result const& r)
+    {
+      return result_key(r.name,r.cfg.threads,r.cfg.read_percent,r.cfg.payload);
+    }
+  }
+
+  inline void usage(char const* program,options const& defaults)
+  {
+    std::cerr<<"usage: "<<program<<" [options]\n"
+             <<"  --threads=1,2,4    thread counts to sweep\n"
+             <<"  --reads=90,50      read percentages to sweep\n"
+             <<"  --payload=8,64     payload sizes to sweep\n"
+             <<"  --ops=N            operations per thread per run (default "<<defaults.ops<<")\n"
+             <<"  --repeat=N         measured runs per configuration (default "<<defaults.repeat<<")\n"
+             <<"  --warmup=N         unmeasured runs first (default "<<defaults.warmup<<")\n"
+             <<"  --sample=N         time every Nth operation (default "<<defaults.sample<<")\n"
+             <<"  --no-pin           do not pin threads to CPUs\n"
+             <<"  --filter=TEXT      only run benchmarks whose name contains TEXT\n"
+             <<"  --csv=FILE --json=FILE\n"
+             <<"  --baseline=FILE    compare with an earlier --csv file\n"
+             <<"  --threshold=PCT    allowed regression in percent (default "<<defaults.threshold<<")\n";
+  }
+
+  /**ڳĬֵϽвʱӡ÷˳*/
+  inline options parse_options(int argc,char** argv,options defaults)
+  {
+    if(defaults.threads.empty())
+      defaults.threads=thread_counts();
+    options opts=defaults;
+    for(int i=1;i<argc;++i)
+    {
+      std::string const arg=argv[i];
+      std::size_t const eq=arg.find('=');
+      std::string const key=arg.substr(0,eq);
+      std::string const value=eq==std::string::npos ? std::string() : arg.substr(eq+1);
+      if(key=="--threads") opts.threads=detail::parse_list<unsigned>(value);
+      else if(key=="--reads") opts.read_percents=detail::parse_list<unsigned>(value);
+      else if(key=="--payload") opts.payloads=detail::parse_list<std::size_t>(value);
+      else if(key=="--ops") opts.ops=std::strtoul(value.c_str(),nullptr,10);
+      else if(key=="--repeat") opts.repeat=static_cast<unsigned>(std::strtoul(value.c_str(),nullptr,10));
+      else if(key=="--warmup") opts.warmup=static_cast<unsigned>(std::strtoul(value.c_str(),nullptr,10));
+      else if(key=="--sample") opts.sample=static_cast<unsigned>(std::strtoul(value.c_str(),nullptr,10));
+      else if(key=="--no-pin") opts.pin=false;
+      else if(key=="--filter") opts.filter=value;
+      else if(key=="--csv") opts.csv_path=value;
+      else if(key=="--json") opts.json_path=value;
+      else if(key=="--baseline") opts.baseline_path=value;
+      else if(key=="--threshold") opts.threshold=std::strtod(value.c_str(),nullptr);
+      else
+      {
+        usage(argv[0],defaults);
+        std::exit(key=="--help" ? 0 : 2);
+      }
+    }
+    if(opts.threads.empty() || opts.ops==0 || opts.repeat==0 || opts.sample==0
+       || std::count(opts.threads.begin(),opts.threads.end(),0u))
+    {
+      usage(argv[0],defaults);
+      std::exit(2);
+    }
+    if(opts.read_percents.empty())
+      opts.read_percents.push_back(100);
+    if(opts.payloads.empty())
+      opts.payloads.push_back(opts.payload_sizes.empty() ? 0 : opts.payload_sizes.front());
+    for(std::size_t payload : opts.payloads)
+    {
+      if(payload>opts.max_payload)
+      {
+        std::cerr<<"unsupported payload "<<payload<<", at most "<<opts.max_payload<<std::endl;
+        std::exit(2);
+      }
+      if(opts.payload_sizes.empty() ||
+         std::find(opts.payload_sizes.begin(),opts.payload_sizes.end(),payload)!=opts.payload_sizes.end())
+        continue;
+      std::cerr<<"unsupported payload "<<payload<<", use one of";  // ¼cfg.payloadĻɱĴС
+      for(std::size_t size : opts.payload_sizes)
+        std::cerr<<" "<<size;
+      std::cerr<<std::endl;
+      std::exit(2);
+    }
+    return opts;
+  }
+
+  class harness
+  {
+    options opts;
+    std::vector<result> results;
+
+  public:
+    explicit harness(options opts_): opts(std::move(opts_)) {}
+
+    /**ÿһmake(config)õoperation*/
+    void run(std::string const& name,factory make,mode m=mode::concurrent)
+    {
+      if(!opts.filter.empty() && name.find(opts.filter)==std::string::npos)
+        return;
+      std::vector<unsigned> const reads=m==mode::concurrent ? opts.read_percents : std::vector<unsigned>(1,100);
+      std::vector<unsigned> const thread_counts=m==mode::serial ? std::vector<unsigned>(1,1) : opts.threads;
+      for(unsigned threads : thread_counts)
+        for(unsigned read_percent : reads)
+          for(std::size_t payload : opts.payloads)
+          {
+            config const cfg{threads,read_percent,payload,opts.ops};
+            unsigned const workers=m==mode::concurrent ? threads : 1;
+            std::vector<double> throughputs;
+            std::vector<std::uint32_t> latencies;
+            for(unsigned r=0;r<opts.warmup+opts.repeat;++r)
+            {
+              operation const op=make(cfg);  // 2 ÿֶµ״̬ʼ
+              detail::run_result run=detail::run_once(op,cfg,workers,opts);
+              if(r<opts.warmup)
+                continue;
+              throughputs.push_back(run.throughput);
+              latencies.insert(latencies.end(),run.latencies_ns.begin(),run.latencies_ns.end());
+            }
+            result res;
+            res.name=name;
+            res.cfg=cfg;
+            double sum=0,sum_sq=0;
+            for(double t : throughputs)
+            {
+              sum+=t;
+              sum_sq+=t*t;
+            }
+            double const n=throughputs.size();
+            res.throughput=sum/n;
+            double const variance=n>1 ? std::max(0.0,(sum_sq-sum*sum/n)/(n-1)) : 0.0;
+            res.cv_percent=res.throughput>0 ? 100.0*std::sqrt(variance)/res.throughput : 0.0;
+            res.p50_ns=detail::percentile(latencies,50);
+            res.p99_ns=detail::percentile(latencies,99);
+            res.p999_ns=detail::percentile(latencies,99.9);
+            print(res);
+            results.push_back(res);
+          }
+    }
+
+    std::vector<result> const& all() const { return results; }
+
+    static void print(result const& r)
+    {
+      std::ios_base::fmtflags const flags=std::cout.flags();
+      std::streamsize const precision=std::cout.precision();
+      std::cout<<std::left<<std::setw(44)<<r.name<<std::right
+               <<" t="<<std::setw(3)<<r.cfg.threads
+               <<" r="<<std::setw(3)<<r.cfg.read_percent<<"%"
+               <<" p="<<std::setw(8)<<r.cfg.payload
+               <<std::fixed<<std::setprecision(3)
+               <<"  "<<std::setw(10)<<r.throughput<<" ops/us"
+               <<std::setprecision(1)
+               <<" +-"<<std::setw(5)<<r.cv_percent<<"%"
+               <<std::setprecision(0)
+               <<"  p50 "<<std::setw(8)<<r.p50_ns
+               <<"  p99 "<<std::setw(8)<<r.p99_ns
+               <<"  p999 "<<std::setw(9)<<r.p999_ns<<" ns"<<std::endl;
+      std::cout.flags(flags);
+      std::cout.precision(precision);
+    }
+
+    void write_csv(std::ostream& out) const
+    {
+      out<<"benchmark,threads,read_percent,payload,ops,throughput_ops_per_us,cv_percent,p50_ns,p99_ns,p999_ns\n";
+      for(auto const& r : results)
+        out<<r.name<<","<<r.cfg.threads<<","<<r.cfg.read_percent<<","<<r.cfg.payload<<","<<r.cfg.ops<<","
+           <<r.throughput<<","<<r.cv_percent<<","<<r.p50_ns<<","<<r.p99_ns<<","<<r.p999_ns<<"\n";
+    }
+
+    void write_json(std::ostream& out) const
+    {
+      out<<"[";
+      for(std::size_t i=0;i<results.size();++i)
+      {
+        result const& r=results[i];
+        out<<(i ? ",\n " : "\n ")
+           <<"{\"benchmark\":\""<<detail::json_escape(r.name)<<"\""
+           <<",\"threads\":"<<r.cfg.threads
+           <<",\"read_percent\":"<<r.cfg.read_percent
+           <<",\"payload\":"<<r.cfg.payload
+           <<",\"ops\":"<<r.cfg.ops
+           <<",\"throughput_ops_per_us\":"<<r.throughput
+           <<",\"cv_percent\":"<<r.cv_percent
+           <<",\"p50_ns\":"<<r.p50_ns
+           <<",\"p99_ns\":"<<r.p99_ns
+           <<",\"p999_ns\":"<<r.p999_ns<<"}";
+      }
+      out<<"\n]\n";
+    }
+
+    /**write_csv()дļȽϣػعĸ׼ûе*/
+    std::size_t compare_with_baseline(std::istream& in,std::ostream& report) const
+    {
+      std::map<detail::result_key,result> baseline;
+      std::string line;
+      std::getline(in,line);  // ͷ
+      while(std::getline(in,line))
+      {
+        std::vector<std::string> fields;
+        std::istringstream fields_in(line);
+        std::string field;
+        while(std::getline(fields_in,field,','))
+          fields.push_back(field);
+        if(fields.size()<10)
+          continue;
+        result r;
+        r.name=fields[0];
+        r.cfg.threads=static_cast<unsigned>(std::stoul(fields[1]));
+        r.cfg.read_percent=static_cast<unsigned>(std::stoul(fields[2]));
+        r.cfg.payload=std::stoull(fields[3]);
+        r.cfg.ops=std::stoul(fields[4]);
+        r.throughput=std::stod(fields[5]);
+        r.cv_percent=std::stod(fields[6]);
+        r.p50_ns=std::stod(fields[7]);
+        r.p99_ns=std::stod(fields[8]);
+        r.p999_ns=std::stod(fields[9]);
+        baseline[detail::key_of(r)]=r;
+      }
+      std::size_t regressions=0;
+      double const factor=opts.threshold/100.0;
+      for(auto const& r : results)
+      {
+        auto const it=baseline.find(detail::key_of(r));
+        if(it==baseline.end())
+          continue;
+        result const& b=it->second;
+        bool const slower=r.throughput<b.throughput*(1.0-factor);
+        bool const tail=b.p99_ns>0 && r.p99_ns>b.p99_ns*(1.0+factor);
+        if(!slower && !tail)
+          continue;
+        ++regressions;
+        report<<"REGRESSION "<<r.name<<" t="<<r.cfg.threads<<" r="<<r.cfg.read_percent<<"% p="<<r.cfg.payload<<":";
+        if(slower)
+          report<<" throughput "<<b.throughput<<" -> "<<r.throughput<<" ops/us";
+        if(tail)
+          report<<" p99 "<<b.p99_ns<<" -> "<<r.p99_ns<<" ns";
+        report<<"\n";
+      }
+      return regressions;
+    }
+
+    /**ѡдCSV/JSON׼Ƚϣmain()ķֵ*/
+    int finish() const
+    {
+      if(!opts.csv_path.empty())
+      {
+        std::ofstream out(opts.csv_path);
+        write_csv(out);
+      }
+      if(!opts.json_path.empty())
+      {
+        std::ofstream out(opts.json_path);
+        write_json(out);
+      }
+      if(opts.baseline_path.empty())
+        return 0;
+      std::ifstream in(opts.baseline_path);
+      if(!in)
+      {
+        std::cerr<<"cannot read baseline "<<opts.baseline_path<<std::endl;
+        return 2;
+      }
+      std::size_t const regressions=compare_with_baseline(in,std::cout);
+      std::cout<<regressions<<" regression(s) beyond "<<opts.threshold<<"% against "<<opts.baseline_path<<std::endl;
+      return regressions ? 1 : 0;
+    }
+  };
+
+  /**
+  شСʱԪȴҪڱȷpayloadΪ8642561024ʱ
+  f(type_tag<payload_type<payload>>())С׳std::invalid_argumentʹĳ
+  options::payload_sizesΪpayload_type_sizes()ϵСڽʱͱܾ
+  */
+  template<std::size_t N>
+  struct payload_type
+  {
+    unsigned char bytes[N];
+  };
+
+  template<typename T>
+  struct type_tag
+  {
+    typedef T type;
+  };
+
+  inline std::vector<std::size_t> payload_type_sizes()
+  {
+    return {8,64,256,1024};
+  }
+
+  template<typename Function>
+  auto with_payload(std::size_t payload,Function f)
+  {
+    switch(payload)
+    {
+    case 8:
+      return f(type_tag<payload_type<8>>());
+    case 64:
+      return f(type_tag<payload_type<64>>());
+    case 256:
+      return f(type_tag<payload_type<256>>());
+    case 1024:
+      return f(type_tag<payload_type<1024>>());
+    }
+    throw std::invalid_argument("with_payload: unsupported payload size");
+  }
+}
+
+#endif // BENCHMARK_H_INCLUDED
@@ -0,0 +1,358 @@
+#ifndef CONCURRENT_SKIPLIST_MAP_H_INCLUDED
+#define CONCURRENT_SKIPLIST_MAP_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+
+#include "epoch_domain.h"
+#include "per_thread.h"  // detail::thread_random()
+
+/*
+dns_cacheҪ˳(ĳǰ׺µ)Բܻɹϣ
+һstd::shared_mutexstd::mapʱж߶޸ͬһ߼д߻Ҫ
+ж뿪concurrent_skiplist_map<Key,Value,Compare>ӳ
+(HerlihyShavit)
+  find():   Ҳдκιݣֻҡߣ
+  insert_or_assign()/erase(): CAS޸ָ룬̣߳
+  scan():   ĳʼ˳ͬдߣһµĽ
+            (ڼɾļܿҲܿѾûиĶļһܿ)
+ɾڽڵÿһnextָϴɾ(λ)֮󾭹̰߳
+ժеļʱµֵժµĽڵͻµֵepoch_domain
+ȿܻڶǵ̶߳뿪ͷš
+
+ڵɲߺɾ߹ͬӵУ߶(Ǹ)ٱһΣȷڵѾ
+κһϣȻŽepoch_domain˲߻Ӹ߲ʱڵͱա
+*/
+
+template<typename Key,typename Value,typename Compare=std::less<Key>>
+class concurrent_skiplist_map
+{
+  static constexpr unsigned max_height=24;
+  typedef std::uintptr_t link;  // ڵָ룬λΪɾ
+
+  struct node
+  {
+    Key const key;
+    std::atomic<Value*> value;
+    unsigned const height;
+    std::atomic<unsigned> owners;  // ߺɾߣ0һ
+
+    node(Key const& key_,Value const& value_,unsigned height_):
+      key(key_),value(new Value(value_)),height(height_),owners(2)
+    {}
+
+    ~node()
+    {
+      delete value.load(std::memory_order_relaxed);
+    }
+
+    /**nextָڽڵ֮ڵͬһη*/
+    std::atomic<link>* tower()
+    {
+      return reinterpret_cast<std::atomic<link>*>(this+1);
+    }
+  };
+
+  mutable epoch_domain domain;  // ͷŻڵȴĽڵ
+  std::atomic<link> head[max_height];
+  std::atomic<unsigned> levels{1};  // õ߲Ҵ￪ʼ
+  std::atomic<std::size_t> count{0};
+  Compare comp;
+
+  static node* ptr(link l)
+  {
+    return reinterpret_cast<node*>(l&~link(1));
+  }
+
+  static bool marked(link l)
+  {
+    return l&1;
+  }
+
+  static unsigned random_height()
+  {
+    std::uint64_t r=detail::thread_random();
+    unsigned h=1;
+    while(h<max_height && (r&1))  // ÿһĸΪ1/2
+    {
+      ++h;
+      r>>=1;
+    }
+    return h;
+  }
+
+  static node* create(Key const& key,Value const& value,unsigned height)
+  {
+    void* const raw=::operator new(sizeof(node)+height*sizeof(std::atomic<link>));
+    node* n;
+    try
+    {
+      n=new(raw) node(key,value,height);
+    }
+    catch(...)
+    {
+      ::operator delete(raw);
+      throw;
+    }
+    for(unsigned i=0;i<height;++i)
+      new(&n->tower()[i]) std::atomic<link>(0);
+    return n;
+  }
+
+  static void destroy(void* p)
+  {
+    node* const n=static_cast<node*>(p);
+    n->~node();
+    ::operator delete(p);
+  }
+
+  /**
+  ÿһҵkeyǰ(ڵnext)ͺ̣˳·ժɾǵĽڵ㡣
+  through_equalΪtrueʱԽkeyĽڵ㣬ȷĳɾĽڵ㲻κһϡ
+  ͲϵkeyĽڵ㣬ûʱnullptr÷Ѿpin()
+  */
+  node* search(Key const& key,std::atomic<link>** preds,node** succs,bool through_equal=false)
+  {
+    for(;;)
+    {
+      bool restart=false;
+      std::atomic<link>* pred=head;
+      node* curr=nullptr;
+      unsigned const top=preds ? max_height : levels.load(std::memory_order_relaxed);  // ʱÿһǰҪҵ
+      for(unsigned level=top;level-- && !restart;)
+      {
+        curr=ptr(pred[level].load(std::memory_order_acquire));
+        while(curr)
+        {
+          link const succ=curr->tower()[level].load(std::memory_order_acquire);
+          if(marked(succ))
+          {
+            link expected=reinterpret_cast<link>(curr);
+            if(!pred[level].compare_exchange_strong(expected,succ&~link(1),std::memory_order_acq_rel))
+            {
+              restart=true;  // 1 ǰҲɾˣ½ڵм䣬ͷʼ
+              break;
+            }
+            curr=ptr(succ);
+            continue;
+          }
+          if(comp(curr->key,key) || (through_equal && !comp(key,curr->key)))
+          {
+            pred=curr->tower();
+            curr=ptr(succ);
+          }
+          else
+            break;
+        }
+        if(preds)
+        {
+          preds[level]=pred;
+          succs[level]=curr;
+        }
+      }
+      if(!restart)
+        return (curr && !comp(key,curr->key)) ? curr : nullptr;
+    }
+  }
+
+  /**߻ɾ߽ʱãһȷϽڵѾժ*/
+  void release_owner(node* n)
+  {
+    if(n->owners.fetch_sub(1,std::memory_order_acq_rel)!=1)
+      return;
+    search(n->key,nullptr,nullptr,true);
+    domain.retire(n,&destroy);
+  }
+
+  /**޸κָĲңصһСkeyδɾĽڵ*/
+  node* lower_bound(Key const& key) const
+  {
+    std::atomic<link> const* pred=head;
+    node* curr=nullptr;
+    node* not_less=nullptr;  // һͣĽڵ㣬֪СkeyһʱٱȽ
+    for(unsigned level=levels.load(std::memory_order_relaxed);level--;)
+    {
+      curr=ptr(pred[level].load(std::memory_order_acquire));
+      while(curr)
+      {
+        link succ=curr->tower()[level].load(std::memory_order_acquire);
+        while(marked(succ))  // 2 ɾĽڵ
+        {
+          curr=ptr(succ);
+          if(!curr)
+            break;
+          succ=curr->tower()[level].load(std::memory_order_acquire);
+        }
+        if(!curr || curr==not_less)
+          break;
+        if(!comp(curr->key,key))
+        {
+          not_less=curr;
+          break;
+        }
+        pred=curr->tower();
+        curr=ptr(succ);
+      }
+    }
+    return curr;
+  }
+
+public:
+  concurrent_skiplist_map()
+  {
+    for(auto& h : head)
+      h.store(0,std::memory_order_relaxed);
+  }
+
+  concurrent_skiplist_map(concurrent_skiplist_map const&)=delete;
+  concurrent_skiplist_map& operator=(concurrent_skiplist_map const&)=delete;
+
+  ~concurrent_skiplist_map()
+  {
+    node* n=ptr(head[0].load(std::memory_order_relaxed));
+    while(n)
+    {
+      node* const next=ptr(n->tower()[0].load(std::memory_order_relaxed));
+      destroy(n);
+      n=next;
+    }
+  }
+
+  bool find(Key const& key,Value& value) const
+  {
+    auto const g=domain.pin();
+    node* const n=lower_bound(key);
+    if(!n || comp(key,n->key))
+      return false;
+    value=*n->value.load(std::memory_order_acquire);
+    return true;
+  }
+
+  bool contains(Key const& key) const
+  {
+    auto const g=domain.pin();
+    node* const n=lower_bound(key);
+    return n && !comp(key,n->key);
+  }
+
+  /**trueʾ¼falseʾ滻мֵ*/
+  bool insert_or_assign(Key const& key,Value const& value)
+  {
+    auto const g=domain.pin();
+    std::atomic<link>* preds[max_height];
+    node* succs[max_height];
+    unsigned const height=random_height();
+    node* fresh=nullptr;
+    for(;;)
+    {
+      if(node* const existing=search(key,preds,succs))
+      {
+        if(fresh)
+          destroy(fresh);  // ûй
+        Value* const old=existing->value.exchange(new Value(value),std::memory_order_acq_rel);
+        domain.retire(old);
+        return false;
+      }
+      if(!fresh)
+        fresh=create(key,value,height);
+      for(unsigned level=0;level<height;++level)
+        fresh->tower()[level].store(reinterpret_cast<link>(succs[level]),std::memory_order_relaxed);
+      link expected=reinterpret_cast<link>(succs[0]);
+      if(preds[0][0].compare_exchange_strong(expected,reinterpret_cast<link>(fresh),std::memory_order_acq_rel))
+        break;  // 3 ͲʱЧ
+    }
+    count.fetch_add(1,std::memory_order_relaxed);
+    unsigned top=levels.load(std::memory_order_relaxed);
+    while(top<height && !levels.compare_exchange_weak(top,height,std::memory_order_relaxed))
+      ;
+
+    for(unsigned level=1;level<height;++level)
+    {
+      bool linked=false;
+      while(!linked)
+      {
+        link expected=reinterpret_cast<link>(succs[level]);
+        if(preds[level][level].compare_exchange_strong(expected,reinterpret_cast<link>(fresh),std::memory_order_acq_rel))
+        {
+          linked=true;
+          continue;
+        }
+        search(key,preds,succs);
+        link next=fresh->tower()[level].load(std::memory_order_acquire);
+        if(marked(next) ||
+           !fresh->tower()[level].compare_exchange_strong(next,reinterpret_cast<link>(succs[level]),std::memory_order_acq_rel))
+        {
+          release_owner(fresh);  // 4 ѾɾӸߵĲ
+          return true;
+        }
+      }
+    }
+    release_owner(fresh);
+    return true;
+  }
+
+  bool erase(Key const& key)
+  {
+    auto const g=domain.pin();
+    std::atomic<link>* preds[max_height];
+    node* succs[max_height];
+    node* const victim=search(key,preds,succs);
+    if(!victim)
+      return false;
+    for(unsigned level=victim->height;level-- >1;)  // 5 Ӹ߲Ͳ
+    {
+      link next=victim->tower()[level].load(std::memory_order_acquire);
+      while(!marked(next) &&
+            !victim->tower()[level].compare_exchange_weak(next,next|1,std::memory_order_acq_rel))
+        ;
+    }
+    link next=victim->tower()[0].load(std::memory_order_acquire);
+    for(;;)
+    {
+      if(marked(next))
+        return false;  // һ߳ɾ
+      if(victim->tower()[0].compare_exchange_weak(next,next|1,std::memory_order_acq_rel))
+        break;  // 6 ͲϱʱɾЧ
+    }
+    count.fetch_sub(1,std::memory_order_relaxed);
+    search(key,preds,succs);
+    release_owner(victim);
+    return true;
+  }
+
+  /**ӵһСfromļʼ˳f(key,value)ffalseʱֹͣ*/
+  template<typename Function>
+  void scan(Key const& from,Function f) const
+  {
+    auto const g=domain.pin();
+    for(node* n=lower_bound(from);n;)
+    {
+      link const next=n->tower()[0].load(std::memory_order_acquire);
+      if(!marked(next) && !f(n->key,static_cast<Value const&>(*n->value.load(std::memory_order_acquire))))
+        return;
+      n=ptr(next);
+    }
+  }
+
+  /**޸ʱֻǽֵ*/
+  std::size_t size() const
+  {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  bool empty() const
+  {
+    return size()==0;
+  }
+
+  /**ɾĽڵ滻ֵգ鿴жûͷ*/
+  epoch_domain& reclamation() const
+  {
+    return domain;
+  }
+};
+
+#endif // CONCURRENT_SKIPLIST_MAP_H_INCLUDED
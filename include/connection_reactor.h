@@ -0,0 +1,563 @@
+#ifndef CONNECTION_REACTOR_H_INCLUDED
+#define CONNECTION_REACTOR_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "pending_table.h"
+#include "slab_buffer.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+4.10еprocess_connections()while(!done(connections))ﲻͣѯÿӵ
+has_incoming_data()/has_outgoing_data()ʹûκݣҲռһˡ
+ﻻɻepollreactor(Linux)ӷɢNreactor߳ϣÿ߳
+epoll_wait()УֻӿɶдʱݰͶֶӦid
+std::promise<payload_type>ݰдoutgoing_packetpromise<bool>
+;pending_tableУidֱӶλ˳ʱreactor̶߳
+Ǳصʽ׽(socketpairػTCP)ÿݰĸʽΪ
+[id:4ֽ][:4ֽ][payload]ʹñֽ
+payloadslab_buffer.hеbuffer_chainֱӷڸƬصĿУ
+futureֻЩãʱsendmsg()Ѱͷ͸һνںˣ
+ŶӵݰҲϲͬһεС
+*/
+
+typedef buffer_chain payload_type;
+
+struct data_packet
+{
+  std::uint32_t id;
+  payload_type payload;
+};
+
+struct outgoing_packet
+{
+  std::uint32_t id;
+  payload_type payload;
+  std::promise<bool> promise;
+};
+
+struct connection_closed: std::exception
+{
+  const char* what() const throw() {
+    return "connection closed!";
+  };
+};
+
+class reactor;
+
+class connection
+{
+  friend class reactor;
+
+  static constexpr std::size_t header_size=8;
+  static constexpr std::uint32_t max_payload_size=64*1024*1024;
+  static constexpr int max_iov=64;
+
+  struct queued_packet
+  {
+    outgoing_packet packet;
+    char header[header_size];
+  };
+
+  int const fd;
+  int epoll_fd;  // Ƭepollͻõeventfdreactor::add()
+  int wake_fd;
+  std::atomic<bool>* shard_timing;
+  std::mutex m;
+  bool closed;
+  bool want_write;
+  pending_table<payload_type> pending;
+  std::deque<queued_packet> outgoing;
+  std::size_t write_offset;  // ݰдֽ(ͷ)
+  std::unique_ptr<chunk_writer> reader;  // ƬĻн
+  payload_type in_chain;
+  std::atomic<std::size_t> unexpected;
+
+  void update_interest(bool write)  // ߳m
+  {
+    if(write==want_write || epoll_fd<0)
+      return;
+    epoll_event ev{};
+    ev.events=EPOLLIN|EPOLLRDHUP|(write ? EPOLLOUT : 0u);
+    ev.data.ptr=this;
+    ::epoll_ctl(epoll_fd,EPOLL_CTL_MOD,fd,&ev);
+    want_write=write;
+  }
+
+  static std::future<payload_type> expect_closed()
+  {
+    std::promise<payload_type> p;
+    p.set_exception(std::make_exception_ptr(connection_closed()));
+    return p.get_future();
+  }
+
+  // ¼ֻreactor߳е
+  bool on_readable()
+  {
+    for(;;)
+    {
+      char* const tail=reader->tail();
+      ssize_t const n=::recv(fd,tail,reader->room(),0);  // ֱӶ飬֮ٿ
+      if(n>0)
+      {
+        in_chain.append(reader->commit(n));
+        continue;
+      }
+      if(n<0 && errno==EINTR)
+        continue;
+      if(n<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+        break;
+      dispatch_incoming();
+      return false;  // Զ˹رջ
+    }
+    return dispatch_incoming();
+  }
+
+  bool dispatch_incoming()
+  {
+    while(in_chain.size()>=header_size)
+    {
+      char header[header_size];
+      std::uint32_t id;
+      std::uint32_t len;
+      in_chain.copy_to(header,0,header_size);
+      std::memcpy(&id,header,4);
+      std::memcpy(&len,header+4,4);
+      if(len>max_payload_size)
+        return false;  // ЭֱӶϿ
+      if(in_chain.size()-header_size<len)
+        break;
+      payload_type payload=in_chain.sub(header_size,len);
+      in_chain.consume(header_size+len);
+
+      std::lock_guard<std::mutex> lk(m);
+      if(!pending.fulfil(id,std::move(payload)))  // û˵ȴѾʱ
+        unexpected.fetch_add(1,std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  static void add_iov(iovec* iov,int& count,char const* p,std::size_t len,std::size_t& skip)
+  {
+    if(skip>=len)
+    {
+      skip-=len;
+      return;
+    }
+    iov[count].iov_base=const_cast<char*>(p+skip);
+    iov[count++].iov_len=len-skip;
+    skip=0;
+  }
+
+  bool on_writable()
+  {
+    std::vector<std::promise<bool>> sent;
+    bool ok=true;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      while(!outgoing.empty())
+      {
+        iovec iov[max_iov];
+        int count=0;
+        std::size_t skip=write_offset;
+        for(auto const& q : outgoing)  // Ŷӵݰϲһsendmsg()
+        {
+          if(count+1>max_iov)
+            break;
+          add_iov(iov,count,q.header,header_size,skip);
+          for(auto const& slice : q.packet.payload.slices())
+          {
+            if(count==max_iov)
+              break;
+            add_iov(iov,count,slice.data(),slice.size(),skip);
+          }
+        }
+        msghdr msg{};
+        msg.msg_iov=iov;
+        msg.msg_iovlen=count;
+        ssize_t const n=::sendmsg(fd,&msg,MSG_NOSIGNAL);
+        if(n<0)
+        {
+          if(errno==EINTR)
+            continue;
+          ok=(errno==EAGAIN || errno==EWOULDBLOCK);
+          break;
+        }
+        std::size_t written=n;
+        while(!outgoing.empty())
+        {
+          std::size_t const remaining=header_size+outgoing.front().packet.payload.size()-write_offset;
+          if(written<remaining)
+          {
+            write_offset+=written;
+            break;
+          }
+          written-=remaining;
+          write_offset=0;
+          sent.push_back(std::move(outgoing.front().packet.promise));
+          outgoing.pop_front();
+        }
+      }
+      if(ok)
+        update_interest(!outgoing.empty());  // д˾ͲٹEPOLLOUT
+    }
+    for(auto& p : sent)
+      p.set_value(true);
+    return ok;
+  }
+
+  void on_closed()
+  {
+    std::deque<queued_packet> unsent;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      closed=true;
+      pending.fail_all(std::make_exception_ptr(connection_closed()));
+      unsent.swap(outgoing);
+    }
+    for(auto& q : unsent)
+      q.packet.promise.set_value(false);
+  }
+
+  /**óʱʧܣǷ˳ʱ*/
+  bool expire(std::chrono::steady_clock::time_point now)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    pending.expire(now);
+    return pending.has_deadlines();
+  }
+
+public:
+  /**ӹһӵʽ׽֣max_in_flightΪͬʱȴ*/
+  explicit connection(int fd_,std::size_t max_in_flight=1024):
+    fd(fd_),epoll_fd(-1),wake_fd(-1),shard_timing(nullptr),closed(false),want_write(false),
+    pending(max_in_flight),write_offset(0),unexpected(0)
+  {}
+
+  ~connection()
+  {
+    ::close(fd);
+  }
+
+  connection(connection const&)=delete;
+  connection& operator=(connection const&)=delete;
+
+  /**Ǽһȴеidݰʱַصfuture
+  ;󳬹max_in_flightʱ׳std::length_error*/
+  std::future<payload_type> expect(std::uint32_t id)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if(closed)
+      return expect_closed();
+    return pending.add(id);
+  }
+
+  /**ͬϣtimeout֮ûյݰfuture׳request_timeout*/
+  std::future<payload_type> expect(std::uint32_t id,std::chrono::steady_clock::duration timeout)
+  {
+    std::future<payload_type> res;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      if(closed)
+        return expect_closed();
+      res=pending.add(id,std::chrono::steady_clock::now()+timeout);
+      if(shard_timing && !shard_timing->exchange(true))  // ڷƬԭûжʱ
+      {
+        std::uint64_t const one=1;
+        ssize_t const r=::write(wake_fd,&one,sizeof(one));
+        (void)r;
+      }
+    }
+    return res;
+  }
+
+  /**ݰд׽ֺfutureΪtrueӶϿΪfalse*/
+  std::future<bool> send(std::uint32_t id,payload_type payload)
+  {
+    queued_packet q{outgoing_packet{id,std::move(payload),std::promise<bool>()},{}};
+    std::uint32_t const len=static_cast<std::uint32_t>(q.packet.payload.size());
+    std::memcpy(q.header,&id,4);
+    std::memcpy(q.header+4,&len,4);
+    std::future<bool> res=q.packet.promise.get_future();
+    std::lock_guard<std::mutex> lk(m);
+    if(closed)
+    {
+      q.packet.promise.set_value(false);
+      return res;
+    }
+    outgoing.push_back(std::move(q));
+    update_interest(true);  // reactor߳ڿдʱ
+    return res;
+  }
+
+  /**յû˵ȴݰ*/
+  std::size_t unexpected_packets() const
+  {
+    return unexpected.load(std::memory_order_relaxed);
+  }
+
+  /**رӣлڵȴfutureõ*/
+  void close()
+  {
+    ::shutdown(fd,SHUT_RDWR);
+  }
+};
+
+class reactor
+{
+  struct shard
+  {
+    int epoll_fd;
+    int wake_fd;
+    std::unordered_map<connection*,std::shared_ptr<connection>> connections;  // ֻڱƬ߳з
+    std::mutex added_mutex;
+    std::vector<std::shared_ptr<connection>> added;
+    std::vector<connection*> removed;  // ѾӹܡepollʧܵӣɷƬ̴߳ӱɾ
+    buffer_pool::pointer pool;
+    std::atomic<bool> timing{false};  // Ƿ˳ʱҪʱ
+    std::chrono::steady_clock::time_point next_expiry;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<shard>> shards;
+  std::atomic<unsigned> next_shard;
+  std::atomic<bool> done;
+  std::chrono::milliseconds const expiry_tick;
+
+  [[noreturn]] static void throw_errno(char const* what)
+  {
+    throw std::system_error(errno,std::generic_category(),what);
+  }
+
+  void run(shard& s)
+  {
+    epoll_event events[64];
+    while(!done.load(std::memory_order_acquire))
+    {
+      int const timeout=s.timing.load() ? static_cast<int>(expiry_tick.count()) : -1;
+      int const n=::epoll_wait(s.epoll_fd,events,64,timeout);  // 1 û¼ʱ߳
+      if(n<0)
+      {
+        if(errno==EINTR)
+          continue;
+        break;
+      }
+      for(int i=0;i<n;++i)
+      {
+        if(events[i].data.ptr==nullptr)  // 2 wake_fdӻҪֹͣ
+        {
+          std::uint64_t v;
+          ssize_t const r=::read(s.wake_fd,&v,sizeof(v));
+          (void)r;
+          std::vector<std::shared_ptr<connection>> added;
+          std::vector<connection*> removed;
+          {
+            std::lock_guard<std::mutex> lk(s.added_mutex);
+            added.swap(s.added);
+            removed.swap(s.removed);
+          }
+          for(auto& c : added)
+            s.connections.emplace(c.get(),std::move(c));
+          for(connection* c : removed)
+            s.connections.erase(c);
+          continue;
+        }
+        connection* const c=static_cast<connection*>(events[i].data.ptr);
+        auto const it=s.connections.find(c);
+        if(it==s.connections.end())
+          continue;
+        bool alive=true;
+        if(events[i].events&(EPOLLIN|EPOLLRDHUP|EPOLLHUP|EPOLLERR))  // 3
+          alive=c->on_readable();
+        if(alive && (events[i].events&EPOLLOUT))  // 4
+          alive=c->on_writable();
+        if(alive && (events[i].events&(EPOLLHUP|EPOLLERR)))
+          alive=false;
+        if(!alive)
+        {
+          ::epoll_ctl(s.epoll_fd,EPOLL_CTL_DEL,c->fd,nullptr);
+          c->on_closed();
+          s.connections.erase(it);
+        }
+      }
+      if(s.timing.load())
+        expire(s);
+    }
+    {
+      std::lock_guard<std::mutex> lk(s.added_mutex);
+      for(auto& c : s.added)
+        s.connections.emplace(c.get(),std::move(c));
+      s.added.clear();
+      for(connection* c : s.removed)
+        s.connections.erase(c);
+      s.removed.clear();
+    }
+    for(auto& entry : s.connections)
+      entry.second->on_closed();
+    s.connections.clear();
+  }
+
+  void expire(shard& s)
+  {
+    auto const now=std::chrono::steady_clock::now();
+    if(now<s.next_expiry)
+      return;
+    s.next_expiry=now+expiry_tick;
+    s.timing.exchange(false);  // ־ڼµǼǵòѱ߳
+    bool still_timing=false;
+    for(auto& entry : s.connections)
+      if(entry.second->expire(now))
+        still_timing=true;
+    if(still_timing)
+      s.timing.store(true);
+  }
+
+  void wake(shard& s)
+  {
+    std::uint64_t const one=1;
+    ssize_t const r=::write(s.wake_fd,&one,sizeof(one));
+    (void)r;
+  }
+
+public:
+  /**expiry_tick: ʱļֻд˳ʱʱŻᶨʱ
+  chunk_size: ջĴС*/
+  explicit reactor(unsigned shard_count=1,
+                   std::chrono::milliseconds expiry_tick_=std::chrono::milliseconds(10),
+                   std::size_t chunk_size=64*1024):
+    next_shard(0),done(false),expiry_tick(expiry_tick_)
+  {
+    try
+    {
+      for(unsigned i=0;i<(shard_count ? shard_count : 1);++i)
+      {
+        std::unique_ptr<shard> s(new shard);
+        s->pool=buffer_pool::create(chunk_size);
+        s->epoll_fd=::epoll_create1(EPOLL_CLOEXEC);
+        if(s->epoll_fd<0)
+          throw_errno("epoll_create1");
+        s->wake_fd=::eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+        if(s->wake_fd<0)
+        {
+          ::close(s->epoll_fd);
+          throw_errno("eventfd");
+        }
+        epoll_event ev{};
+        ev.events=EPOLLIN;
+        ev.data.ptr=nullptr;
+        ::epoll_ctl(s->epoll_fd,EPOLL_CTL_ADD,s->wake_fd,&ev);
+        shards.push_back(std::move(s));
+        shards.back()->thread=std::thread(&reactor::run,this,std::ref(*shards.back()));
+      }
+    }
+    catch(...)
+    {
+      stop();
+      throw;
+    }
+  }
+
+  ~reactor()
+  {
+    stop();
+  }
+
+  reactor(reactor const&)=delete;
+  reactor& operator=(reactor const&)=delete;
+
+  /**
+  ӽһƬ֮ӵĶдƬ߳ɡ
+  fdadd()ӹܣɹʱconnectionرգ׳쳣ʱadd()Ѿرգ߶Ҫٹر
+  */
+  std::shared_ptr<connection> add(int fd,std::size_t max_in_flight=1024)
+  {
+    std::shared_ptr<connection> c;
+    try
+    {
+      int const flags=::fcntl(fd,F_GETFL,0);
+      if(flags<0 || ::fcntl(fd,F_SETFL,flags|O_NONBLOCK)<0)
+        throw_errno("fcntl");
+      c=std::make_shared<connection>(fd,max_in_flight);
+    }
+    catch(...)  // ûconnectionرգ֮ʧconnectionر
+    {
+      ::close(fd);
+      throw;
+    }
+    shard& s=*shards[next_shard.fetch_add(1,std::memory_order_relaxed)%shards.size()];
+    c->reader.reset(new chunk_writer(*s.pool));
+    {
+      std::lock_guard<std::mutex> lk(s.added_mutex);  // ȷŽӹб֤¼ʱѾڱ
+      s.added.push_back(c);
+    }
+    wake(s);
+    {
+      std::lock_guard<std::mutex> lk(c->m);
+      c->epoll_fd=s.epoll_fd;
+      c->wake_fd=s.wake_fd;
+      c->shard_timing=&s.timing;
+      epoll_event ev{};
+      ev.events=EPOLLIN|EPOLLRDHUP|(c->outgoing.empty() ? 0u : EPOLLOUT);
+      ev.data.ptr=c.get();
+      c->want_write=!c->outgoing.empty();
+      if(::epoll_ctl(s.epoll_fd,EPOLL_CTL_ADD,fd,&ev)==0)
+        return c;
+    }
+    int const error=errno;
+    c->on_closed();
+    {
+      std::lock_guard<std::mutex> lk(s.added_mutex);  // ûӹֱܾӳأƬ̴߳ӱɾ
+      auto const it=std::find(s.added.begin(),s.added.end(),c);
+      if(it!=s.added.end())
+        s.added.erase(it);
+      else
+        s.removed.push_back(c.get());
+    }
+    wake(s);
+    errno=error;
+    throw_errno("epoll_ctl");
+  }
+
+  unsigned shard_count() const
+  {
+    return static_cast<unsigned>(shards.size());
+  }
+
+  void stop()
+  {
+    if(done.exchange(true))
+      return;
+    for(auto& s : shards)
+      wake(*s);
+    for(auto& s : shards)
+    {
+      if(s->thread.joinable())
+        s->thread.join();
+      ::close(s->wake_fd);
+      ::close(s->epoll_fd);
+    }
+  }
+};
+
+#endif // CONNECTION_REACTOR_H_INCLUDED
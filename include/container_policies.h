@@ -0,0 +1,304 @@
+#ifndef CONTAINER_POLICIES_H_INCLUDED
+#define CONTAINER_POLICIES_H_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+threadsafe_queuethreadsafe_stackԭ̶ʹһֻһ
+std::shared_ptrЩģ()˳⣬ûиĬֵ
+  policy::lock<M>        ͡null_mutexʾֻһ߳ʹãĴȫʧ
+  policy::storage<C>     Ԫصģ壬std::deque(Ĭ)std::vectorring_buffer
+  policy::capacity<N>    NԪأ0(Ĭ)ʾޣ
+  policy::notify_always  ÿһԪؾͻһȴ(threadsafe_queueĬֵ)
+  policy::notify_waiters ¼ȴߵĸûеȴʱnotify
+  policy::notify_none    ûҲûwait_and_pop()(threadsafe_stackĬֵ)
+  policy::return_shared_ptr / return_unique_ptr / return_optional
+                         Ԫصpop()/try_pop()ķͣĬstd::shared_ptr<T>
+threadsafe_queue<T,policy::capacity<1024>,policy::notify_waiters>
+
+ڱѡ(detail::container_policies)if constexprֻѡеķ֧
+notify_noneʱûԱcapacity<0>ʱû飬null_mutexʱҲҪ֪ͨ
+Ϊ˼ԭthreadsafe_stack<T,Mutex>ֱӸġǲԵͱ͡
+*/
+
+/**LockableSharedLockableҪʲôҲĻֻһ̵߳ĳ*/
+struct null_mutex
+{
+  void lock() noexcept {}
+  bool try_lock() noexcept { return true; }
+  void unlock() noexcept {}
+  void lock_shared() noexcept {}
+  bool try_lock_shared() noexcept { return true; }
+  void unlock_shared() noexcept {}
+};
+
+/**
+Ļλṩstd::queuestd::stackҪpush_back/pop_front/pop_backȲ
+Ԫطһstd::vector<T>У2ݣTҪĬϹ죻ӵλñֵΪT()
+ʱͷԪسеԴstd::dequeȣȶ״̬²ͷڴ档
+*/
+template<typename T>
+class ring_buffer
+{
+  std::vector<T> slots;
+  std::size_t head=0;
+  std::size_t count=0;
+
+  std::size_t index(std::size_t i) const
+  {
+    return (head+i)&(slots.size()-1);
+  }
+
+  void grow()
+  {
+    std::vector<T> bigger(slots.empty() ? 16 : slots.size()*2);
+    for(std::size_t i=0;i<count;++i)
+      bigger[i]=std::move(slots[index(i)]);
+    slots.swap(bigger);
+    head=0;
+  }
+
+public:
+  typedef T value_type;
+  typedef T& reference;
+  typedef T const& const_reference;
+  typedef std::size_t size_type;
+
+  bool empty() const { return count==0; }
+  size_type size() const { return count; }
+
+  reference front() { return slots[head]; }
+  const_reference front() const { return slots[head]; }
+  reference back() { return slots[index(count-1)]; }
+  const_reference back() const { return slots[index(count-1)]; }
+
+  void push_back(T const& value)
+  {
+    if(count==slots.size())
+      grow();
+    slots[index(count)]=value;
+    ++count;
+  }
+
+  void push_back(T&& value)
+  {
+    if(count==slots.size())
+      grow();
+    slots[index(count)]=std::move(value);
+    ++count;
+  }
+
+  template<typename... Args>
+  reference emplace_back(Args&&... args)
+  {
+    push_back(T(std::forward<Args>(args)...));
+    return back();
+  }
+
+  void pop_front()
+  {
+    slots[head]=T();
+    head=index(1);
+    --count;
+  }
+
+  void pop_back()
+  {
+    slots[index(count-1)]=T();
+    --count;
+  }
+};
+
+namespace policy
+{
+  template<typename Mutex>
+  struct lock
+  {
+    typedef Mutex type;
+  };
+
+  template<template<typename...> class Container>
+  struct storage
+  {
+    template<typename T>
+    using type=Container<T>;
+  };
+
+  template<std::size_t N>
+  struct capacity
+  {
+    static constexpr std::size_t value=N;
+  };
+
+  struct notify_always {};
+  struct notify_waiters {};
+  struct notify_none {};
+
+  struct return_shared_ptr {};
+  struct return_unique_ptr {};
+  struct return_optional {};
+}
+
+namespace detail
+{
+  enum class policy_kind_id
+  {
+    none,  // ǲԣʱ
+    lock,
+    storage,
+    capacity,
+    notify,
+    result
+  };
+
+  template<typename P>
+  struct policy_kind: std::integral_constant<policy_kind_id,policy_kind_id::none> {};
+  template<typename M>
+  struct policy_kind<policy::lock<M>>: std::integral_constant<policy_kind_id,policy_kind_id::lock> {};
+  template<template<typename...> class C>
+  struct policy_kind<policy::storage<C>>: std::integral_constant<policy_kind_id,policy_kind_id::storage> {};
+  template<std::size_t N>
+  struct policy_kind<policy::capacity<N>>: std::integral_constant<policy_kind_id,policy_kind_id::capacity> {};
+  template<> struct policy_kind<policy::notify_always>: std::integral_constant<policy_kind_id,policy_kind_id::notify> {};
+  template<> struct policy_kind<policy::notify_waiters>: std::integral_constant<policy_kind_id,policy_kind_id::notify> {};
+  template<> struct policy_kind<policy::notify_none>: std::integral_constant<policy_kind_id,policy_kind_id::notify> {};
+  template<> struct policy_kind<policy::return_shared_ptr>: std::integral_constant<policy_kind_id,policy_kind_id::result> {};
+  template<> struct policy_kind<policy::return_unique_ptr>: std::integral_constant<policy_kind_id,policy_kind_id::result> {};
+  template<> struct policy_kind<policy::return_optional>: std::integral_constant<policy_kind_id,policy_kind_id::result> {};
+
+  /**OptionsеһKindͣûʱΪDefault*/
+  template<policy_kind_id Kind,typename Default,typename... Options>
+  struct select_policy
+  {
+    typedef Default type;
+  };
+
+  template<policy_kind_id Kind,typename Default,typename First,typename... Rest>
+  struct select_policy<Kind,Default,First,Rest...>
+  {
+    typedef std::conditional_t<policy_kind<First>::value==Kind,First,
+                               typename select_policy<Kind,Default,Rest...>::type> type;
+  };
+
+  template<policy_kind_id Kind,typename... Options>
+  constexpr std::size_t count_policies()
+  {
+    return (std::size_t(0)+...+std::size_t(policy_kind<Options>::value==Kind));
+  }
+
+  template<typename DefaultNotify,typename... Options>
+  struct container_policies
+  {
+    static_assert(count_policies<policy_kind_id::none,Options...>()+count_policies<policy_kind_id::lock,Options...>()<=1 &&
+                  count_policies<policy_kind_id::storage,Options...>()<=1 &&
+                  count_policies<policy_kind_id::capacity,Options...>()<=1 &&
+                  count_policies<policy_kind_id::notify,Options...>()<=1 &&
+                  count_policies<policy_kind_id::result,Options...>()<=1,
+                  "each kind of policy may be given at most once");
+
+    typedef typename select_policy<policy_kind_id::lock,
+                                   policy::lock<typename select_policy<policy_kind_id::none,std::mutex,Options...>::type>,
+                                   Options...>::type::type lock_type;
+    template<typename T>
+    using storage_type=typename select_policy<policy_kind_id::storage,policy::storage<std::deque>,Options...>::type::template type<T>;
+    static constexpr std::size_t capacity=select_policy<policy_kind_id::capacity,policy::capacity<0>,Options...>::type::value;
+    static constexpr bool single_threaded=std::is_same<lock_type,null_mutex>::value;
+    typedef typename select_policy<policy_kind_id::notify,
+                                   std::conditional_t<single_threaded,policy::notify_none,DefaultNotify>,  // 1 ߳ʱû˻ȴ
+                                   Options...>::type notify;
+    typedef typename select_policy<policy_kind_id::result,policy::return_shared_ptr,Options...>::type result;
+    static constexpr bool notifies=!std::is_same<notify,policy::notify_none>::value;
+  };
+
+  template<typename Result,typename T>
+  using result_type=std::conditional_t<std::is_same<Result,policy::return_optional>::value,std::optional<T>,
+                    std::conditional_t<std::is_same<Result,policy::return_unique_ptr>::value,std::unique_ptr<T>,
+                                       std::shared_ptr<T>>>;
+
+  template<typename Result,typename T,typename U>
+  result_type<Result,T> make_result(U&& value)
+  {
+    if constexpr(std::is_same<Result,policy::return_optional>::value)
+      return std::optional<T>(std::in_place,std::forward<U>(value));
+    else if constexpr(std::is_same<Result,policy::return_unique_ptr>::value)
+      return std::make_unique<T>(std::forward<U>(value));
+    else
+      return std::make_shared<T>(std::forward<U>(value));
+  }
+
+  /**һ֪ͨԾnotifyʱǷĻѣ߳Mutex*/
+  template<typename Notify,typename Mutex>
+  class waiters
+  {
+    typedef std::conditional_t<std::is_same<Mutex,std::mutex>::value,
+                               std::condition_variable,std::condition_variable_any> condition_type;
+    static constexpr bool counted=std::is_same<Notify,policy::notify_waiters>::value;
+
+    condition_type cond;
+    unsigned waiting=0;  // ֻnotify_waitersʹ
+
+  public:
+    template<typename Lock,typename Predicate>
+    void wait(Lock& lk,Predicate pred)
+    {
+      if constexpr(counted)
+        ++waiting;
+      cond.wait(lk,pred);
+      if constexpr(counted)
+        --waiting;
+    }
+
+    template<typename Lock,typename Rep,typename Period,typename Predicate>
+    bool wait_for(Lock& lk,std::chrono::duration<Rep,Period> timeout,Predicate pred)
+    {
+      if constexpr(counted)
+        ++waiting;
+      bool const satisfied=cond.wait_for(lk,timeout,pred);
+      if constexpr(counted)
+        --waiting;
+      return satisfied;
+    }
+
+    void notify_one()
+    {
+      if constexpr(counted)
+      {
+        if(waiting)
+          cond.notify_one();
+      }
+      else
+        cond.notify_one();
+    }
+
+    void notify_all()
+    {
+      if constexpr(counted)
+      {
+        if(waiting)
+          cond.notify_all();
+      }
+      else
+        cond.notify_all();
+    }
+  };
+
+  /**notify_noneû֪ͨǿղ*/
+  template<typename Mutex>
+  class waiters<policy::notify_none,Mutex>
+  {
+  public:
+    void notify_one() {}
+    void notify_all() {}
+  };
+}
+
+#endif // CONTAINER_POLICIES_H_INCLUDED
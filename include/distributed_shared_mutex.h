@@ -0,0 +1,116 @@
+#ifndef DISTRIBUTED_SHARED_MUTEX_H_INCLUDED
+#define DISTRIBUTED_SHARED_MUTEX_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+#include "per_thread.h"  // detail::this_thread_index()
+
+/*
+std::shared_mutexֻһ߼64ͬʱdns_cache::find_entry()ʱ
+ÿlock_shared()/unlock_shared()Ҫ޸ͬһУʵǴеġ
+distributed_shared_mutexѶ߼ɢSlotsĻϣÿ̰߳Լı
+ʹһֻдԼһУֻһд߱־(ж߹޸ĵ)
+
+дȣдõwriter_mutexñ־֮Ķ߷ֱ־˳
+writer_mutexϣдֻѾĶȫ뿪дҪɨеĲۣ
+ʺ϶ԶдĳϡSharedLockablestd::shared_lockstd::lock_guard
+ڼ߳ͷ(ǰ߳ѡ)
+*/
+
+template<std::size_t Slots=64>
+class distributed_shared_mutex
+{
+  static_assert((Slots&(Slots-1))==0,"Slots must be a power of two");
+
+  struct alignas(64) reader_slot
+  {
+    std::atomic<long> readers{0};
+  };
+
+  reader_slot slots[Slots];
+  alignas(64) std::atomic<bool> writer{false};
+  std::mutex writer_mutex;  // д֮以⣬д߻ԾʱҲ˯
+
+  reader_slot& my_slot()
+  {
+    return slots[detail::this_thread_index()&(Slots-1)];
+  }
+
+  bool readers_present() const
+  {
+    for(auto const& s : slots)
+      if(s.readers.load(std::memory_order_seq_cst))
+        return true;
+    return false;
+  }
+
+public:
+  distributed_shared_mutex()=default;
+  distributed_shared_mutex(distributed_shared_mutex const&)=delete;
+  distributed_shared_mutex& operator=(distributed_shared_mutex const&)=delete;
+
+  void lock_shared()
+  {
+    reader_slot& s=my_slot();
+    for(;;)
+    {
+      s.readers.fetch_add(1,std::memory_order_seq_cst);  // 1 ȵǼټдߣдߵ2
+      if(!writer.load(std::memory_order_seq_cst))
+        return;
+      s.readers.fetch_sub(1,std::memory_order_release);
+      std::lock_guard<std::mutex> wait_for_writer(writer_mutex);  // дɺ
+    }
+  }
+
+  bool try_lock_shared()
+  {
+    reader_slot& s=my_slot();
+    s.readers.fetch_add(1,std::memory_order_seq_cst);
+    if(!writer.load(std::memory_order_seq_cst))
+      return true;
+    s.readers.fetch_sub(1,std::memory_order_release);
+    return false;
+  }
+
+  void unlock_shared()
+  {
+    my_slot().readers.fetch_sub(1,std::memory_order_release);
+  }
+
+  void lock()
+  {
+    writer_mutex.lock();
+    writer.store(true,std::memory_order_seq_cst);  // 2 ñ־ټ
+    unsigned spins=0;
+    while(readers_present())
+    {
+      if(++spins>64)
+        std::this_thread::yield();
+    }
+  }
+
+  bool try_lock()
+  {
+    if(!writer_mutex.try_lock())
+      return false;
+    writer.store(true,std::memory_order_seq_cst);
+    if(readers_present())
+    {
+      writer.store(false,std::memory_order_release);
+      writer_mutex.unlock();
+      return false;
+    }
+    return true;
+  }
+
+  void unlock()
+  {
+    writer.store(false,std::memory_order_release);
+    writer_mutex.unlock();
+  }
+};
+
+#endif // DISTRIBUTED_SHARED_MUTEX_H_INCLUDED
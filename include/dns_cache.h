@@ -0,0 +1,639 @@
+#ifndef DNS_CACHE_H_INCLUDED
+#define DNS_CACHE_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "concurrent_skiplist_map.h"
+#include "container_policies.h"  // null_mutex
+#include "label_trie.h"
+#include "mapped_table.h"
+#include "string_interner.h"
+#include "synchronized.h"  // detail::is_shared_lockable
+
+/*
+3.13 öдDNS棬3.3ȡʾͻ׼ʹá
+find_entry()й߳̿ͬʱңupdate_or_add_entry()жռ
+
+ݵǿ滻ģdns_cache<P>Pһд(std::shared_mutex
+distributed_shared_mutex<>)ʱݷstd::map(dns_locked_map<P>)
+P粻dns_skiplist_mapPΪnull_mutexʱֻһ߳ʹõ
+ãдѡڱɣûѡе·ɴ롣Ҫṩfind()
+update_or_add()remove()ṩfor_each_with_prefix()
+
+dns_locked_map<P>ÿ¼һstd::mapڵ㣬std::stringڲʱһ
+Ķڴ棻ܶʱdns_compact_map<P>string_interner32λ
+dns_entryСmemory_usage()ռõֽÿ¼ƽֵ
+Լбɾļ¼ռŵֽ
+
+find_closest_enclosing()find_with_wildcard()һÿȥһǩһΣ
+ṩlookup()(簴ǩ֯dns_trie_map)ʱֻӸһΡ
+ÿṩfor_each()дա
+
+֮󻺴ǿյģеĲѯҪתΡsave_snapshot()ѵǰдmapped_table
+ļ(include/mapped_table.h)ʱload_snapshot()ֻӳfind_entry()
+ӳҳϲ鵽Щ¼֮ɵ߷migrate_snapshot()Ѽ¼ƽ
+ȫӳ䣻֮ǰ»ɾļ¼Ϊ׼ֻfind_entry()
+׺ֻͨеļ¼
+*/
+
+class dns_entry
+{
+
+};
+
+/**ռõڴ棬bytesdead_bytesѾɾûлյļ¼ռõĲ*/
+struct dns_memory_usage
+{
+  std::size_t entries;
+  std::size_t bytes;
+  std::size_t dead_bytes=0;
+
+  double bytes_per_entry() const
+  {
+    return entries ? double(bytes)/entries : 0.0;
+  }
+};
+
+namespace detail
+{
+  /**64λglibc mallocsizeֽʵռõڴ棺8ֽͷ16ֽڶ룬32ֽ*/
+  inline std::size_t heap_block_bytes(std::size_t size)
+  {
+    std::size_t const chunk=(size+8+15)&~std::size_t(15);
+    return chunk<32 ? 32 : chunk;
+  }
+}
+
+template<typename SharedMutex>
+class dns_locked_map
+{
+  std::map<std::string,dns_entry> entries;
+  mutable SharedMutex entry_mutex;
+public:
+  bool find(std::string const& domain,dns_entry& entry) const
+  {
+    std::shared_lock<SharedMutex> lk(entry_mutex);  // 1
+    std::map<std::string,dns_entry>::const_iterator const it=
+       entries.find(domain);
+    if(it==entries.end())
+      return false;
+    entry=it->second;
+    return true;
+  }
+  void update_or_add(std::string const& domain,
+                     dns_entry const& dns_details)
+  {
+    std::lock_guard<SharedMutex> lk(entry_mutex);  // 2
+    entries[domain]=dns_details;
+  }
+  bool remove(std::string const& domain)
+  {
+    std::lock_guard<SharedMutex> lk(entry_mutex);
+    return entries.erase(domain)!=0;
+  }
+  /**ڼһֱйдҪȱ*/
+  template<typename Function>
+  void for_each(Function f) const
+  {
+    std::shared_lock<SharedMutex> lk(entry_mutex);
+    for(auto const& e : entries)
+      f(e.first,e.second);
+  }
+  template<typename Function>
+  void for_each_with_prefix(std::string const& prefix,Function f) const
+  {
+    std::shared_lock<SharedMutex> lk(entry_mutex);
+    for(auto it=entries.lower_bound(prefix);
+        it!=entries.end() && it->first.compare(0,prefix.size(),prefix)==0;++it)
+      f(it->first,it->second);
+  }
+  /**std::mapڵĴСǹģڵͷ4ָСֶμpair<const std::string,dns_entry>*/
+  dns_memory_usage memory_usage() const
+  {
+    std::shared_lock<SharedMutex> lk(entry_mutex);
+    std::size_t const node_bytes=detail::heap_block_bytes(4*sizeof(void*)+sizeof(std::pair<std::string const,dns_entry>));
+    std::size_t const inline_capacity=std::string().capacity();
+    std::size_t bytes=sizeof(*this)+entries.size()*node_bytes;
+    for(auto const& e : entries)
+      if(e.first.capacity()>inline_capacity)
+        bytes+=detail::heap_block_bytes(e.first.capacity()+1);  // ڲһڴ
+    return dns_memory_usage{entries.size(),bytes};
+  }
+};
+
+/**
+ֻһΣŷдţnamesıentries[id]Ǽ¼present[id]ʾ
+Ƿм¼dns_entryֶʱԸԷһ(д)ֻ
+ҪСɾֻpresentınamesУٴμʱԭıš
+ϲϱ仯ʱɾԽԽࣺcompact()Ȼڵļ¼Žһµ
+string_interner±ţڼжռʱȡɾıŶ
+ڵļ¼(min_dead_ids)ʱremove()Զռõڴ治ڵļ¼
+ңƽÿɾĴǳ
+255ֽڣʱupdate_or_add()׳std::length_error
+*/
+template<typename SharedMutex=std::shared_mutex>
+class dns_compact_map
+{
+  static constexpr std::size_t min_dead_ids=1024;
+
+  std::unique_ptr<string_interner> names{new string_interner};
+  std::vector<dns_entry> entries;
+  std::vector<bool> present;
+  std::size_t count=0;
+  std::size_t dead_bytes=0;  // ɾıռõֽ
+  mutable SharedMutex entry_mutex;
+
+  std::size_t bytes_of(std::uint32_t id) const
+  {
+    return names->bytes_of(id)+sizeof(dns_entry);
+  }
+
+  void compact_locked()
+  {
+    std::unique_ptr<string_interner> live(new string_interner);
+    std::vector<dns_entry> live_entries;
+    live_entries.reserve(count);
+    for(std::uint32_t id=0;id<entries.size();++id)
+      if(present[id])
+      {
+        live->intern((*names)[id]);  // 1 ԭ˳룬±žlive_entriesе±
+        live_entries.push_back(entries[id]);
+      }
+    names.swap(live);  // 2 ȫ滻;׳쳣ʱԭݲ
+    entries.swap(live_entries);
+    std::vector<bool>(count,true).swap(present);
+    dead_bytes=0;
+  }
+public:
+  bool find(std::string const& domain,dns_entry& entry) const
+  {
+    std::shared_lock<SharedMutex> lk(entry_mutex);
+    std::uint32_t const id=names->find(domain);
+    if(id==string_interner::npos || !present[id])
+      return false;
+    entry=entries[id];
+    return true;
+  }
+  void update_or_add(std::string const& domain,dns_entry const& dns_details)
+  {
+    std::lock_guard<SharedMutex> lk(entry_mutex);
+    std::uint32_t const id=names->intern(domain);
+    if(id==entries.size())
+    {
+      entries.push_back(dns_details);
+      present.push_back(true);
+      ++count;
+      return;
+    }
+    entries[id]=dns_details;
+    if(!present[id])
+    {
+      present[id]=true;
+      ++count;
+      dead_bytes-=bytes_of(id);
+    }
+  }
+  bool remove(std::string const& domain)
+  {
+    std::lock_guard<SharedMutex> lk(entry_mutex);
+    std::uint32_t const id=names->find(domain);
+    if(id==string_interner::npos || !present[id])
+      return false;
+    present[id]=false;
+    entries[id]=dns_entry();
+    --count;
+    dead_bytes+=bytes_of(id);
+    std::size_t const dead_ids=entries.size()-count;
+    if(dead_ids>=min_dead_ids && dead_ids>count)
+      compact_locked();
+    return true;
+  }
+  /**ɾռõڴ棬·*/
+  void compact()
+  {
+    std::lock_guard<SharedMutex> lk(entry_mutex);
+    compact_locked();
+  }
+  template<typename Function>
+  void for_each(Function f) const
+  {
+    std::shared_lock<SharedMutex> lk(entry_mutex);
+    for(std::uint32_t id=0;id<entries.size();++id)
+      if(present[id])
+        f(std::string((*names)[id]),static_cast<dns_entry const&>(entries[id]));
+  }
+  dns_memory_usage memory_usage() const
+  {
+    std::shared_lock<SharedMutex> lk(entry_mutex);
+    std::size_t const bytes=sizeof(*this)+names->bytes()+
+                            entries.capacity()*sizeof(dns_entry)+(present.capacity()+7)/8;
+    return dns_memory_usage{count,bytes,dead_bytes};
+  }
+};
+
+/**ҺͱдҲߣconcurrent_skiplist_map.h*/
+class dns_skiplist_map
+{
+  concurrent_skiplist_map<std::string,dns_entry> entries;
+public:
+  bool find(std::string const& domain,dns_entry& entry) const
+  {
+    return entries.find(domain,entry);
+  }
+  void update_or_add(std::string const& domain,dns_entry const& dns_details)
+  {
+    entries.insert_or_assign(domain,dns_details);
+  }
+  bool remove(std::string const& domain)
+  {
+    return entries.erase(domain);
+  }
+  template<typename Function>
+  void for_each(Function f) const
+  {
+    entries.scan(std::string(),[&](std::string const& domain,dns_entry const& entry)
+    {
+      f(domain,entry);
+      return true;
+    });
+  }
+  template<typename Function>
+  void for_each_with_prefix(std::string const& prefix,Function f) const
+  {
+    entries.scan(prefix,[&](std::string const& domain,dns_entry const& entry)
+    {
+      if(domain.compare(0,prefix.size(),prefix)!=0)
+        return false;
+      f(domain,entry);
+      return true;
+    });
+  }
+  epoch_domain& reclamation() const
+  {
+    return entries.reclamation();
+  }
+};
+
+/**ǩѹǰ׺һβҵõȷϼͨƥ䣬label_trie.h*/
+class dns_trie_map
+{
+  label_trie<dns_entry> entries;
+public:
+  bool find(std::string const& domain,dns_entry& entry) const
+  {
+    return entries.find(domain,entry);
+  }
+  void update_or_add(std::string const& domain,dns_entry const& dns_details)
+  {
+    entries.insert_or_assign(domain,dns_details);
+  }
+  bool remove(std::string const& domain)
+  {
+    return entries.erase(domain);
+  }
+  /**иͬһ汾зÿڵิһ*/
+  template<typename Iterator>
+  void update_or_add_all(Iterator first,Iterator last)
+  {
+    entries.update([&](label_trie<dns_entry>::writer& w)
+    {
+      for(;first!=last;++first)
+        w.insert_or_assign(first->first,first->second);
+    });
+  }
+  label_trie<dns_entry>::match lookup(std::string_view domain) const
+  {
+    return entries.lookup(domain);
+  }
+  template<typename Function>
+  void for_each(Function f) const
+  {
+    entries.for_each_in_zone(std::string_view(),f);
+  }
+  template<typename Function>
+  void for_each_in_zone(std::string const& zone,Function f) const
+  {
+    entries.for_each_in_zone(zone,f);
+  }
+  label_trie<dns_entry> const& trie() const
+  {
+    return entries;
+  }
+};
+
+namespace detail
+{
+  template<typename Storage,typename=void>
+  struct has_suffix_lookup: std::false_type
+  {};
+
+  template<typename Storage>
+  struct has_suffix_lookup<Storage,std::void_t<decltype(std::declval<Storage const&>().lookup(std::string_view()))>>: std::true_type
+  {};
+
+  template<typename Storage,typename=void>
+  struct has_bulk_update: std::false_type
+  {};
+
+  template<typename Storage>
+  struct has_bulk_update<Storage,std::void_t<decltype(std::declval<Storage&>().update_or_add_all(
+    std::declval<std::pair<std::string,dns_entry> const*>(),std::declval<std::pair<std::string,dns_entry> const*>()))>>: std::true_type
+  {};
+
+  /**domainlabelsǩ(a.b.example.com,2) -> example.com*/
+  inline std::string last_labels(std::string_view domain,std::size_t labels)
+  {
+    if(!domain.empty() && domain.back()=='.')
+      domain.remove_suffix(1);
+    if(labels==0)
+      return std::string();
+    std::size_t pos=domain.size();
+    for(std::size_t i=0;i<labels;++i)
+    {
+      pos=domain.rfind('.',pos-1);
+      if(pos==std::string_view::npos || pos==0)
+        return std::string(domain);
+    }
+    return std::string(domain.substr(pos+1));
+  }
+
+  template<typename Policy,bool=is_shared_lockable<Policy>::value>
+  struct dns_storage
+  {
+    typedef Policy type;
+  };
+
+  template<typename SharedMutex>
+  struct dns_storage<SharedMutex,true>
+  {
+    typedef dns_locked_map<SharedMutex> type;
+  };
+}
+
+template<typename Policy=std::shared_mutex>  // д(distributed_shared_mutex<>)(dns_skiplist_map)
+class dns_cache
+{
+public:
+  typedef typename detail::dns_storage<Policy>::type storage_type;
+private:
+  /**ӳĿգmigrated[id]Ϊtrueʱ¼Ϊ׼(Ѿƹȥ»߱ɾ)*/
+  struct mapped_snapshot
+  {
+    mapped_table<dns_entry> table;
+    std::unique_ptr<std::atomic<bool>[]> migrated;
+    std::uint32_t next=0;        // migrate_snapshot()
+    std::size_t remaining=0;
+  };
+
+  typedef std::conditional_t<std::is_same<Policy,null_mutex>::value,null_mutex,std::mutex> snapshot_mutex_type;  // ߳ʱҲҪ
+
+  storage_type entries;
+  std::atomic<bool> has_snapshot{false};
+  std::shared_ptr<mapped_snapshot> snapshot;  // 1 std::atomic_load()ֻsnapshot_mutex޸
+  mutable snapshot_mutex_type snapshot_mutex;  // пʱлдߡǨƺͱ
+
+  bool find_in_snapshot(std::string const& domain,dns_entry& entry) const
+  {
+    std::shared_ptr<mapped_snapshot> const s=std::atomic_load(&snapshot);
+    if(!s)
+      return false;
+    std::uint32_t const id=s->table.find(domain);
+    if(id==mapped_table<dns_entry>::npos || s->migrated[id].load(std::memory_order_acquire))
+      return false;  // 2 migrated޸֮ãtrueʱһѾµ
+    entry=s->table.value(id);
+    return true;
+  }
+
+  /**ʱsnapshot_mutexѾ޸*/
+  void mark_migrated(mapped_snapshot& s,std::uint32_t id)
+  {
+    if(id==mapped_table<dns_entry>::npos || s.migrated[id].load(std::memory_order_relaxed))
+      return;
+    s.migrated[id].store(true,std::memory_order_release);
+    if(--s.remaining==0)
+    {
+      std::atomic_store(&snapshot,std::shared_ptr<mapped_snapshot>());  // ڲҵĶ߻ӳ
+      has_snapshot.store(false,std::memory_order_release);
+    }
+  }
+
+  template<typename Iterator>
+  void apply_updates(Iterator first,Iterator last)
+  {
+    if constexpr(detail::has_bulk_update<storage_type>::value)
+      entries.update_or_add_all(first,last);
+    else
+      for(Iterator it=first;it!=last;++it)
+        entries.update_or_add(it->first,it->second);
+  }
+
+public:
+  dns_entry find_entry(std::string const& domain) const
+  {
+    dns_entry entry;
+    find_entry(domain,entry);
+    return entry;
+  }
+  /**ҵʱƵentrytrue*/
+  bool find_entry(std::string const& domain,dns_entry& entry) const
+  {
+    if(has_snapshot.load(std::memory_order_acquire) && find_in_snapshot(domain,entry))
+      return true;
+    return entries.find(domain,entry);
+  }
+  void update_or_add_entry(std::string const& domain,
+                           dns_entry const& dns_details)
+  {
+    if(!has_snapshot.load(std::memory_order_acquire))
+    {
+      entries.update_or_add(domain,dns_details);
+      return;
+    }
+    std::lock_guard<snapshot_mutex_type> lk(snapshot_mutex);
+    entries.update_or_add(domain,dns_details);
+    if(snapshot)
+      mark_migrated(*snapshot,snapshot->table.find(domain));
+  }
+  bool remove_entry(std::string const& domain)
+  {
+    if(!has_snapshot.load(std::memory_order_acquire))
+      return entries.remove(domain);
+    std::lock_guard<snapshot_mutex_type> lk(snapshot_mutex);
+    bool removed=entries.remove(domain);
+    if(snapshot)
+    {
+      std::uint32_t const id=snapshot->table.find(domain);
+      if(id!=mapped_table<dns_entry>::npos && !snapshot->migrated[id].load(std::memory_order_relaxed))
+      {
+        mark_migrated(*snapshot,id);
+        removed=true;
+      }
+    }
+    return removed;
+  }
+  /**£[first,last)еԪΪpair<std::string,dns_entry>*/
+  template<typename Iterator>
+  void update_or_add_entries(Iterator first,Iterator last)
+  {
+    if(!has_snapshot.load(std::memory_order_acquire))
+    {
+      apply_updates(first,last);
+      return;
+    }
+    std::lock_guard<snapshot_mutex_type> lk(snapshot_mutex);
+    apply_updates(first,last);
+    for(;first!=last && snapshot;++first)
+      mark_migrated(*snapshot,snapshot->table.find(first->first));
+  }
+
+  /**
+  ѵǰдpath(path.tmp)Ƽ¼ʱ߲Ӱ죬дǷҪȴȡ
+  for_each()дļʱκʱ׳std::system_error
+  */
+  void save_snapshot(std::string const& path) const
+  {
+    std::vector<std::pair<std::string,dns_entry>> items;
+    {
+      std::unique_lock<snapshot_mutex_type> lk(snapshot_mutex,std::defer_lock);
+      if(has_snapshot.load(std::memory_order_acquire))
+        lk.lock();  // 3 ûǨʱͿûƹȥļ¼ȫ
+      entries.for_each([&items](std::string const& domain,dns_entry const& entry)
+      {
+        items.emplace_back(domain,entry);
+      });
+      if(lk.owns_lock() && snapshot)
+        for(std::uint32_t id=0;id<snapshot->table.size();++id)
+          if(!snapshot->migrated[id].load(std::memory_order_relaxed))
+            items.emplace_back(std::string(snapshot->table.key(id)),snapshot->table.value(id));
+    }
+    mapped_table<dns_entry>::write(path,items.begin(),items.end());
+  }
+  /**
+  ֻӳpathok֮find_entry()ܲ鵽еļ¼Ӧʱǿյ
+  ̻߳ûпʼʹûʱãļڡУͲʱκθı䡣
+  */
+  snapshot_status load_snapshot(std::string const& path)
+  {
+    auto const s=std::make_shared<mapped_snapshot>();
+    snapshot_status const status=s->table.open(path);
+    if(status!=snapshot_status::ok || s->table.size()==0)
+      return status;
+    s->remaining=s->table.size();
+    s->migrated.reset(new std::atomic<bool>[s->remaining]());
+    std::lock_guard<snapshot_mutex_type> lk(snapshot_mutex);
+    if(snapshot)
+      throw std::logic_error("dns_cache: a snapshot is already loaded");
+    std::atomic_store(&snapshot,s);
+    has_snapshot.store(true,std::memory_order_release);
+    return status;
+  }
+  /**ѿmax_records¼ƽػûƹȥļ¼Ϊ0ʱӳѾ*/
+  std::size_t migrate_snapshot(std::size_t max_records)
+  {
+    std::lock_guard<snapshot_mutex_type> lk(snapshot_mutex);
+    std::shared_ptr<mapped_snapshot> const s=snapshot;
+    if(!s)
+      return 0;
+    for(;max_records && s->next<s->table.size();++s->next)
+    {
+      std::uint32_t const id=s->next;
+      if(s->migrated[id].load(std::memory_order_relaxed))
+        continue;
+      entries.update_or_add(std::string(s->table.key(id)),s->table.value(id));
+      mark_migrated(*s,id);
+      --max_records;
+    }
+    return s->remaining;
+  }
+  std::size_t snapshot_pending() const
+  {
+    std::lock_guard<snapshot_mutex_type> lk(snapshot_mutex);
+    return snapshot ? snapshot->remaining : 0;
+  }
+  /**domainġм¼ϼzoneзҵ*/
+  bool find_closest_enclosing(std::string const& domain,std::string& zone,dns_entry& entry) const
+  {
+    if constexpr(detail::has_suffix_lookup<storage_type>::value)
+    {
+      auto const m=entries.lookup(domain);
+      if(!m.enclosing)
+        return false;
+      zone=detail::last_labels(domain,m.enclosing_labels);
+      entry=m.enclosing_value;
+      return true;
+    }
+    else
+    {
+      for(std::string::size_type pos=0;;)  // ÿȥһǩһ
+      {
+        std::string suffix=domain.substr(pos);
+        if(entries.find(suffix,entry))
+        {
+          zone=std::move(suffix);
+          return true;
+        }
+        pos=domain.find('.',pos);
+        if(pos==std::string::npos)
+          return false;
+        ++pos;
+      }
+    }
+  }
+  /**domainȫͬļ¼ûʱͨ¼*.suffix*/
+  bool find_with_wildcard(std::string const& domain,dns_entry& entry) const
+  {
+    if constexpr(detail::has_suffix_lookup<storage_type>::value)
+    {
+      auto const m=entries.lookup(domain);
+      if(m.exact)
+        entry=m.exact_value;
+      else if(m.wildcard)
+        entry=m.wildcard_value;
+      return m.exact || m.wildcard;
+    }
+    else
+    {
+      if(entries.find(domain,entry))
+        return true;
+      for(std::string::size_type pos=domain.find('.');pos!=std::string::npos;pos=domain.find('.',pos+1))
+        if(entries.find("*"+domain.substr(pos),entry))
+          return true;
+      return false;
+    }
+  }
+  /**zoneÿf(domain,entry)Ҫ֧*/
+  template<typename Function>
+  void for_each_in_zone(std::string const& zone,Function f) const
+  {
+    entries.for_each_in_zone(zone,f);
+  }
+  /**Ҫ֧*/
+  dns_memory_usage memory_usage() const
+  {
+    return entries.memory_usage();
+  }
+  /**ֵprefixͷÿf(domain,entry)*/
+  template<typename Function>
+  void for_each_with_prefix(std::string const& prefix,Function f) const
+  {
+    entries.for_each_with_prefix(prefix,f);
+  }
+  storage_type const& storage() const
+  {
+    return entries;
+  }
+};
+
+#endif // DNS_CACHE_H_INCLUDED
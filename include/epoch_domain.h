@@ -0,0 +1,176 @@
+#ifndef EPOCH_DOMAIN_H_INCLUDED
+#define EPOCH_DOMAIN_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "per_thread.h"
+
+/*
+ݽṹѽڵժ֮󣬱ָָܻ߳̿룬delete
+epoch_domainǻڼԪĻգ
+  ڷʹڵǰpin()õguardǰǰ̱߳Ϊ"ͣ"pin()ʱļԪ
+  д߰ժµĽڵ㽻retire()µʱȫּԪr
+  ͣе̶߳ȫּԪʱȫּԪǰһȫּԪr+2ʱ
+  retire()ʱָĶһѾ뿪ڵͷš
+ÿ̵߳Ĵͷбper_thread<>Ĳ̷ֻ߳ʣretire()ÿ
+collect_intervalڵ㳢ƽһμԪͷŹڵĽڵ㡣
+
+һܾͣõĶ߻ֹл(ֹκζд)guardֻӦһβһ
+һ޸ġ߳˳ʱûͷŵĽڵڲɸøò۵̻߳epoch_domainͷš
+*/
+
+class epoch_domain
+{
+  struct retired
+  {
+    void* object;
+    void (*deleter)(void*);
+    std::uint64_t epoch;
+  };
+
+  struct participant
+  {
+    std::atomic<std::uint64_t> pinned{0};  // 0ʾٽ
+    unsigned nesting=0;
+    std::vector<retired> limbo;
+    std::atomic<std::size_t> limbo_size{0};  // ֻpending()ͳ
+  };
+
+  static constexpr std::size_t collect_interval=64;
+
+  alignas(64) std::atomic<std::uint64_t> global_epoch{1};
+  per_thread<participant> participants;
+
+  bool try_advance()
+  {
+    std::uint64_t const e=global_epoch.load(std::memory_order_seq_cst);
+    bool lagging=false;
+    participants.for_each([&](participant& p)
+    {
+      std::uint64_t const pinned=p.pinned.load(std::memory_order_seq_cst);
+      if(pinned && pinned!=e)
+        lagging=true;
+    });
+    if(lagging)
+      return false;
+    std::uint64_t expected=e;
+    return global_epoch.compare_exchange_strong(expected,e+1,std::memory_order_seq_cst);
+  }
+
+  void free_expired(participant& p)
+  {
+    std::uint64_t const e=global_epoch.load(std::memory_order_seq_cst);
+    auto const last=std::find_if(p.limbo.begin(),p.limbo.end(),
+                                 [e](retired const& r){return r.epoch+2>e;});  // 1 limboԪ
+    for(auto it=p.limbo.begin();it!=last;++it)
+      it->deleter(it->object);
+    p.limbo.erase(p.limbo.begin(),last);
+    p.limbo_size.store(p.limbo.size(),std::memory_order_relaxed);
+  }
+
+  void unpin()
+  {
+    participant& p=participants.local();
+    if(--p.nesting==0)
+      p.pinned.store(0,std::memory_order_release);  // ٽеĶȡ֮ǰ
+  }
+
+public:
+  class guard
+  {
+    epoch_domain* domain;
+
+  public:
+    explicit guard(epoch_domain* domain_): domain(domain_) {}
+    guard(guard&& other) noexcept: domain(other.domain) { other.domain=nullptr; }
+    guard(guard const&)=delete;
+    guard& operator=(guard const&)=delete;
+    guard& operator=(guard&&)=delete;
+
+    ~guard()
+    {
+      if(domain)
+        domain->unpin();
+    }
+  };
+
+  epoch_domain()=default;
+  epoch_domain(epoch_domain const&)=delete;
+  epoch_domain& operator=(epoch_domain const&)=delete;
+
+  /**÷֤ʱѾû߳ʹ*/
+  ~epoch_domain()
+  {
+    participants.for_each([](participant& p)
+    {
+      for(retired const& r : p.limbo)
+        r.deleter(r.object);
+    });
+  }
+
+  /**ٽǶ*/
+  guard pin()
+  {
+    participant& p=participants.local();
+    if(p.nesting++==0)
+    {
+      std::uint64_t e=global_epoch.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        p.pinned.store(e,std::memory_order_seq_cst);  // 2 ȹȷϣtry_advance()ɨ
+        std::uint64_t const now=global_epoch.load(std::memory_order_seq_cst);
+        if(now==e)
+          break;
+        e=now;
+      }
+    }
+    return guard(this);
+  }
+
+  /**objectѾܴӹṹзʵпܻĶ뿪deleter(object)*/
+  void retire(void* object,void (*deleter)(void*))
+  {
+    participant& p=participants.local();
+    std::uint64_t const e=global_epoch.fetch_add(0,std::memory_order_acq_rel);  // 3 --д֮¼ԪĶһõժ
+    p.limbo.push_back(retired{object,deleter,e});
+    p.limbo_size.store(p.limbo.size(),std::memory_order_relaxed);
+    if(p.limbo.size()%collect_interval==0)
+    {
+      try_advance();
+      free_expired(p);
+    }
+  }
+
+  template<typename T>
+  void retire(T* object)
+  {
+    retire(object,[](void* q){delete static_cast<T*>(q);});
+  }
+
+  /**ƽԪͷŵǰ߳ѾڵĽڵ*/
+  void collect()
+  {
+    try_advance();
+    free_expired(participants.local());
+  }
+
+  /**߳»ûͷŵĽڵֵ*/
+  std::size_t pending()
+  {
+    return participants.combine(std::size_t(0),[](std::size_t n,participant& p)
+    {
+      return n+p.limbo_size.load(std::memory_order_relaxed);
+    });
+  }
+
+  std::uint64_t epoch() const
+  {
+    return global_epoch.load(std::memory_order_relaxed);
+  }
+};
+
+#endif // EPOCH_DOMAIN_H_INCLUDED
@@ -0,0 +1,147 @@
+#ifndef FAST_CLOCK_H_INCLUDED
+#define FAST_CLOCK_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define FAST_CLOCK_HAS_TSC 1
+#endif
+
+/*
+·ϼӳʱÿҪüstd::chrono::steady_clock::now()ÿζһ
+vDSO(Լ20ns)fast_clock׼ʱ(Clock)Ҫ󣬿ֱwait_until()
+duration_castʱ㣻ȡʱ(rdtsc)ʱsteady_clock
+У׼һΣ롣CPUֲ֧TSC(invariant TSC)߲x86ʱ˻steady_clock
+fast_clockļԪsteady_clockͬ߳ʱк΢СƯƣ
+ҪʱӵʱһȽϡ
+
+manual_clockֻadvance()/set()ʱߣnow(timer_wheel
+pending_table::expire)Ҫ˯߾ܲԳʱ·
+*/
+
+class fast_clock
+{
+public:
+  typedef std::chrono::nanoseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<fast_clock> time_point;
+  static constexpr bool is_steady=true;
+
+private:
+  struct calibration
+  {
+    bool tsc;
+    std::uint64_t base_ticks;
+    rep base_ns;
+    std::uint64_t mult;  // ÿtick32.32
+  };
+
+#ifdef FAST_CLOCK_HAS_TSC
+  static bool invariant_tsc()
+  {
+    unsigned eax,ebx,ecx,edx;
+    if(!__get_cpuid(0x80000000,&eax,&ebx,&ecx,&edx) || eax<0x80000007)
+      return false;
+    __get_cpuid(0x80000007,&eax,&ebx,&ecx,&edx);
+    return (edx&(1u<<8))!=0;
+  }
+#endif
+
+  static calibration calibrate()
+  {
+    calibration c{false,0,0,0};
+#ifdef FAST_CLOCK_HAS_TSC
+    if(!invariant_tsc())
+      return c;
+    auto const start=std::chrono::steady_clock::now();
+    std::uint64_t const start_ticks=__rdtsc();
+    auto end=start;
+    while(end-start<std::chrono::milliseconds(5))  // 1 У׼ֻһΣæȼ뻻ȡ
+      end=std::chrono::steady_clock::now();
+    std::uint64_t const end_ticks=__rdtsc();
+    if(end_ticks<=start_ticks)
+      return c;
+    auto const ns=std::chrono::duration_cast<duration>(end-start).count();
+    c.tsc=true;
+    c.base_ticks=end_ticks;
+    c.base_ns=std::chrono::duration_cast<duration>(end.time_since_epoch()).count();
+    c.mult=(static_cast<std::uint64_t>(ns)<<32)/(end_ticks-start_ticks);
+#endif
+    return c;
+  }
+
+  static calibration const& state()
+  {
+    static calibration const c=calibrate();
+    return c;
+  }
+
+public:
+  static time_point now() noexcept
+  {
+    calibration const& c=state();
+#ifdef FAST_CLOCK_HAS_TSC
+    if(c.tsc)
+    {
+      std::uint64_t const delta=__rdtsc()-c.base_ticks;
+      auto const ns=static_cast<rep>((static_cast<unsigned __int128>(delta)*c.mult)>>32);
+      return time_point(duration(c.base_ns+ns));
+    }
+#endif
+    return time_point(std::chrono::duration_cast<duration>(
+      std::chrono::steady_clock::now().time_since_epoch()));
+  }
+
+  /**ǷʹTSCfalseʾ˻steady_clock*/
+  static bool uses_tsc() { return state().tsc; }
+
+  /**У׼õTSCƵ(Hz)ûʹTSCʱΪ0*/
+  static double tsc_frequency()
+  {
+    calibration const& c=state();
+    return c.tsc ? 1e9*4294967296.0/static_cast<double>(c.mult) : 0.0;
+  }
+};
+
+/**ֶʱӣʵͬһǰʱ䣬0ʼ*/
+class manual_clock
+{
+public:
+  typedef std::chrono::nanoseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<manual_clock> time_point;
+  static constexpr bool is_steady=true;  // ֻǰ
+
+private:
+  static std::atomic<rep>& ticks()
+  {
+    static std::atomic<rep> value(0);
+    return value;
+  }
+
+public:
+  static time_point now() noexcept { return time_point(duration(ticks().load())); }
+
+  template<typename Rep,typename Period>
+  static void advance(std::chrono::duration<Rep,Period> d)
+  {
+    ticks().fetch_add(std::chrono::duration_cast<duration>(d).count());
+  }
+
+  /**ttڵǰʱʱ*/
+  static void set(time_point t)
+  {
+    rep const target=t.time_since_epoch().count();
+    rep current=ticks().load();
+    while(current<target && !ticks().compare_exchange_weak(current,target))
+      ;
+  }
+};
+
+#endif // FAST_CLOCK_H_INCLUDED
@@ -0,0 +1,395 @@
+#ifndef FORK_JOIN_H_INCLUDED
+#define FORK_JOIN_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "per_thread.h"
+#include "spin_mutex.h"
+#include "thread_pool.h"
+#include "work_stealing_deque.h"
+
+/*
+4.2˵std::async㷨ݹزʱÿһ㶼
+std::async(std::launch::async,...)ͬʱڵ߳ݹȳɱȴ
+߳future::get()ϣʲôҲfork_joinǣ
+  fork_join_poolй̶Ḷ́߳Ĭhardware_concurrency()-1ϵ߳
+  Ӳ߳ݹҲᴴ̣߳
+  ÿ߳һwork_stealing_dequespawn()Լеĵײsync()ȴ
+  ʱȴӵײȡԼշ񣬶п˾ȥ̶߳еĶ͵һֱڸɻ
+  ǹ̵߳ĵ(main())spawn()ŽһעУsync()ʱͬ
+  æִ
+parallel_invoke(f1,f2,...)f2...̳߳أf1ڵִ߳Уٵȫ
+׳쳣sync()ʱ׳(ֻһ)future::get()ͬ
+*/
+
+class fork_join_pool
+{
+  struct task
+  {
+    function_wrapper f;
+    std::atomic<std::size_t>* pending;
+    std::exception_ptr* error;
+    std::atomic<bool>* failed;
+  };
+
+  struct worker
+  {
+    fork_join_pool* const pool;
+    work_stealing_deque<task*> deque;
+    std::thread thread;
+
+    explicit worker(fork_join_pool* pool_): pool(pool_) {}
+  };
+
+  std::vector<std::unique_ptr<worker>> workers;
+  std::mutex injection_mutex;
+  std::deque<task*> injection;
+  std::atomic<std::size_t> injected{0};
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  std::atomic<unsigned> sleepers{0};
+  std::atomic<bool> done{false};
+
+  static worker*& current_worker()
+  {
+    thread_local worker* w=nullptr;
+    return w;
+  }
+
+  /**ǰ߳ʱworker*/
+  worker* local_worker() const
+  {
+    worker* const w=current_worker();
+    return w && w->pool==this ? w : nullptr;
+  }
+
+  task* take_injected()
+  {
+    if(!injected.load(std::memory_order_acquire))
+      return nullptr;
+    std::lock_guard<std::mutex> lk(injection_mutex);
+    if(injection.empty())
+      return nullptr;
+    task* const t=injection.front();
+    injection.pop_front();
+    injected.fetch_sub(1,std::memory_order_relaxed);
+    return t;
+  }
+
+  task* steal_from_others(worker* self)
+  {
+    std::size_t const n=workers.size();
+    if(!n)
+      return nullptr;
+    std::size_t const start=std::size_t(detail::thread_random()%n);  // 1 λÿʼ̶߳ȥ͵ͬһ
+    for(std::size_t i=0;i<n;++i)
+    {
+      worker& victim=*workers[(start+i)%n];
+      if(&victim==self)
+        continue;
+      task* t;
+      if(victim.deque.steal(t)==work_stealing_deque<task*>::steal_result::stolen)
+        return t;
+    }
+    return nullptr;
+  }
+
+  task* find_task(worker* self)
+  {
+    task* t;
+    if(self && self->deque.pop(t))
+      return t;
+    if((t=take_injected()))
+      return t;
+    return steal_from_others(self);
+  }
+
+  static void run(task* t)
+  {
+    try
+    {
+      t->f();
+    }
+    catch(...)
+    {
+      if(!t->failed->exchange(true,std::memory_order_relaxed))
+        *t->error=std::current_exception();  // 2 ֻеһʧܵд룬sync()pendingŶ
+    }
+    std::atomic<std::size_t>* const pending=t->pending;
+    delete t;
+    pending->fetch_sub(1,std::memory_order_release);
+  }
+
+  bool has_work() const
+  {
+    if(injected.load(std::memory_order_relaxed))
+      return true;
+    return std::any_of(workers.begin(),workers.end(),[](std::unique_ptr<worker> const& w){return !w->deque.empty();});
+  }
+
+  void worker_loop(worker* self)
+  {
+    current_worker()=self;
+    unsigned idle=0;
+    while(!done.load(std::memory_order_acquire))
+    {
+      if(task* const t=find_task(self))
+      {
+        run(t);
+        idle=0;
+      }
+      else if(++idle<64)
+        detail::cpu_relax();
+      else if(idle<128)
+        std::this_thread::yield();
+      else
+      {
+        std::unique_lock<std::mutex> lk(sleep_mutex);
+        sleepers.fetch_add(1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // 3 submit()еդԣҪô￴ҪôԷsleepers
+        if(!done.load(std::memory_order_relaxed) && !has_work())
+          wake.wait(lk);
+        sleepers.fetch_sub(1,std::memory_order_relaxed);
+        idle=0;
+      }
+    }
+    current_worker()=nullptr;
+  }
+
+public:
+  /**worker_counṭ߳Ĭ߳һӲ߳*/
+  explicit fork_join_pool(unsigned worker_count=thread_pool::default_thread_count()-1)
+  {
+    workers.reserve(worker_count);
+    for(unsigned i=0;i<worker_count;++i)
+      workers.push_back(std::unique_ptr<worker>(new worker(this)));
+    try
+    {
+      for(auto& w : workers)
+        w->thread=std::thread(&fork_join_pool::worker_loop,this,w.get());  // 4 ȫworker֮ȡʱ鲻ٸı
+    }
+    catch(...)
+    {
+      shutdown();
+      throw;
+    }
+  }
+
+  ~fork_join_pool()
+  {
+    shutdown();
+  }
+
+  fork_join_pool(fork_join_pool const&)=delete;
+  fork_join_pool& operator=(fork_join_pool const&)=delete;
+
+  /**߳߳*/
+  unsigned size() const
+  {
+    return static_cast<unsigned>(workers.size());
+  }
+
+  /**f̳߳أʱpendingһf׳ĵһ쳣浽error*/
+  template<typename Function>
+  void submit(Function&& f,std::atomic<std::size_t>& pending,std::exception_ptr& error,std::atomic<bool>& failed)
+  {
+    task* const t=new task{function_wrapper(std::decay_t<Function>(std::forward<Function>(f))),&pending,&error,&failed};
+    pending.fetch_add(1,std::memory_order_relaxed);  // ǰִ߳һʱ0
+    try
+    {
+      if(worker* const self=local_worker())
+        self->deque.push(t);
+      else
+      {
+        std::lock_guard<std::mutex> lk(injection_mutex);
+        injection.push_back(t);
+        injected.fetch_add(1,std::memory_order_release);
+      }
+    }
+    catch(...)  // ʱڴ治㣺ûзŽȥsync()ԶȲ0
+    {
+      pending.fetch_sub(1,std::memory_order_relaxed);
+      delete t;
+      throw;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(sleepers.load(std::memory_order_relaxed))
+    {
+      std::lock_guard<std::mutex> lk(sleep_mutex);
+      wake.notify_one();
+    }
+  }
+
+  /**ִгеֱpendingΪ0*/
+  void help_until_done(std::atomic<std::size_t>& pending)
+  {
+    worker* const self=local_worker();
+    unsigned idle=0;
+    while(pending.load(std::memory_order_acquire))
+    {
+      if(task* const t=find_task(self))
+      {
+        run(t);
+        idle=0;
+      }
+      else if(++idle<64)
+        detail::cpu_relax();
+      else
+        std::this_thread::yield();  // ʣµڱִ߳
+    }
+  }
+
+private:
+  void shutdown()
+  {
+    {
+      std::lock_guard<std::mutex> lk(sleep_mutex);
+      done.store(true,std::memory_order_release);
+    }
+    wake.notify_all();
+    for(auto& w : workers)
+      if(w->thread.joinable())
+        w->thread.join();
+  }
+};
+
+/**fork_joinʹõĬ̳߳أһʹʱ*/
+inline fork_join_pool& default_fork_join_pool()
+{
+  static fork_join_pool pool;
+  return pool;
+}
+
+/**
+һһȴspawn()sync()æֱִһȫ
+ͨõջϵݣʱûҲȴ(׳쳣)
+*/
+class fork_join
+{
+  fork_join_pool& pool;
+  std::atomic<std::size_t> pending{0};
+  std::exception_ptr error;
+  std::atomic<bool> failed{false};
+
+public:
+  explicit fork_join(fork_join_pool& pool_=default_fork_join_pool()): pool(pool_)
+  {}
+
+  fork_join(fork_join const&)=delete;
+  fork_join& operator=(fork_join const&)=delete;
+
+  ~fork_join()
+  {
+    pool.help_until_done(pending);
+  }
+
+  template<typename Function>
+  void spawn(Function&& f)
+  {
+    pool.submit(std::forward<Function>(f),pending,error,failed);
+  }
+
+  /**ȴȫ֮Լspawn()*/
+  void sync()
+  {
+    pool.help_until_done(pending);
+    if(failed.load(std::memory_order_relaxed))
+    {
+      std::exception_ptr e;
+      std::swap(e,error);
+      failed.store(false,std::memory_order_relaxed);
+      std::rethrow_exception(e);
+    }
+  }
+};
+
+/**еfirstrest...firstڵִ߳Уȫ󷵻*/
+template<typename First,typename... Rest>
+void parallel_invoke(fork_join_pool& pool,First&& first,Rest&&... rest)
+{
+  fork_join group(pool);
+  (group.spawn(std::forward<Rest>(rest)),...);
+  std::invoke(std::forward<First>(first));  // 5 ׳쳣ʱgroupԻȴ
+  group.sync();
+}
+
+/**ʹdefault_fork_join_pool()*/
+template<typename First,typename... Rest,
+         typename=std::enable_if_t<!std::is_same<std::decay_t<First>,fork_join_pool>::value>>
+void parallel_invoke(First&& first,Rest&&... rest)
+{
+  parallel_invoke(default_fork_join_pool(),std::forward<First>(first),std::forward<Rest>(rest)...);
+}
+
+namespace detail
+{
+  template<typename RandomIt,typename Compare>
+  void parallel_quick_sort(fork_join_pool& pool,RandomIt first,RandomIt last,Compare comp,
+                           std::size_t cutoff,unsigned depth_limit)
+  {
+    auto const length=std::distance(first,last);
+    if(length<=std::max<std::ptrdiff_t>(std::ptrdiff_t(cutoff),2) || depth_limit==0)
+    {
+      std::sort(first,last,comp);  // 6 ֵ̫ʱstd::sortintrosortһ
+      return;
+    }
+    RandomIt const middle=first+length/2;
+    if(comp(*middle,*first))
+      std::iter_swap(middle,first);
+    if(comp(*(last-1),*middle))
+    {
+      std::iter_swap(last-1,middle);
+      if(comp(*middle,*first))
+        std::iter_swap(middle,first);
+    }
+    auto const pivot=*middle;
+    RandomIt const lower_end=std::partition(first,last,[&](auto const& x){return comp(x,pivot);});
+    RandomIt const upper_begin=std::partition(lower_end,last,[&](auto const& x){return !comp(pivot,x);});  // 7 pivotȵԪм䣬ظʱҲ
+    parallel_invoke(pool,
+      [=,&pool]{detail::parallel_quick_sort(pool,first,lower_end,comp,cutoff,depth_limit-1);},
+      [=,&pool]{detail::parallel_quick_sort(pool,upper_begin,last,comp,cutoff,depth_limit-1);});
+  }
+}
+
+/**
+пȡл֣parallel_invokeݹ飬cutoffԪʱstd::sort
+ȡ⹹ʱݹԿO(n)ÿһ㶼parallel_invokeͰæִ
+ջ֡ȳ2*log2(n)ʱʣµĲҲstd::sort
+ݹֻ񣬲̣֤߳ȶ
+*/
+template<typename RandomIt,typename Compare>
+void parallel_quick_sort(fork_join_pool& pool,RandomIt first,RandomIt last,Compare comp,
+                         std::size_t cutoff=2048)
+{
+  unsigned depth_limit=0;
+  for(auto n=std::distance(first,last);n>1;n/=2)
+    depth_limit+=2;
+  detail::parallel_quick_sort(pool,first,last,comp,cutoff,depth_limit);
+}
+
+template<typename RandomIt>
+void parallel_quick_sort(fork_join_pool& pool,RandomIt first,RandomIt last)
+{
+  parallel_quick_sort(pool,first,last,std::less<>());
+}
+
+template<typename RandomIt>
+void parallel_quick_sort(RandomIt first,RandomIt last)
+{
+  parallel_quick_sort(default_fork_join_pool(),first,last,std::less<>());
+}
+
+#endif // FORK_JOIN_H_INCLUDED
@@ -0,0 +1,100 @@
+#ifndef HIERARCHICAL_MUTEX_H_INCLUDED
+#define HIERARCHICAL_MUTEX_H_INCLUDED
+
+#include <climits>
+#include <mutex>
+#include <stdexcept>
+
+#include "lock_order.h"
+
+/*
+㼶ÿһ㼶ֵֻ߳ڳи߲㼶ʱȥȡͲ㼶
+׳std::logic_errorlock_order_graphͬҪ붼й
+һΰ˳ʱܷ֣Ҫȸÿ㼶
+ֻͬLOCK_ORDER_CHECKINGΪ1ʱ룬ͬʱҲ¼˳ͼУ
+Ϊ0ʱֻʣһstd::mutex
+*/
+
+class hierarchical_mutex
+{
+  std::mutex internal_mutex;
+#if LOCK_ORDER_CHECKING
+  unsigned long const hierarchy_value;
+  unsigned long previous_hierarchy_value;
+  inline static thread_local unsigned long this_thread_hierarchy_value=ULONG_MAX;
+
+  void check_for_hierarchy_violation()
+  {
+    if(this_thread_hierarchy_value <= hierarchy_value)  // 1 ֻܻȡȵǰе㼶͵
+      throw std::logic_error("mutex hierarchy violated");
+  }
+
+  void update_hierarchy_value()
+  {
+    previous_hierarchy_value=this_thread_hierarchy_value;
+    this_thread_hierarchy_value=hierarchy_value;
+  }
+#endif
+
+public:
+  explicit hierarchical_mutex(unsigned long value,char const* name=nullptr)
+#if LOCK_ORDER_CHECKING
+    : hierarchy_value(value),previous_hierarchy_value(0)
+  {
+    lock_order_graph::instance().name(this,name);
+  }
+
+  ~hierarchical_mutex()
+  {
+    lock_order_graph::instance().forget(this);
+  }
+#else
+  {
+    (void)value;
+    (void)name;
+  }
+#endif
+
+  hierarchical_mutex(hierarchical_mutex const&)=delete;
+  hierarchical_mutex& operator=(hierarchical_mutex const&)=delete;
+
+  void lock()
+  {
+#if LOCK_ORDER_CHECKING
+    check_for_hierarchy_violation();
+    lock_order_graph::instance().before_lock(this);
+    internal_mutex.lock();
+    lock_order_graph::instance().after_lock(this);
+    update_hierarchy_value();
+#else
+    internal_mutex.lock();
+#endif
+  }
+
+  void unlock()
+  {
+#if LOCK_ORDER_CHECKING
+    if(this_thread_hierarchy_value!=hierarchy_value)  // 2 밴෴˳
+      throw std::logic_error("mutex hierarchy violated");
+    this_thread_hierarchy_value=previous_hierarchy_value;
+    lock_order_graph::instance().after_unlock(this);
+#endif
+    internal_mutex.unlock();
+  }
+
+  bool try_lock()
+  {
+#if LOCK_ORDER_CHECKING
+    check_for_hierarchy_violation();
+    if(!internal_mutex.try_lock())
+      return false;
+    lock_order_graph::instance().after_lock(this);
+    update_hierarchy_value();
+    return true;
+#else
+    return internal_mutex.try_lock();
+#endif
+  }
+};
+
+#endif // HIERARCHICAL_MUTEX_H_INCLUDED
@@ -0,0 +1,474 @@
+#ifndef INSTRUMENTED_MUTEX_H_INCLUDED
+#define INSTRUMENTED_MUTEX_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+#include "fast_clock.h"
+#include "per_thread.h"
+
+/*
+instrumented_mutex<M>װLockable(ԼSharedLockableM֧)ҪĻ
+ֱ滻some_mutexthreadsafe_stack::mthreadsafe_queue::mutdns_cache::entry_mutex
+std::lock_guardstd::unique_lockstd::shared_lock÷䡣¼
+ȡҪȴĴȴʱͳʱֱͼ(2ݻֵ)
+Լȴĵλ(lock()ķصַdladdrʱ-rdynamicܿ)
+
+ûоʱtry_lock()ɹֻڱ̵߳Ĳ(per_thread)һμʱÿ16
+һΡֻзȴʱŶʱӲ¼λãûоʱûж⿪
+дֵʵǼmutex_registryУʱıJSONʽ
+*/
+
+namespace detail
+{
+  /**JSONַݣתšбܺͿַ*/
+  inline std::string json_escape(std::string const& s)
+  {
+    static char const hex[]="0123456789abcdef";
+    std::string res;
+    for(char c : s)
+    {
+      unsigned char const u=static_cast<unsigned char>(c);
+      if(c=='"' || c=='\\')
+      {
+        res+='\\';
+        res+=c;
+      }
+      else if(u<0x20)
+      {
+        res+="\\u00";
+        res+=hex[u>>4];
+        res+=hex[u&0xf];
+      }
+      else
+        res+=c;
+    }
+    return res;
+  }
+}
+
+/**2ݻֱֵͼiͰ[2^i, 2^(i+1))*/
+struct latency_histogram
+{
+  static constexpr unsigned bucket_count=40;
+  std::uint64_t counts[bucket_count]={};
+  std::uint64_t max_ns=0;
+
+  static unsigned bucket_for(std::uint64_t ns)
+  {
+    unsigned b=0;
+    while(ns>1 && b+1<bucket_count)
+    {
+      ns>>=1;
+      ++b;
+    }
+    return b;
+  }
+
+  std::uint64_t total() const
+  {
+    std::uint64_t n=0;
+    for(auto c : counts)
+      n+=c;
+    return n;
+  }
+
+  /**pٷλͰϽ()ûʱΪ0*/
+  std::uint64_t percentile(double p) const
+  {
+    std::uint64_t const n=total();
+    if(!n)
+      return 0;
+    std::uint64_t const rank=static_cast<std::uint64_t>(p/100.0*(n-1));
+    std::uint64_t seen=0;
+    for(unsigned b=0;b<bucket_count;++b)
+    {
+      seen+=counts[b];
+      if(seen>rank)
+        return std::min(std::uint64_t(2)<<b,max_ns);
+    }
+    return max_ns;
+  }
+};
+
+struct lock_call_site
+{
+  void* address;
+  std::uint64_t contended;
+  std::uint64_t wait_ns;
+
+  /**+ƫƣûзʱΪģ+ƫ*/
+  std::string describe() const
+  {
+    std::ostringstream out;
+    Dl_info info;
+    if(dladdr(address,&info) && info.dli_sname)
+    {
+      int status=0;
+      char* const demangled=abi::__cxa_demangle(info.dli_sname,nullptr,nullptr,&status);
+      out<<(status==0 ? demangled : info.dli_sname)<<"+0x"<<std::hex
+         <<(static_cast<char*>(address)-static_cast<char*>(info.dli_saddr));
+      std::free(demangled);
+    }
+    else if(dladdr(address,&info) && info.dli_fname)
+      out<<info.dli_fname<<"+0x"<<std::hex<<(static_cast<char*>(address)-static_cast<char*>(info.dli_fbase));
+    else
+      out<<address;
+    return out.str();
+  }
+};
+
+struct lock_stats
+{
+  std::string name;
+  std::uint64_t acquisitions=0;
+  std::uint64_t shared_acquisitions=0;
+  std::uint64_t contended=0;
+  std::uint64_t failed_try_locks=0;
+  latency_histogram wait;
+  latency_histogram hold;  // 
+  std::vector<lock_call_site> top_sites;  // ȴʱӴС
+
+  void write_text(std::ostream& out) const
+  {
+    std::ios::fmtflags const flags=out.flags();
+    std::streamsize const precision=out.precision();
+    double const contention=acquisitions ? 100.0*contended/acquisitions : 0;
+    out<<name<<": "<<acquisitions<<" acquisitions ("<<shared_acquisitions<<" shared), "
+       <<contended<<" contended ("<<std::fixed<<std::setprecision(1)<<contention<<"%), "
+       <<failed_try_locks<<" failed try_lock\n"
+       <<"  wait ns p50 "<<wait.percentile(50)<<" p99 "<<wait.percentile(99)<<" max "<<wait.max_ns
+       <<"; hold ns p50 "<<hold.percentile(50)<<" p99 "<<hold.percentile(99)<<" max "<<hold.max_ns<<"\n";
+    for(auto const& site : top_sites)
+      out<<"  "<<site.contended<<" waits, "<<site.wait_ns/1000<<"us at "<<site.describe()<<"\n";
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+  void write_json(std::ostream& out) const
+  {
+    auto const histogram=[&out](latency_histogram const& h)
+    {
+      out<<"{\"p50_ns\":"<<h.percentile(50)<<",\"p99_ns\":"<<h.percentile(99)<<",\"max_ns\":"<<h.max_ns
+         <<",\"buckets\":[";
+      for(unsigned b=0;b<latency_histogram::bucket_count;++b)
+        out<<(b ? "," : "")<<h.counts[b];
+      out<<"]}";
+    };
+    out<<"{\"name\":\""<<detail::json_escape(name)<<"\",\"acquisitions\":"<<acquisitions
+       <<",\"shared_acquisitions\":"<<shared_acquisitions<<",\"contended\":"<<contended
+       <<",\"failed_try_locks\":"<<failed_try_locks<<",\"wait\":";
+    histogram(wait);
+    out<<",\"hold\":";
+    histogram(hold);
+    out<<",\"top_sites\":[";
+    for(std::size_t i=0;i<top_sites.size();++i)
+    {
+      out<<(i ? "," : "")<<"{\"site\":\""<<detail::json_escape(top_sites[i].describe())<<"\",\"contended\":"<<top_sites[i].contended
+         <<",\"wait_ns\":"<<top_sites[i].wait_ns<<"}";
+    }
+    out<<"]}";
+  }
+};
+
+class instrumented_mutex_base;
+
+/**instrumented_mutexʵĵǼǱ*/
+class mutex_registry
+{
+  std::mutex m;
+  std::vector<instrumented_mutex_base*> mutexes;
+
+public:
+  static mutex_registry& instance()
+  {
+    static mutex_registry registry;
+    return registry;
+  }
+
+  void add(instrumented_mutex_base* p)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    mutexes.push_back(p);
+  }
+
+  void remove(instrumented_mutex_base* p)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    mutexes.erase(std::remove(mutexes.begin(),mutexes.end(),p),mutexes.end());
+  }
+
+  /**ȴܴӴС*/
+  std::vector<lock_stats> snapshot();
+  void dump_text(std::ostream& out);
+  void dump_json(std::ostream& out);
+};
+
+class instrumented_mutex_base
+{
+protected:
+  static constexpr unsigned site_slots=64;
+  static constexpr unsigned hold_sample_mask=15;
+
+  struct alignas(64) shard  // ÿ߳һֻ߳д
+  {
+    std::atomic<std::uint64_t> acquisitions{0};
+    std::atomic<std::uint64_t> shared_acquisitions{0};
+    std::atomic<std::uint64_t> contended{0};
+    std::atomic<std::uint64_t> failed_try_locks{0};
+    std::atomic<std::uint64_t> wait[latency_histogram::bucket_count]={};
+    std::atomic<std::uint64_t> hold[latency_histogram::bucket_count]={};
+    std::atomic<std::uint64_t> wait_max{0};
+    std::atomic<std::uint64_t> hold_max{0};
+    unsigned sample=0;
+    fast_clock::time_point hold_start;  // δʱΪĬֵ
+  };
+
+  struct site_slot
+  {
+    std::atomic<void*> address{nullptr};
+    std::atomic<std::uint64_t> contended{0};
+    std::atomic<std::uint64_t> wait_ns{0};
+  };
+
+  std::string name;
+  per_thread<shard> shards;
+  site_slot sites[site_slots];  // Ѱַ֮ĵλüһ
+
+  static void bump(std::atomic<std::uint64_t>& c,std::uint64_t n=1)
+  {
+    c.store(c.load(std::memory_order_relaxed)+n,std::memory_order_relaxed);
+  }
+
+  static void record(std::atomic<std::uint64_t>* buckets,std::atomic<std::uint64_t>& max,std::uint64_t ns)
+  {
+    bump(buckets[latency_histogram::bucket_for(ns)]);
+    if(ns>max.load(std::memory_order_relaxed))
+      max.store(ns,std::memory_order_relaxed);
+  }
+
+  void record_site(void* address,std::uint64_t ns)
+  {
+    std::size_t const hash=(reinterpret_cast<std::uintptr_t>(address)>>2)*0x9E3779B97F4A7C15ull>>58;
+    for(unsigned probe=0;probe<site_slots-1;++probe)
+    {
+      site_slot& s=sites[(hash+probe)%(site_slots-1)];
+      void* current=s.address.load(std::memory_order_acquire);
+      if(!current && s.address.compare_exchange_strong(current,address,std::memory_order_acq_rel))
+        current=address;
+      if(current==address)
+      {
+        s.contended.fetch_add(1,std::memory_order_relaxed);
+        s.wait_ns.fetch_add(ns,std::memory_order_relaxed);
+        return;
+      }
+    }
+    sites[site_slots-1].contended.fetch_add(1,std::memory_order_relaxed);
+    sites[site_slots-1].wait_ns.fetch_add(ns,std::memory_order_relaxed);
+  }
+
+  shard& on_acquired(bool shared)
+  {
+    shard& s=shards.local();
+    bump(shared ? s.shared_acquisitions : s.acquisitions);
+    s.hold_start=(++s.sample&hold_sample_mask)==0 ? fast_clock::now() : fast_clock::time_point();
+    return s;
+  }
+
+  void on_contended(fast_clock::time_point start,void* site,bool shared)
+  {
+    fast_clock::time_point const now=fast_clock::now();
+    std::uint64_t const ns=static_cast<std::uint64_t>((now-start).count());
+    shard& s=shards.local();
+    bump(shared ? s.shared_acquisitions : s.acquisitions);
+    bump(s.contended);
+    record(s.wait,s.wait_max,ns);
+    record_site(site,ns);
+    s.hold_start=now;  // ĳʱǼ¼
+  }
+
+  void on_release()
+  {
+    shard& s=shards.local();
+    if(s.hold_start==fast_clock::time_point())
+      return;
+    record(s.hold,s.hold_max,static_cast<std::uint64_t>((fast_clock::now()-s.hold_start).count()));
+  }
+
+  void on_failed_try_lock()
+  {
+    bump(shards.local().failed_try_locks);
+  }
+
+  explicit instrumented_mutex_base(std::string name_): name(std::move(name_))
+  {
+    if(name.empty())
+    {
+      std::ostringstream out;
+      out<<"mutex@"<<static_cast<void*>(this);
+      name=out.str();
+    }
+    mutex_registry::instance().add(this);
+  }
+
+  ~instrumented_mutex_base()
+  {
+    mutex_registry::instance().remove(this);
+  }
+
+public:
+  instrumented_mutex_base(instrumented_mutex_base const&)=delete;
+  instrumented_mutex_base& operator=(instrumented_mutex_base const&)=delete;
+
+  std::string const& get_name() const { return name; }
+
+  /**̵߳Ĳۣڼ̣߳top_nΪĵλø*/
+  lock_stats stats(std::size_t top_n=5)
+  {
+    lock_stats res;
+    res.name=name;
+    shards.for_each([&](shard& s)
+    {
+      res.acquisitions+=s.acquisitions.load(std::memory_order_relaxed);
+      res.shared_acquisitions+=s.shared_acquisitions.load(std::memory_order_relaxed);
+      res.contended+=s.contended.load(std::memory_order_relaxed);
+      res.failed_try_locks+=s.failed_try_locks.load(std::memory_order_relaxed);
+      for(unsigned b=0;b<latency_histogram::bucket_count;++b)
+      {
+        res.wait.counts[b]+=s.wait[b].load(std::memory_order_relaxed);
+        res.hold.counts[b]+=s.hold[b].load(std::memory_order_relaxed);
+      }
+      res.wait.max_ns=std::max(res.wait.max_ns,s.wait_max.load(std::memory_order_relaxed));
+      res.hold.max_ns=std::max(res.hold.max_ns,s.hold_max.load(std::memory_order_relaxed));
+    });
+    for(auto const& s : sites)
+    {
+      std::uint64_t const n=s.contended.load(std::memory_order_relaxed);
+      if(n)
+        res.top_sites.push_back(lock_call_site{s.address.load(std::memory_order_relaxed),n,
+                                               s.wait_ns.load(std::memory_order_relaxed)});
+    }
+    std::sort(res.top_sites.begin(),res.top_sites.end(),
+              [](lock_call_site const& a,lock_call_site const& b){return a.wait_ns>b.wait_ns;});
+    if(res.top_sites.size()>top_n)
+      res.top_sites.resize(top_n);
+    return res;
+  }
+};
+
+template<typename Mutex=std::mutex>
+class instrumented_mutex: public instrumented_mutex_base
+{
+  Mutex m;
+
+public:
+  /**nameΪʱõַ*/
+  explicit instrumented_mutex(std::string name_=std::string()):
+    instrumented_mutex_base(std::move(name_))
+  {}
+
+  [[gnu::noinline]] void lock()  // صַǵlock()λ
+  {
+    if(m.try_lock())
+    {
+      on_acquired(false);
+      return;
+    }
+    fast_clock::time_point const start=fast_clock::now();
+    m.lock();
+    on_contended(start,__builtin_return_address(0),false);
+  }
+
+  bool try_lock()
+  {
+    if(!m.try_lock())
+    {
+      on_failed_try_lock();
+      return false;
+    }
+    on_acquired(false);
+    return true;
+  }
+
+  void unlock()
+  {
+    on_release();
+    m.unlock();
+  }
+
+  template<typename M=Mutex,typename=decltype(std::declval<M&>().lock_shared())>
+  [[gnu::noinline]] void lock_shared()
+  {
+    if(m.try_lock_shared())
+    {
+      on_acquired(true);
+      return;
+    }
+    fast_clock::time_point const start=fast_clock::now();
+    m.lock_shared();
+    on_contended(start,__builtin_return_address(0),true);
+  }
+
+  template<typename M=Mutex,typename=decltype(std::declval<M&>().try_lock_shared())>
+  bool try_lock_shared()
+  {
+    if(!m.try_lock_shared())
+    {
+      on_failed_try_lock();
+      return false;
+    }
+    on_acquired(true);
+    return true;
+  }
+
+  template<typename M=Mutex,typename=decltype(std::declval<M&>().unlock_shared())>
+  void unlock_shared()
+  {
+    on_release();
+    m.unlock_shared();
+  }
+};
+
+inline std::vector<lock_stats> mutex_registry::snapshot()
+{
+  std::vector<lock_stats> res;
+  {
+    std::lock_guard<std::mutex> lk(m);
+    for(auto* p : mutexes)
+      res.push_back(p->stats());
+  }
+  std::sort(res.begin(),res.end(),[](lock_stats const& a,lock_stats const& b){return a.contended>b.contended;});
+  return res;
+}
+
+inline void mutex_registry::dump_text(std::ostream& out)
+{
+  for(auto const& s : snapshot())
+    s.write_text(out);
+}
+
+inline void mutex_registry::dump_json(std::ostream& out)
+{
+  auto const all=snapshot();
+  out<<"[";
+  for(std::size_t i=0;i<all.size();++i)
+  {
+    out<<(i ? ",\n " : "");
+    all[i].write_json(out);
+  }
+  out<<"]\n";
+}
+
+#endif // INSTRUMENTED_MUTEX_H_INCLUDED
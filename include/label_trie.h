@@ -0,0 +1,505 @@
+#ifndef LABEL_TRIE_H_INCLUDED
+#define LABEL_TRIE_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "epoch_domain.h"
+#include "string_interner.h"
+
+/*
+˾ȷңҪ"ϼ"(a.b.example.com -> example.com)
+*.example.comͨ¼std::mapʱÿȥһǩҪٲһ
+ַlabel_trie<Value>ǩ(com -> example -> b -> a)֯ǰ׺
+һδӸ߾ͬʱõ
+  exact:     ȫͬļ¼
+  enclosing: ·ġм¼Ľڵ㣬ĺ׺ƥ䣻
+  wildcard:  ·ġ"*"ӽڵ¼Ľڵ㡣
+ֻһӽڵ㡢ûм¼Ľڵӽڵϲϱһǩ(ѹǰ׺)
+
+ÿͬıǩֻstring_internerбһΣڵֻ32λıţӽڵ㰴һǩ
+Ĺϣֵ򣬶òѯǩĹϣֲңٱȽһֽڣҪϣ
+
+д٣߲pin()֮ȡָ룬һٸıİ汾ߡ
+д֮ûУ޸ʱƴӸ޸Ľڵ·(дʱ)ɰ汾
+ãµĸ֮󣬾·ϵĽڵ㽻epoch_domainաͬһupdate()Ѿƹ
+Ľڵֱԭ޸ģʱÿڵิһΡ
+ڵӽڵģһкܶӽڵĽڵʱÿζҪ飬
+Ӧ÷һupdate()
+*/
+
+namespace detail
+{
+  /**ɱǩlabelsرǩβ"."*/
+  inline std::size_t split_reversed_labels(std::string_view domain,std::string_view* labels,std::size_t max_labels)
+  {
+    if(!domain.empty() && domain.back()=='.')
+      domain.remove_suffix(1);
+    std::size_t n=0;
+    while(!domain.empty())
+    {
+      if(n==max_labels)
+        throw std::length_error("domain has too many labels");
+      std::size_t const dot=domain.rfind('.');
+      if(dot==std::string_view::npos)
+      {
+        labels[n++]=domain;
+        break;
+      }
+      labels[n++]=domain.substr(dot+1);
+      domain=domain.substr(0,dot);
+    }
+    return n;
+  }
+}
+
+template<typename Value>
+class label_trie
+{
+public:
+  static constexpr std::size_t max_labels=128;  // DNS127ǩ
+
+  /**һβҵȫ*_labelsƥĺ׺ıǩ*/
+  struct match
+  {
+    bool exact=false;
+    Value exact_value{};
+    bool enclosing=false;
+    std::size_t enclosing_labels=0;
+    Value enclosing_value{};
+    bool wildcard=false;
+    std::size_t wildcard_labels=0;  // "*"֮ĺ׺ͨһϼ
+    Value wildcard_value{};
+  };
+
+private:
+  struct node;
+
+  struct child
+  {
+    std::uint32_t hash;  // ӽڵһǩĹϣ
+    node* target;
+  };
+
+  struct node
+  {
+    std::vector<std::uint32_t> path;  // Ӹڵ㵽ıǩţڵΪ
+    std::vector<child> children;      // hash
+    std::uint64_t version;            // update()ͬһupdate()пԭ޸
+    bool has_value=false;
+    Value value{};
+
+    explicit node(std::uint64_t version_): version(version_) {}
+  };
+
+  string_interner labels;
+  std::uint32_t const star_hash;
+  mutable epoch_domain domain;
+  std::atomic<node*> root;
+  std::mutex writer_mutex;
+  std::uint64_t next_version=1;
+  std::atomic<std::size_t> count{0};
+
+  static void destroy(void* p)
+  {
+    delete static_cast<node*>(p);  // ֻɾһڵ㣬ӽڵ°汾
+  }
+
+  static void destroy_tree(node* n)
+  {
+    for(child const& c : n->children)
+      destroy_tree(c.target);
+    delete n;
+  }
+
+  /**ڰhashchildrenҵһǩΪsӽڵ㣬д߶*/
+  child const* find_child(node const* n,std::string_view s,std::uint32_t h) const
+  {
+    auto it=std::lower_bound(n->children.begin(),n->children.end(),h,
+                             [](child const& c,std::uint32_t v){return c.hash<v;});
+    for(;it!=n->children.end() && it->hash==h;++it)
+      if(labels[it->target->path[0]]==s)
+        return &*it;
+    return nullptr;
+  }
+
+  /**nextıqueryͷļǩ"*"query"*"λûбǩ*/
+  bool wildcard_edge(node const* next,std::string_view const* query,std::size_t n) const
+  {
+    std::size_t const p=next->path.size();
+    if(p<2 || p>n || !next->has_value || labels[next->path[p-1]]!="*")
+      return false;
+    for(std::size_t k=1;k+1<p;++k)
+      if(labels[next->path[k]]!=query[k])
+        return false;
+    return true;
+  }
+
+  /**ӸߣÿƥĽڵvisit(node,ƥıǩ,һҪߵӽڵnullptr)*/
+  template<typename Visit>
+  void walk(std::string_view const* query,std::size_t n,Visit visit) const
+  {
+    node const* current=root.load(std::memory_order_acquire);
+    std::size_t i=0;
+    for(;;)
+    {
+      child const* const c=i<n ? find_child(current,query[i],string_interner::hash(query[i])) : nullptr;
+      visit(current,i,c);
+      if(!c)
+        return;
+      node const* const next=c->target;
+      if(next->path.size()>n-i)
+        return;
+      for(std::size_t k=1;k<next->path.size();++k)
+        if(labels[next->path[k]]!=query[i+k])
+          return;  // 1 ѹıֻƥһ֣һĽڵ
+      i+=next->path.size();
+      current=next;
+    }
+  }
+
+public:
+  /**update()fд*/
+  class writer
+  {
+    label_trie& trie;
+    std::uint64_t const version;
+    node* new_root;
+    std::vector<node*> garbage;  // ɰ汾бƵĽڵ㣬֮
+
+    node* writable(node* n)
+    {
+      if(n->version==version)
+        return n;
+      node* const copy=new node(*n);
+      copy->version=version;
+      garbage.push_back(n);
+      return copy;
+    }
+
+    static void insert_child(node* parent,child c)
+    {
+      auto const it=std::upper_bound(parent->children.begin(),parent->children.end(),c.hash,
+                                     [](std::uint32_t v,child const& x){return v<x.hash;});
+      parent->children.insert(it,c);
+    }
+
+    std::size_t child_index(node const* n,std::uint32_t id) const
+    {
+      std::uint32_t const h=trie.labels.hash_of(id);
+      auto it=std::lower_bound(n->children.begin(),n->children.end(),h,
+                               [](child const& c,std::uint32_t v){return c.hash<v;});
+      for(;it!=n->children.end() && it->hash==h;++it)
+        if(it->target->path[0]==id)
+          return std::size_t(it-n->children.begin());
+      return n->children.size();
+    }
+
+    node* leaf(std::uint32_t const* ids,std::size_t n,Value const& value)
+    {
+      node* const l=new node(version);
+      l->path.assign(ids,ids+n);
+      l->has_value=true;
+      l->value=value;
+      return l;
+    }
+
+    /**nѾдtrueʾһ*/
+    bool insert(node* n,std::uint32_t const* ids,std::size_t size,Value const& value)
+    {
+      if(size==0)
+      {
+        bool const added=!n->has_value;
+        n->has_value=true;
+        n->value=value;
+        return added;
+      }
+      std::size_t const ci=child_index(n,ids[0]);
+      if(ci==n->children.size())
+      {
+        insert_child(n,child{trie.labels.hash_of(ids[0]),leaf(ids,size,value)});
+        return true;
+      }
+      node* const c=n->children[ci].target;
+      std::size_t k=1;
+      while(k<c->path.size() && k<size && c->path[k]==ids[k])
+        ++k;
+      if(k==c->path.size())
+      {
+        node* const wc=writable(c);
+        n->children[ci].target=wc;
+        return insert(wc,ids+k,size-k,value);
+      }
+      node* const middle=new node(version);  // 2 ѹıмֿ
+      middle->path.assign(c->path.begin(),c->path.begin()+k);
+      node* const tail=writable(c);
+      tail->path.erase(tail->path.begin(),tail->path.begin()+k);
+      middle->children.push_back(child{trie.labels.hash_of(tail->path[0]),tail});
+      if(k==size)
+      {
+        middle->has_value=true;
+        middle->value=value;
+      }
+      else
+        insert_child(middle,child{trie.labels.hash_of(ids[k]),leaf(ids+k,size-k,value)});
+      n->children[ci].target=middle;
+      return true;
+    }
+
+    /**nѾдǰѾȷ*/
+    void erase(node* n,std::uint32_t const* ids,std::size_t size)
+    {
+      if(size==0)
+      {
+        n->has_value=false;
+        n->value=Value();
+        return;
+      }
+      std::size_t const ci=child_index(n,ids[0]);
+      node* const wc=writable(n->children[ci].target);
+      n->children[ci].target=wc;
+      erase(wc,ids+wc->path.size(),size-wc->path.size());
+      if(wc->has_value)
+        return;
+      if(wc->children.empty())
+      {
+        n->children.erase(n->children.begin()+ci);
+        delete wc;  // update()дģ߿
+      }
+      else if(wc->children.size()==1)
+      {
+        node* const only=writable(wc->children[0].target);  // 3 Ψһӽڵϲ
+        only->path.insert(only->path.begin(),wc->path.begin(),wc->path.end());
+        n->children[ci].target=only;
+        delete wc;
+      }
+    }
+
+  public:
+    writer(label_trie& trie_):
+      trie(trie_),version(trie.next_version++),
+      new_root(trie.root.load(std::memory_order_relaxed))
+    {
+      new_root=writable(new_root);
+    }
+
+    writer(writer const&)=delete;
+    writer& operator=(writer const&)=delete;
+
+    bool insert_or_assign(std::string_view domain,Value const& value)
+    {
+      std::string_view parts[max_labels];
+      std::size_t const n=detail::split_reversed_labels(domain,parts,max_labels);
+      std::uint32_t ids[max_labels];
+      for(std::size_t i=0;i<n;++i)
+        ids[i]=trie.labels.intern(parts[i]);
+      bool const added=insert(new_root,ids,n,value);
+      if(added)
+        trie.count.fetch_add(1,std::memory_order_relaxed);
+      return added;
+    }
+
+    bool erase(std::string_view domain)
+    {
+      std::string_view parts[max_labels];
+      std::size_t const n=detail::split_reversed_labels(domain,parts,max_labels);
+      std::uint32_t ids[max_labels];
+      node const* current=new_root;
+      std::size_t i=0;
+      for(std::size_t k=0;k<n;++k)
+        if((ids[k]=trie.labels.find(parts[k]))==string_interner::npos)
+          return false;
+      while(i<n)  // ֻȷϴڣʱκνڵ
+      {
+        std::size_t const ci=child_index(current,ids[i]);
+        if(ci==current->children.size())
+          return false;
+        node const* const c=current->children[ci].target;
+        if(c->path.size()>n-i || !std::equal(c->path.begin(),c->path.end(),ids+i))
+          return false;
+        i+=c->path.size();
+        current=c;
+      }
+      if(!current->has_value)
+        return false;
+      erase(new_root,ids,n);
+      trie.count.fetch_sub(1,std::memory_order_relaxed);
+      return true;
+    }
+
+    /**°汾վɰ汾б滻Ľڵ*/
+    void publish()
+    {
+      trie.root.store(new_root,std::memory_order_release);
+      for(node* old : garbage)
+        trie.domain.retire(old,&destroy);
+      garbage.clear();
+    }
+  };
+
+  label_trie():
+    star_hash(string_interner::hash("*")),root(new node(0))
+  {}
+
+  label_trie(label_trie const&)=delete;
+  label_trie& operator=(label_trie const&)=delete;
+
+  ~label_trie()
+  {
+    destroy_tree(root.load(std::memory_order_relaxed));
+  }
+
+  /**һдеf(writer&)fغ°汾Զ߿ɼ*/
+  template<typename Function>
+  void update(Function f)
+  {
+    std::lock_guard<std::mutex> lk(writer_mutex);
+    writer w(*this);
+    f(w);
+    w.publish();
+  }
+
+  bool insert_or_assign(std::string_view domain_name,Value const& value)
+  {
+    bool added=false;
+    update([&](writer& w){added=w.insert_or_assign(domain_name,value);});
+    return added;
+  }
+
+  bool erase(std::string_view domain_name)
+  {
+    bool erased=false;
+    update([&](writer& w){erased=w.erase(domain_name);});
+    return erased;
+  }
+
+  match lookup(std::string_view domain_name) const
+  {
+    std::string_view query[max_labels];
+    std::size_t const n=detail::split_reversed_labels(domain_name,query,max_labels);
+    match result;
+    auto const g=domain.pin();
+    walk(query,n,[&](node const* at,std::size_t depth,child const* next)
+    {
+      if(at->has_value)
+      {
+        result.enclosing=true;
+        result.enclosing_labels=depth;
+        result.enclosing_value=at->value;
+        if(depth==n)
+        {
+          result.exact=true;
+          result.exact_value=at->value;
+        }
+      }
+      if(depth<n)
+      {
+        child const* const c=find_child(at,"*",star_hash);
+        if(c && c->target->path.size()==1 && c->target->has_value)
+        {
+          result.wildcard=true;
+          result.wildcard_labels=depth;
+          result.wildcard_value=c->target->value;
+        }
+      }
+      if(next && wildcard_edge(next->target,query+depth,n-depth))
+      {
+        result.wildcard=true;  // 4 "*"ѹıĩβֻ*.b.example.comʱexample.com -> b -> *
+        result.wildcard_labels=depth+next->target->path.size()-1;
+        result.wildcard_value=next->target->value;
+      }
+    });
+    return result;
+  }
+
+  bool find(std::string_view domain_name,Value& value) const
+  {
+    std::string_view query[max_labels];
+    std::size_t const n=detail::split_reversed_labels(domain_name,query,max_labels);
+    bool found=false;
+    auto const g=domain.pin();
+    walk(query,n,[&](node const* at,std::size_t depth,child const*)
+    {
+      if(depth==n && at->has_value)
+      {
+        value=at->value;
+        found=true;
+      }
+    });
+    return found;
+  }
+
+  /**zoneµÿf(domain,value)˳ΪǩĲ˳*/
+  template<typename Function>
+  void for_each_in_zone(std::string_view zone,Function f) const
+  {
+    std::string_view query[max_labels];
+    std::size_t const n=detail::split_reversed_labels(zone,query,max_labels);
+    auto const g=domain.pin();
+    node const* current=root.load(std::memory_order_acquire);
+    std::vector<std::uint32_t> prefix;
+    std::size_t i=0;
+    while(i<n)  // ҵzoneڵĽڵ㣬zoneѹıм
+    {
+      child const* const c=find_child(current,query[i],string_interner::hash(query[i]));
+      if(!c)
+        return;
+      node const* const next=c->target;
+      for(std::size_t k=0;k<next->path.size() && i+k<n;++k)
+        if(labels[next->path[k]]!=query[i+k])
+          return;
+      prefix.insert(prefix.end(),next->path.begin(),next->path.end());
+      i+=next->path.size();
+      current=next;
+    }
+    visit_subtree(current,prefix,f);
+  }
+
+  std::size_t size() const
+  {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  std::size_t label_count() const
+  {
+    return labels.size();
+  }
+
+  epoch_domain& reclamation() const
+  {
+    return domain;
+  }
+
+private:
+  template<typename Function>
+  void visit_subtree(node const* n,std::vector<std::uint32_t>& reversed,Function& f) const
+  {
+    if(n->has_value)
+    {
+      std::string name;
+      for(std::size_t k=reversed.size();k--;)
+      {
+        name.append(labels[reversed[k]]);
+        if(k)
+          name.push_back('.');
+      }
+      f(name,static_cast<Value const&>(n->value));
+    }
+    for(child const& c : n->children)
+    {
+      reversed.insert(reversed.end(),c.target->path.begin(),c.target->path.end());
+      visit_subtree(c.target,reversed,f);
+      reversed.resize(reversed.size()-c.target->path.size());
+    }
+  }
+};
+
+#endif // LABEL_TRIE_H_INCLUDED
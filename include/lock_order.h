@@ -0,0 +1,298 @@
+#ifndef LOCK_ORDER_H_INCLUDED
+#define LOCK_ORDER_H_INCLUDED
+
+/*
+ʱļ˳(Linuxں˵lockdep)̳߳AʱȥȡBȫֵ
+˳ͼм¼һA->Bıߣͬʱλȡʱĵջ¼ıͼгֻ
+(֮ǰĳطBʱȡA)˵ļ˳෴ʹû
+ʱͻʱĵջ
+
+ֻLOCK_ORDER_CHECKINGΪ1ʱЧĬΪ0ʱchecked_mutex<M>Mhierarchical_mutex
+std::mutexһת·ûκζĴ롣Ĳֲͬ
+ͬһб뵥ԪʹͬһֵܸԵNDEBUGCMake
+CONCURRENCY_LOCK_ORDER_CHECKINGѡͳһconcurrencyĿϡ
+ջbacktrace()ȡʱ-rdynamicܿ
+*/
+
+#ifndef LOCK_ORDER_CHECKING
+#define LOCK_ORDER_CHECKING 0
+#endif
+
+#if LOCK_ORDER_CHECKING
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cxxabi.h>
+#include <execinfo.h>
+
+struct lock_order_violation
+{
+  std::string first;   // γе
+  std::string second;  // Ҫȡ
+  std::vector<std::string> current_stack;  // firstʱȡsecond
+  std::vector<std::string> previous_stack;  // ֮ǰsecond()ʱȡfirst(ǰ)
+
+  std::string describe() const
+  {
+    std::string res="lock order inversion: acquiring "+second+" while holding "+first+"\n";
+    res+="  this acquisition:\n";
+    for(auto const& frame : current_stack)
+      res+="    "+frame+"\n";
+    res+="  earlier acquisition in the opposite order:\n";
+    for(auto const& frame : previous_stack)
+      res+="    "+frame+"\n";
+    return res;
+  }
+};
+
+class lock_order_graph
+{
+public:
+  typedef std::function<void(lock_order_violation const&)> handler;
+
+private:
+  struct edge_info
+  {
+    std::vector<void*> stack;
+  };
+
+  std::mutex m;
+  std::map<void const*,std::map<void const*,edge_info>> edges;  // from -> (to -> һγʱĵջ)
+  std::map<void const*,std::string> names;
+  handler on_violation;
+
+  static std::vector<void const*>& held()
+  {
+    thread_local std::vector<void const*> locks;
+    return locks;
+  }
+
+  static std::vector<void*> capture_stack()
+  {
+    std::vector<void*> frames(32);
+    int const n=backtrace(frames.data(),static_cast<int>(frames.size()));
+    frames.resize(n>0 ? n : 0);
+    return frames;
+  }
+
+  static std::vector<std::string> symbolize(std::vector<void*> const& frames)
+  {
+    std::vector<std::string> res;
+    char** const symbols=backtrace_symbols(frames.data(),static_cast<int>(frames.size()));
+    if(!symbols)
+      return res;
+    for(std::size_t i=0;i<frames.size();++i)
+    {
+      std::string frame=symbols[i];  //  module(mangled+0x1f) [0x...]
+      std::size_t const open=frame.find('(');
+      std::size_t const plus=frame.find('+',open);
+      if(open!=std::string::npos && plus!=std::string::npos && plus>open+1)
+      {
+        int status=0;
+        char* const demangled=abi::__cxa_demangle(frame.substr(open+1,plus-open-1).c_str(),nullptr,nullptr,&status);
+        if(status==0)
+          frame.replace(open+1,plus-open-1,demangled);
+        std::free(demangled);
+      }
+      if(frame.find("lock_order_graph::")==std::string::npos)  // ʾԼջ֡
+        res.push_back(frame);
+    }
+    std::free(symbols);
+    return res;
+  }
+
+  std::string name_of(void const* lock)
+  {
+    auto const it=names.find(lock);
+    return it!=names.end() ? it->second : "lock";
+  }
+
+  /**fromܷ񵽴toܵĻ·ϵĵһߵĵջ(߳m)*/
+  edge_info const* find_path(void const* from,void const* to,std::set<void const*>& visited)
+  {
+    if(!visited.insert(from).second)
+      return nullptr;
+    auto const it=edges.find(from);
+    if(it==edges.end())
+      return nullptr;
+    for(auto const& e : it->second)
+    {
+      if(e.first==to)
+        return &e.second;
+      if(find_path(e.first,to,visited))
+        return &e.second;
+    }
+    return nullptr;
+  }
+
+  lock_order_graph():
+    on_violation([](lock_order_violation const& v)
+    {
+      std::cerr<<v.describe()<<std::flush;
+      std::abort();
+    })
+  {}
+
+public:
+  static lock_order_graph& instance()
+  {
+    static lock_order_graph* const graph=new lock_order_graph;  // ̬ʱܼ
+    return *graph;
+  }
+
+  /**滻ֻʱĴĬstd::cerrabort()ԭĴ*/
+  handler set_violation_handler(handler h)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    std::swap(on_violation,h);
+    return h;
+  }
+
+  void name(void const* lock,char const* lock_name)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    names[lock]=lock_name ? lock_name : "";
+  }
+
+  /**֮ǰãԱʱû*/
+  void before_lock(void const* lock)
+  {
+    std::vector<void const*> const& locks=held();
+    if(locks.empty())
+      return;
+    std::vector<void*> stack;
+    lock_order_violation violation;
+    handler h;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      for(void const* holder : locks)
+      {
+        if(holder==lock)
+          continue;
+        auto& out=edges[holder];
+        if(out.count(lock))  // 1 Ѿ˳򣬲Ҫټ
+          continue;
+        std::set<void const*> visited;
+        if(edge_info const* const reverse=find_path(lock,holder,visited))
+        {
+          if(stack.empty())
+            stack=capture_stack();
+          violation.first=name_of(holder);
+          violation.second=name_of(lock);
+          violation.current_stack=symbolize(stack);
+          violation.previous_stack=symbolize(reverse->stack);
+          h=on_violation;
+          break;
+        }
+        if(stack.empty())
+          stack=capture_stack();
+        out[lock].stack=stack;
+      }
+    }
+    if(h)
+      h(violation);  // 2 ͼ֮ã׳쳣
+  }
+
+  void after_lock(void const* lock)
+  {
+    held().push_back(lock);
+  }
+
+  void after_unlock(void const* lock)
+  {
+    std::vector<void const*>& locks=held();
+    for(auto it=locks.rbegin();it!=locks.rend();++it)  // ˳һ෴
+    {
+      if(*it==lock)
+      {
+        locks.erase(std::next(it).base());
+        return;
+      }
+    }
+  }
+
+  /**ʱɾصıߣַܻᱻµ*/
+  void forget(void const* lock)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    edges.erase(lock);
+    for(auto& e : edges)
+      e.second.erase(lock);
+    names.erase(lock);
+  }
+
+  std::size_t edge_count()
+  {
+    std::lock_guard<std::mutex> lk(m);
+    std::size_t n=0;
+    for(auto const& e : edges)
+      n+=e.second.size();
+    return n;
+  }
+};
+
+/**MĻϼ¼˳MҪLockableҪ*/
+template<typename Mutex>
+class checked_mutex
+{
+  Mutex m;
+
+public:
+  explicit checked_mutex(char const* name=nullptr)
+  {
+    lock_order_graph::instance().name(this,name);
+  }
+
+  ~checked_mutex()
+  {
+    lock_order_graph::instance().forget(this);
+  }
+
+  checked_mutex(checked_mutex const&)=delete;
+  checked_mutex& operator=(checked_mutex const&)=delete;
+
+  void lock()
+  {
+    lock_order_graph::instance().before_lock(this);
+    m.lock();
+    lock_order_graph::instance().after_lock(this);
+  }
+
+  bool try_lock()  // try_lock()µı
+  {
+    if(!m.try_lock())
+      return false;
+    lock_order_graph::instance().after_lock(this);
+    return true;
+  }
+
+  void unlock()
+  {
+    lock_order_graph::instance().after_unlock(this);
+    m.unlock();
+  }
+};
+
+#else
+
+/**棺checked_mutex<M>M*/
+template<typename Mutex>
+class checked_mutex: public Mutex
+{
+public:
+  explicit checked_mutex(char const* =nullptr) {}
+};
+
+#endif // LOCK_ORDER_CHECKING
+
+#endif // LOCK_ORDER_H_INCLUDED
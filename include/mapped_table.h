@@ -0,0 +1,350 @@
+#ifndef MAPPED_TABLE_H_INCLUDED
+#define MAPPED_TABLE_H_INCLUDED
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "string_interner.h"  // string_interner::hash()
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+mapped_table<Value>һֻġֱmmapʹõַ->Valueϣļ
+Ŀգʱýܲҡļֻļͷƫƣûָ룬ӳ䵽
+ĸַã
+  header:  ħ汾sizeof(Value)ļȡֵƫƺУͣ
+  table:   Ѱַ̽ļ¼飬С2ݣװӲ1/2
+  records: ÿ¼{ϣֵ,ıƫ}
+  values:  ¼еValue(Ҫ԰ֽڸ)
+  text:    ÿǰһֽڵĳȣstring_internerͬ
+write()дpath.tmpfsync֮ΪpathҪôļҪôļ
+open()鳤ȡֵı߽ļУͣдһ߱𻵵ļᱻʹã
+ֻ˳һļơڴ棬֮ĲֱӳҳϽС
+ֽValueĲдļĻͬڲͬƽ̨֮䴫ݡ
+*/
+
+enum class snapshot_status
+{
+  ok,
+  missing,       // ļڻ޷
+  truncated,     // ͷͷ¼ĳȶ
+  bad_header,    // ħ汾ValueСƫƲ
+  bad_checksum
+};
+
+namespace detail
+{
+  /**8ֽһFNV-1aΣ㹻дһͱĶļֹܷĴ۸*/
+  inline std::uint64_t snapshot_checksum(unsigned char const* data,std::size_t size)
+  {
+    std::uint64_t h=14695981039346656037ull;
+    std::size_t i=0;
+    for(;i+8<=size;i+=8)
+    {
+      std::uint64_t word;
+      std::memcpy(&word,data+i,8);
+      h=(h^word)*1099511628211ull;
+      h^=h>>32;
+    }
+    for(;i<size;++i)
+      h=(h^data[i])*1099511628211ull;
+    return h;
+  }
+}
+
+template<typename Value>
+class mapped_table
+{
+  static_assert(std::is_trivially_copyable<Value>::value,"mapped_table stores Value as raw bytes");
+
+  struct header
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t value_size;
+    std::uint64_t file_size;
+    std::uint64_t checksum;  // headerֽ֮
+    std::uint32_t count;
+    std::uint32_t table_size;
+    std::uint64_t table_offset;
+    std::uint64_t records_offset;
+    std::uint64_t values_offset;
+    std::uint64_t text_offset;
+  };
+
+  struct record
+  {
+    std::uint32_t hash;
+    std::uint32_t text;  // text_offset
+  };
+
+  static constexpr char file_magic[8]={'M','A','P','T','B','L','1','\0'};
+  static constexpr std::uint32_t file_version=1;
+
+  unsigned char const* base=nullptr;
+  std::size_t mapped_size=0;
+  header const* head=nullptr;
+  std::uint32_t const* table=nullptr;
+  record const* records=nullptr;
+  unsigned char const* values=nullptr;
+  char const* text=nullptr;
+
+  static std::size_t align_up(std::size_t n,std::size_t alignment)
+  {
+    return (n+alignment-1)/alignment*alignment;
+  }
+
+  [[noreturn]] static void throw_errno(char const* what)
+  {
+    throw std::system_error(errno,std::generic_category(),what);
+  }
+
+  void unmap()
+  {
+    if(base)
+      ::munmap(const_cast<unsigned char*>(base),mapped_size);
+    base=nullptr;
+    mapped_size=0;
+    head=nullptr;
+  }
+
+  /**ӳ֮ʹ֮ǰеƫƣĲҲټ߽*/
+  snapshot_status validate()
+  {
+    if(mapped_size<sizeof(header))
+      return snapshot_status::truncated;
+    if(std::memcmp(head->magic,file_magic,sizeof(file_magic))!=0 ||
+       head->version!=file_version || head->value_size!=sizeof(Value))
+      return snapshot_status::bad_header;
+    if(head->file_size!=mapped_size)
+      return snapshot_status::truncated;
+    std::size_t const table_bytes=std::size_t(head->table_size)*sizeof(std::uint32_t);
+    if(head->table_size==0 || (head->table_size&(head->table_size-1))!=0 ||
+       head->table_size<2*std::size_t(head->count) ||  // 1 write()װӲ1/2
+       head->table_offset!=align_up(sizeof(header),8) ||
+       head->records_offset!=align_up(head->table_offset+table_bytes,8) ||
+       head->values_offset!=align_up(head->records_offset+std::size_t(head->count)*sizeof(record),alignof(Value)>8 ? alignof(Value) : 8) ||
+       head->text_offset!=head->values_offset+std::size_t(head->count)*sizeof(Value) ||
+       head->text_offset>mapped_size)
+      return snapshot_status::bad_header;
+    if(detail::snapshot_checksum(base+sizeof(header),mapped_size-sizeof(header))!=head->checksum)
+      return snapshot_status::bad_checksum;
+    std::size_t const text_size=mapped_size-head->text_offset;
+    records=reinterpret_cast<record const*>(base+head->records_offset);
+    for(std::uint32_t i=0;i<head->count;++i)
+      if(records[i].text>=text_size ||
+         records[i].text+1+static_cast<unsigned char>(base[head->text_offset+records[i].text])>text_size)
+        return snapshot_status::bad_header;
+    table=reinterpret_cast<std::uint32_t const*>(base+head->table_offset);
+    std::size_t occupied=0;
+    for(std::uint32_t i=0;i<head->table_size;++i)
+      if(table[i]!=string_interner::npos)
+      {
+        if(table[i]>=head->count)
+          return snapshot_status::bad_header;
+        ++occupied;
+      }
+    if(occupied>head->count)  // 2 һǿղۣfind()̽һͣ
+      return snapshot_status::bad_header;
+    return snapshot_status::ok;
+  }
+
+public:
+  static constexpr std::uint32_t npos=string_interner::npos;
+
+  mapped_table()=default;
+  mapped_table(mapped_table const&)=delete;
+  mapped_table& operator=(mapped_table const&)=delete;
+
+  ~mapped_table()
+  {
+    unmap();
+  }
+
+  /**
+  [first,last)еpair<,Value>дpathظÿ255ֽڡ
+  ʱ׳std::system_errorpathԭݲ䡣
+  */
+  template<typename Iterator>
+  static void write(std::string const& path,Iterator first,Iterator last)
+  {
+    std::vector<std::pair<std::string_view,Value const*>> items;
+    for(;first!=last;++first)
+    {
+      if(first->first.size()>string_interner::max_length)
+        throw std::length_error("mapped_table: key too long");
+      items.emplace_back(first->first,&first->second);
+    }
+    if(items.size()>=npos/2)
+      throw std::length_error("mapped_table: too many keys");
+
+    std::size_t table_size=16;
+    while(table_size<2*items.size())
+      table_size*=2;
+    header h{};
+    std::memcpy(h.magic,file_magic,sizeof(file_magic));
+    h.version=file_version;
+    h.value_size=sizeof(Value);
+    h.count=std::uint32_t(items.size());
+    h.table_size=std::uint32_t(table_size);
+    h.table_offset=align_up(sizeof(header),8);
+    h.records_offset=align_up(h.table_offset+table_size*sizeof(std::uint32_t),8);
+    h.values_offset=align_up(h.records_offset+items.size()*sizeof(record),alignof(Value)>8 ? alignof(Value) : 8);
+    h.text_offset=h.values_offset+items.size()*sizeof(Value);
+    std::size_t text_size=0;
+    for(auto const& item : items)
+      text_size+=1+item.first.size();
+    if(text_size>npos)
+      throw std::length_error("mapped_table: keys too long");
+    h.file_size=h.text_offset+text_size;
+
+    std::vector<unsigned char> file(h.file_size);
+    auto* const slots=reinterpret_cast<std::uint32_t*>(file.data()+h.table_offset);
+    std::fill(slots,slots+table_size,npos);
+    std::size_t text_used=0;
+    for(std::uint32_t i=0;i<items.size();++i)
+    {
+      std::string_view const key=items[i].first;
+      record const r{string_interner::hash(key),std::uint32_t(text_used)};
+      std::memcpy(file.data()+h.records_offset+i*sizeof(record),&r,sizeof(record));
+      std::memcpy(file.data()+h.values_offset+i*sizeof(Value),items[i].second,sizeof(Value));
+      file[h.text_offset+text_used]=static_cast<unsigned char>(key.size());
+      std::memcpy(file.data()+h.text_offset+text_used+1,key.data(),key.size());
+      text_used+=1+key.size();
+      std::size_t slot=r.hash&(table_size-1);
+      while(slots[slot]!=npos)
+        slot=(slot+1)&(table_size-1);
+      slots[slot]=i;
+    }
+    h.checksum=detail::snapshot_checksum(file.data()+sizeof(header),file.size()-sizeof(header));
+    std::memcpy(file.data(),&h,sizeof(header));
+
+    std::string const temporary=path+".tmp";
+    int const fd=::open(temporary.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
+    if(fd<0)
+      throw_errno("open");
+    std::size_t written=0;
+    while(written<file.size())
+    {
+      ssize_t const n=::write(fd,file.data()+written,file.size()-written);
+      if(n<0 && errno==EINTR)
+        continue;
+      if(n<0)
+      {
+        int const error=errno;
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        errno=error;
+        throw_errno("write");
+      }
+      written+=std::size_t(n);
+    }
+    if(::fsync(fd)!=0)  // 3 ٸܿȶԡݲԵļ
+    {
+      int const error=errno;
+      ::close(fd);
+      ::unlink(temporary.c_str());
+      errno=error;
+      throw_errno("fsync");
+    }
+    ::close(fd);
+    if(::rename(temporary.c_str(),path.c_str())!=0)
+    {
+      int const error=errno;
+      ::unlink(temporary.c_str());
+      errno=error;
+      throw_errno("rename");
+    }
+  }
+
+  /**ֻӳpathokʱӳ*/
+  snapshot_status open(std::string const& path)
+  {
+    unmap();
+    int const fd=::open(path.c_str(),O_RDONLY|O_CLOEXEC);
+    if(fd<0)
+      return snapshot_status::missing;
+    struct stat st;
+    if(::fstat(fd,&st)!=0 || st.st_size<0)
+    {
+      ::close(fd);
+      return snapshot_status::missing;
+    }
+    if(std::size_t(st.st_size)<sizeof(header))
+    {
+      ::close(fd);
+      return snapshot_status::truncated;
+    }
+    void* const p=::mmap(nullptr,std::size_t(st.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+    ::close(fd);  // ӳ䲻ļ
+    if(p==MAP_FAILED)
+      return snapshot_status::missing;
+    base=static_cast<unsigned char const*>(p);
+    mapped_size=std::size_t(st.st_size);
+    head=reinterpret_cast<header const*>(base);
+    snapshot_status const status=validate();
+    if(status!=snapshot_status::ok)
+    {
+      unmap();
+      return status;
+    }
+    values=base+head->values_offset;
+    text=reinterpret_cast<char const*>(base+head->text_offset);
+    return status;
+  }
+
+  bool is_open() const
+  {
+    return head!=nullptr;
+  }
+
+  std::size_t size() const
+  {
+    return head ? head->count : 0;
+  }
+
+  /**keyļ¼ţûʱnpos*/
+  std::uint32_t find(std::string_view key) const
+  {
+    if(!head || key.size()>string_interner::max_length)
+      return npos;
+    std::uint32_t const h=string_interner::hash(key);
+    std::uint32_t const mask=head->table_size-1;
+    for(std::uint32_t i=h&mask;;i=(i+1)&mask)
+    {
+      std::uint32_t const id=table[i];
+      if(id==npos)
+        return npos;
+      if(records[id].hash==h && this->key(id)==key)
+        return id;
+    }
+  }
+
+  std::string_view key(std::uint32_t id) const
+  {
+    char const* const p=text+records[id].text;
+    return std::string_view(p+1,static_cast<unsigned char>(p[0]));
+  }
+
+  Value value(std::uint32_t id) const
+  {
+    Value v;
+    std::memcpy(&v,values+std::size_t(id)*sizeof(Value),sizeof(Value));  // ֽڸƣڱ
+    return v;
+  }
+};
+
+#endif // MAPPED_TABLE_H_INCLUDED
@@ -0,0 +1,408 @@
+#ifndef PARALLEL_ALGORITHMS_H_INCLUDED
+#define PARALLEL_ALGORITHMS_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+/*
+2.4ڵparallel_accumulateѷΧֳɿ飬ÿmin_per_threadԪأ
+õ߳һɵ߳Լͬķֿ鷽
+ʵaccumulatefor_eachtransformfindpartial_sumpartitionsortĲа汾ǣ
+  1. 齻thread_poolִУÿεọ̈߳
+     Ĭʹdefault_parallel_pool()hardware_concurrency()-1̣߳
+     ϵ߳Ӳ߳ҲԴԼ̳߳߳
+  2. ߳ڵȴʱִ̳߳ŶӵڳٵЩ㷨
+     ҲΪ̶߳ڵȴ
+  3. ĳһ׳쳣п׸(ֻһ)
+Ӧstd::㷨ͬ(findصһƥԪ)
+partial_sumҪopɣpartitionsort֤ȶ
+*/
+
+namespace detail
+{
+  unsigned long const parallel_min_per_thread=25;  // parallel_accumulateͬ
+
+  /**λҪstd::next()ɲͬ߳ͬʱд룬ǰ*/
+  template<typename Iterator>
+  constexpr bool is_forward_iterator=std::is_base_of<std::forward_iterator_tag,
+                                                     typename std::iterator_traits<Iterator>::iterator_category>::value;
+
+  template<typename Iterator>
+  struct block_split
+  {
+    std::vector<Iterator> bounds;  // count()+1ֽ
+    unsigned long block_size;
+
+    std::size_t count() const { return bounds.size()-1; }
+  };
+
+  /**parallel_accumulateͬķֿ飬̳߳ص߳ϵ߳*/
+  template<typename Iterator>
+  block_split<Iterator> split_blocks(thread_pool& pool,Iterator first,Iterator last)
+  {
+    unsigned long const length=std::distance(first,last);
+    block_split<Iterator> split;
+    split.bounds.push_back(first);
+    if(!length)
+    {
+      split.block_size=0;
+      return split;
+    }
+    unsigned long const max_threads=(length+parallel_min_per_thread-1)/parallel_min_per_thread;
+    unsigned long const num_threads=std::min<unsigned long>(pool.size()+1ul,max_threads);
+    split.block_size=length/num_threads;
+    Iterator block_start=first;
+    for(unsigned long i=0;i<num_threads-1;++i)
+    {
+      std::advance(block_start,split.block_size);
+      split.bounds.push_back(block_start);
+    }
+    split.bounds.push_back(last);  // һĲ
+    return split;
+  }
+
+  /**[0,count)еÿif(i)һڵִ߳УǰȴеĿ*/
+  template<typename Function>
+  void run_blocks(thread_pool& pool,std::size_t count,Function f)
+  {
+    if(!count)
+      return;
+    std::vector<std::future<void>> futures;
+    futures.reserve(count-1);
+    for(std::size_t i=0;i+1<count;++i)
+      futures.push_back(pool.submit([&f,i]{f(i);}));
+    std::exception_ptr error;
+    try
+    {
+      f(count-1);
+    }
+    catch(...)
+    {
+      error=std::current_exception();
+    }
+    for(auto& future : futures)
+    {
+      while(future.wait_for(std::chrono::seconds(0))!=std::future_status::ready)
+      {
+        if(!pool.run_pending_task())  // 1 ȰæִŶӵ񣻶п˵ʣµĿ鶼ѿʼִ
+        {
+          future.wait();
+          break;
+        }
+      }
+      try
+      {
+        future.get();
+      }
+      catch(...)
+      {
+        if(!error)
+          error=std::current_exception();
+      }
+    }
+    if(error)
+      std::rethrow_exception(error);
+  }
+}
+
+/**㷨Ĭʹõ̳߳أһʹʱ*/
+inline thread_pool& default_parallel_pool()
+{
+  static thread_pool pool(thread_pool::default_thread_count()-1);
+  return pool;
+}
+
+/**
+2.4parallel_accumulate̳߳ذ汾ĲֺͰ˳initϲ
+Ϊ˲2.4ڵĴ嵥ûṩ̳߳صأԴdefault_parallel_pool()
+*/
+template<typename Iterator,typename T>
+T parallel_accumulate(thread_pool& pool,Iterator first,Iterator last,T init)
+{
+  auto const split=detail::split_blocks(pool,first,last);
+  std::vector<T> results(split.count());
+  detail::run_blocks(pool,split.count(),[&](std::size_t i)
+  {
+    results[i]=std::accumulate(split.bounds[i],split.bounds[i+1],results[i]);
+  });
+  return std::accumulate(results.begin(),results.end(),init);
+}
+
+template<typename Iterator,typename Function>
+void parallel_for_each(thread_pool& pool,Iterator first,Iterator last,Function f)
+{
+  auto const split=detail::split_blocks(pool,first,last);
+  detail::run_blocks(pool,split.count(),[&](std::size_t i)
+  {
+    std::for_each(split.bounds[i],split.bounds[i+1],f);  // ÿʹfһ
+  });
+}
+
+template<typename Iterator,typename Function>
+void parallel_for_each(Iterator first,Iterator last,Function f)
+{
+  parallel_for_each(default_parallel_pool(),first,last,std::move(f));
+}
+
+template<typename InputIterator,typename OutputIterator,typename Operation>
+OutputIterator parallel_transform(thread_pool& pool,InputIterator first,InputIterator last,
+                                  OutputIterator d_first,Operation op)
+{
+  if constexpr(!detail::is_forward_iterator<OutputIterator>)
+    return std::transform(first,last,d_first,op);  // 1 std::back_inserterֻ˳д룬ֿܷ
+  else
+  {
+    auto const split=detail::split_blocks(pool,first,last);
+    detail::run_blocks(pool,split.count(),[&](std::size_t i)
+    {
+      std::transform(split.bounds[i],split.bounds[i+1],std::next(d_first,i*split.block_size),op);
+    });
+    return std::next(d_first,std::distance(first,last));
+  }
+}
+
+template<typename InputIterator,typename OutputIterator,typename Operation>
+OutputIterator parallel_transform(InputIterator first,InputIterator last,OutputIterator d_first,Operation op)
+{
+  return parallel_transform(default_parallel_pool(),first,last,d_first,std::move(op));
+}
+
+/**
+صһpredԪءҵСλͬʱ䵱ɱ־
+ɨ赽λʱǰ鲻ҵǰĽֹͣ
+*/
+template<typename Iterator,typename Predicate>
+Iterator parallel_find_if(thread_pool& pool,Iterator first,Iterator last,Predicate pred)
+{
+  auto const split=detail::split_blocks(pool,first,last);
+  unsigned long const length=std::distance(first,last);
+  std::atomic<unsigned long> found(length);
+  detail::run_blocks(pool,split.count(),[&](std::size_t i)
+  {
+    unsigned long pos=i*split.block_size;
+    for(Iterator it=split.bounds[i];it!=split.bounds[i+1];++it,++pos)
+    {
+      if(found.load(std::memory_order_relaxed)<pos)  // 2 ǰĿѾҵ
+        return;
+      if(pred(*it))
+      {
+        unsigned long current=found.load(std::memory_order_relaxed);
+        while(pos<current && !found.compare_exchange_weak(current,pos,std::memory_order_relaxed))
+          ;
+        return;
+      }
+    }
+  });
+  unsigned long const result=found.load();
+  return result==length ? last : std::next(first,result);
+}
+
+template<typename Iterator,typename Predicate>
+Iterator parallel_find_if(Iterator first,Iterator last,Predicate pred)
+{
+  return parallel_find_if(default_parallel_pool(),first,last,std::move(pred));
+}
+
+template<typename Iterator,typename T>
+Iterator parallel_find(thread_pool& pool,Iterator first,Iterator last,T const& value)
+{
+  return parallel_find_if(pool,first,last,[&value](auto const& x){return x==value;});
+}
+
+template<typename Iterator,typename T>
+Iterator parallel_find(Iterator first,Iterator last,T const& value)
+{
+  return parallel_find(default_parallel_pool(),first,last,value);
+}
+
+/**
+ɣһǰ׺ͣȻڵ߳ϰѸܺۼӳÿƫ
+ڶڶ鼰ԺÿԪؼƫd_first==first
+*/
+template<typename InputIterator,typename OutputIterator,typename Operation>
+OutputIterator parallel_partial_sum(thread_pool& pool,InputIterator first,InputIterator last,
+                                    OutputIterator d_first,Operation op)
+{
+  static_assert(detail::is_forward_iterator<OutputIterator>,"parallel_partial_sum writes and rereads the output blocks, use a forward iterator");
+  typedef typename std::iterator_traits<InputIterator>::value_type value_type;
+  auto const split=detail::split_blocks(pool,first,last);
+  std::size_t const count=split.count();
+  std::vector<OutputIterator> outputs;
+  for(std::size_t i=0;i<=count;++i)
+    outputs.push_back(i<count ? std::next(d_first,i*split.block_size) : std::next(d_first,std::distance(first,last)));
+  std::vector<value_type> block_last(count);
+  detail::run_blocks(pool,count,[&](std::size_t i)
+  {
+    OutputIterator const end=std::partial_sum(split.bounds[i],split.bounds[i+1],outputs[i],op);
+    if(end!=outputs[i])
+      block_last[i]=*std::next(outputs[i],std::distance(split.bounds[i],split.bounds[i+1])-1);
+  });
+  if(count<2)
+    return outputs[count];
+  std::vector<value_type> offsets(count);
+  offsets[1]=block_last[0];
+  for(std::size_t i=2;i<count;++i)
+    offsets[i]=op(offsets[i-1],block_last[i-1]);
+  detail::run_blocks(pool,count-1,[&](std::size_t j)
+  {
+    std::size_t const i=j+1;
+    for(OutputIterator it=outputs[i];it!=outputs[i+1];++it)
+      *it=op(offsets[i],*it);
+  });
+  return outputs[count];
+}
+
+template<typename InputIterator,typename OutputIterator>
+OutputIterator parallel_partial_sum(thread_pool& pool,InputIterator first,InputIterator last,OutputIterator d_first)
+{
+  return parallel_partial_sum(pool,first,last,d_first,std::plus<>());
+}
+
+template<typename InputIterator,typename OutputIterator,typename Operation>
+OutputIterator parallel_partial_sum(InputIterator first,InputIterator last,OutputIterator d_first,Operation op)
+{
+  return parallel_partial_sum(default_parallel_pool(),first,last,d_first,std::move(op));
+}
+
+template<typename InputIterator,typename OutputIterator>
+OutputIterator parallel_partial_sum(InputIterator first,InputIterator last,OutputIterator d_first)
+{
+  return parallel_partial_sum(default_parallel_pool(),first,last,d_first,std::plus<>());
+}
+
+/**
+ȸstd::partitionٰڷֽ""ԪҲ""Ԫ
+ԪصĸһȣҲֿ鲢нСطֽ㡣
+*/
+template<typename RandomIt,typename Predicate>
+RandomIt parallel_partition(thread_pool& pool,RandomIt first,RandomIt last,Predicate pred)
+{
+  typedef std::pair<RandomIt,RandomIt> range;
+  auto const split=detail::split_blocks(pool,first,last);
+  std::size_t const count=split.count();
+  std::vector<RandomIt> middles(count);
+  detail::run_blocks(pool,count,[&](std::size_t i)
+  {
+    middles[i]=std::partition(split.bounds[i],split.bounds[i+1],pred);
+  });
+
+  RandomIt mid=first;
+  for(std::size_t i=0;i<count;++i)
+    mid+=middles[i]-split.bounds[i];
+  std::vector<range> misplaced_false,misplaced_true;  // ֱλmidҲ
+  for(std::size_t i=0;i<count;++i)
+  {
+    RandomIt const false_begin=middles[i],false_end=std::min(split.bounds[i+1],mid);
+    if(false_begin<false_end)
+      misplaced_false.push_back(range(false_begin,false_end));
+    RandomIt const true_begin=std::max(split.bounds[i],mid),true_end=middles[i];
+    if(true_begin<true_end)
+      misplaced_true.push_back(range(true_begin,true_end));
+  }
+
+  auto const prefix=[](std::vector<range> const& ranges)
+  {
+    std::vector<long> starts(1,0);
+    for(auto const& r : ranges)
+      starts.push_back(starts.back()+(r.second-r.first));
+    return starts;
+  };
+  std::vector<long> const false_starts=prefix(misplaced_false),true_starts=prefix(misplaced_true);
+  long const misplaced=false_starts.back();  // true_starts.back()
+  if(!misplaced)
+    return mid;
+
+  // 3 ѵkλļԪغ͵kλԪؽkֿ
+  struct cursor
+  {
+    std::vector<range> const* ranges;
+    std::size_t index;
+    RandomIt it;
+
+    cursor(std::vector<range> const& r,std::vector<long> const& starts,long k):
+      ranges(&r),
+      index(std::upper_bound(starts.begin(),starts.end(),k)-starts.begin()-1),
+      it(r[index].first+(k-starts[index]))
+    {}
+
+    void advance()
+    {
+      if(++it==(*ranges)[index].second && ++index<ranges->size())
+        it=(*ranges)[index].first;
+    }
+  };
+  std::vector<long> indices(misplaced);
+  auto const swap_split=detail::split_blocks(pool,indices.begin(),indices.end());
+  detail::run_blocks(pool,swap_split.count(),[&](std::size_t i)
+  {
+    long const begin=swap_split.bounds[i]-indices.begin();
+    long const end=swap_split.bounds[i+1]-indices.begin();
+    cursor f(misplaced_false,false_starts,begin),t(misplaced_true,true_starts,begin);
+    for(long k=begin;k<end;++k,f.advance(),t.advance())
+      std::iter_swap(f.it,t.it);
+  });
+  return mid;
+}
+
+template<typename RandomIt,typename Predicate>
+RandomIt parallel_partition(RandomIt first,RandomIt last,Predicate pred)
+{
+  return parallel_partition(default_parallel_pool(),first,last,std::move(pred));
+}
+
+/**鲢std::sortstd::inplace_mergeÿһֺϲҲн*/
+template<typename RandomIt,typename Compare>
+void parallel_sort(thread_pool& pool,RandomIt first,RandomIt last,Compare comp)
+{
+  auto const split=detail::split_blocks(pool,first,last);
+  detail::run_blocks(pool,split.count(),[&](std::size_t i)
+  {
+    std::sort(split.bounds[i],split.bounds[i+1],comp);
+  });
+  std::vector<RandomIt> bounds=split.bounds;
+  while(bounds.size()>2)
+  {
+    std::size_t const blocks=bounds.size()-1;
+    detail::run_blocks(pool,blocks/2,[&](std::size_t i)
+    {
+      std::inplace_merge(bounds[2*i],bounds[2*i+1],bounds[2*i+2],comp);
+    });
+    std::vector<RandomIt> merged;
+    for(std::size_t i=0;i<bounds.size();i+=2)
+      merged.push_back(bounds[i]);
+    if(blocks%2)
+      merged.push_back(bounds.back());  // Ϊʱһһ
+    bounds.swap(merged);
+  }
+}
+
+template<typename RandomIt>
+void parallel_sort(thread_pool& pool,RandomIt first,RandomIt last)
+{
+  parallel_sort(pool,first,last,std::less<>());
+}
+
+template<typename RandomIt,typename Compare>
+void parallel_sort(RandomIt first,RandomIt last,Compare comp)
+{
+  parallel_sort(default_parallel_pool(),first,last,std::move(comp));
+}
+
+template<typename RandomIt>
+void parallel_sort(RandomIt first,RandomIt last)
+{
+  parallel_sort(default_parallel_pool(),first,last,std::less<>());
+}
+
+#endif // PARALLEL_ALGORITHMS_H_INCLUDED
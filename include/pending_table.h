@@ -0,0 +1,141 @@
+#ifndef PENDING_TABLE_H_INCLUDED
+#define PENDING_TABLE_H_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/*
+process_connections()еconnection->get_promise(data.id)ÿһݰҪԼ
+һΡidģͬһʱ;󲻻ᳬһڣֱ
+idĵλΪ±꣺λһηãҾһȡģһαȽϣûйϣҲû
+ָתλԭظá
+std::promiseֺãòλʱȻҪΪµpromise乲״̬ʡµ
+ڵķͷš
+౾ʹ(connection)ԼĻ·ʡ
+*/
+
+struct request_timeout: std::exception
+{
+  const char* what() const throw() {
+    return "request timeout!";
+  };
+};
+
+template<typename T,typename Clock=std::chrono::steady_clock>
+class pending_table
+{
+public:
+  typedef typename Clock::time_point time_point;
+
+private:
+  struct slot
+  {
+    std::uint32_t id;
+    bool in_use;
+    time_point deadline;
+    std::promise<T> promise;
+  };
+
+  std::vector<slot> slots;
+  std::uint32_t const mask;
+  std::size_t in_use_count;
+  std::size_t timed_count;  // ˽ֹʱ;
+
+  static std::uint32_t round_up(std::size_t n)
+  {
+    std::uint32_t size=1;
+    while(size<n)
+      size<<=1;
+    return size;
+  }
+
+  void release(slot& s)
+  {
+    s.in_use=false;
+    --in_use_count;
+    if(s.deadline!=time_point::max())
+      --timed_count;
+  }
+
+public:
+  /**capacityȡΪ2ݣͬһʱ;*/
+  explicit pending_table(std::size_t capacity):
+    slots(round_up(capacity)),mask(static_cast<std::uint32_t>(slots.size()-1)),
+    in_use_count(0),timed_count(0)
+  {
+    for(auto& s : slots)
+      s.in_use=false;
+  }
+
+  pending_table(pending_table const&)=delete;
+  pending_table& operator=(pending_table const&)=delete;
+
+  /**Ǽһdeadline֮ûжֵĻexpire()future׳request_timeout*/
+  std::future<T> add(std::uint32_t id,time_point deadline=time_point::max())
+  {
+    slot& s=slots[id&mask];
+    if(s.in_use)  // 1 ڵľûɣ˵;󳬹
+      throw std::length_error("pending_table: too many requests in flight");
+    s.id=id;
+    s.in_use=true;
+    s.deadline=deadline;
+    s.promise=std::promise<T>();
+    ++in_use_count;
+    if(deadline!=time_point::max())
+      ++timed_count;
+    return s.promise.get_future();
+  }
+
+  /**idӦûеǼǹ(Ѿʱ)򷵻false*/
+  bool fulfil(std::uint32_t id,T value)
+  {
+    slot& s=slots[id&mask];
+    if(!s.in_use || s.id!=id)  // 2 ûеǼǣѾʱ
+      return false;
+    s.promise.set_value(std::move(value));
+    release(s);
+    return true;
+  }
+
+  /**ѹֹʱʧܣʧܵĸ*/
+  std::size_t expire(time_point now)
+  {
+    std::size_t expired=0;
+    for(auto& s : slots)
+    {
+      if(!timed_count)
+        break;
+      if(s.in_use && s.deadline<=now)
+      {
+        s.promise.set_exception(std::make_exception_ptr(request_timeout()));
+        release(s);
+        ++expired;
+      }
+    }
+    return expired;
+  }
+
+  /**ӶϿʱ;ʧ*/
+  void fail_all(std::exception_ptr e)
+  {
+    for(auto& s : slots)
+    {
+      if(s.in_use)
+      {
+        s.promise.set_exception(e);
+        release(s);
+      }
+    }
+  }
+
+  std::size_t size() const { return in_use_count; }
+  std::size_t capacity() const { return slots.size(); }
+  bool has_deadlines() const { return timed_count!=0; }
+};
+
+#endif // PENDING_TABLE_H_INCLUDED
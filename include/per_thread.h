@@ -0,0 +1,212 @@
+#ifndef PER_THREAD_H_INCLUDED
+#define PER_THREAD_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+/*
+2.5ᵽstd::thread::idΪļֵÿ̵߳Ϣͳʱ
+ÿۼӶҪסٲһιϣper_thread<T>Ϊÿ߳׼һĲۣ
+̵߳һηʱǼǣ֮local()ֻһthread_localȡ±ꣻ
+ÿ۰ж룬̵ͬ߳Ĳ֮ûα
+for_each()/combine()вʱд߳Ҳᱻ
+Զһĳʱ̸ĽֵTҪܱ(std::atomic)
+
+߳˳ıŻᱻ̸߳ãͬеݣۼӵĽᶪʧ
+*/
+
+namespace detail
+{
+  /**ÿ̷߳һСţ߳˳*/
+  class thread_index_registry
+  {
+    std::mutex m;
+    std::vector<unsigned> free_indices;
+    unsigned next_index=0;
+
+  public:
+    static thread_index_registry& instance()
+    {
+      static thread_index_registry* const registry=new thread_index_registry;  // 1 ߳˳ʱܻҪ
+      return *registry;
+    }
+
+    unsigned acquire()
+    {
+      std::lock_guard<std::mutex> lk(m);
+      if(free_indices.empty())
+        return next_index++;
+      unsigned const index=free_indices.back();
+      free_indices.pop_back();
+      return index;
+    }
+
+    void release(unsigned index)
+    {
+      std::lock_guard<std::mutex> lk(m);
+      free_indices.push_back(index);
+    }
+  };
+
+  struct thread_index_holder
+  {
+    unsigned const index;
+    thread_index_holder(): index(thread_index_registry::instance().acquire()) {}
+    ~thread_index_holder() { thread_index_registry::instance().release(index); }
+  };
+
+  inline unsigned this_thread_index()
+  {
+    thread_local thread_index_holder const holder;
+    return holder.index;
+  }
+
+  /**ÿ߳ԼxorshiftҪ*/
+  inline std::uint64_t thread_random()
+  {
+    thread_local std::uint64_t state=(this_thread_index()+1)*0x9e3779b97f4a7c15ull;
+    state^=state<<13;
+    state^=state>>7;
+    state^=state<<17;
+    return state;
+  }
+}
+
+template<typename T>
+class per_thread
+{
+  struct alignas(64) slot
+  {
+    T value{};
+  };
+
+  static constexpr unsigned chunk_bits=6;
+  static constexpr unsigned chunk_size=1u<<chunk_bits;
+  static constexpr unsigned max_chunks=64;  // 4096ͬʱڵ߳
+
+  typedef std::atomic<slot*> chunk;
+
+  std::atomic<chunk*> chunks[max_chunks];
+  std::atomic<unsigned> chunk_count;  // ѾchunkϽ磬ʱ
+  std::mutex m;  // ֻڵǼ߳ʱʹ
+
+  T& register_slot(unsigned index)
+  {
+    unsigned const c=index>>chunk_bits;
+    if(c>=max_chunks)
+      throw std::length_error("per_thread: too many threads");
+    std::lock_guard<std::mutex> lk(m);
+    chunk* slots=chunks[c].load(std::memory_order_relaxed);
+    if(!slots)
+    {
+      slots=new chunk[chunk_size];
+      for(unsigned i=0;i<chunk_size;++i)
+        slots[i].store(nullptr,std::memory_order_relaxed);
+      chunks[c].store(slots,std::memory_order_release);
+      if(chunk_count.load(std::memory_order_relaxed)<=c)
+        chunk_count.store(c+1,std::memory_order_release);
+    }
+    slot* const s=new slot;
+    slots[index&(chunk_size-1)].store(s,std::memory_order_release);
+    return s->value;
+  }
+
+public:
+  per_thread(): chunk_count(0)
+  {
+    for(auto& c : chunks)
+      c.store(nullptr,std::memory_order_relaxed);
+  }
+
+  ~per_thread()
+  {
+    for(auto& c : chunks)
+    {
+      chunk* const slots=c.load(std::memory_order_relaxed);
+      if(!slots)
+        continue;
+      for(unsigned i=0;i<chunk_size;++i)
+        delete slots[i].load(std::memory_order_relaxed);
+      delete[] slots;
+    }
+  }
+
+  per_thread(per_thread const&)=delete;
+  per_thread& operator=(per_thread const&)=delete;
+
+  /**ǰ̵߳ĲۣһεʱǼ*/
+  T& local()
+  {
+    unsigned const index=detail::this_thread_index();
+    unsigned const c=index>>chunk_bits;
+    chunk* const slots=c<max_chunks ? chunks[c].load(std::memory_order_acquire) : nullptr;  // Χʱregister_slot()׳쳣
+    if(slots)
+    {
+      slot* const s=slots[index&(chunk_size-1)].load(std::memory_order_acquire);
+      if(s)
+        return s->value;
+    }
+    return register_slot(index);
+  }
+
+  /**ÿǼǹĲ۵f(T&)д߳*/
+  template<typename Function>
+  void for_each(Function f)
+  {
+    unsigned const count=chunk_count.load(std::memory_order_acquire);
+    for(unsigned c=0;c<count;++c)
+    {
+      chunk* const slots=chunks[c].load(std::memory_order_acquire);
+      if(!slots)
+        continue;
+      for(unsigned i=0;i<chunk_size;++i)
+        if(slot* const s=slots[i].load(std::memory_order_acquire))
+          f(s->value);
+    }
+  }
+
+  /**initÿεop(acc, T&)õĽ*/
+  template<typename Result,typename Operation>
+  Result combine(Result init,Operation op)
+  {
+    for_each([&](T& value){init=op(std::move(init),value);});
+    return init;
+  }
+
+  std::size_t slot_count()
+  {
+    std::size_t n=0;
+    for_each([&](T&){++n;});
+    return n;
+  }
+};
+
+/**
+̷߳Ƭļÿֻ߳дadd()ҪԭӵĶ--д
+һͨļӷԭӵдؼɣread()вӡ
+*/
+class sharded_counter
+{
+  per_thread<std::atomic<std::int64_t>> slots;
+
+public:
+  void add(std::int64_t n=1)
+  {
+    std::atomic<std::int64_t>& c=slots.local();
+    c.store(c.load(std::memory_order_relaxed)+n,std::memory_order_relaxed);
+  }
+
+  std::int64_t read()
+  {
+    return slots.combine(std::int64_t(0),[](std::int64_t sum,std::atomic<std::int64_t>& c)
+    {
+      return sum+c.load(std::memory_order_relaxed);
+    });
+  }
+};
+
+#endif // PER_THREAD_H_INCLUDED
@@ -0,0 +1,144 @@
+#ifndef SEQLOCK_H_INCLUDED
+#define SEQLOCK_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+#include "spin_mutex.h"  // detail::cpu_relax()
+
+/*
+ádns_entryСļ¼ֻм֣ȴƵȡ޸ģdata_wrapper
+std::mutexʱÿζȡҪдڵĻСseqlock<T>öȫдڴ棺
+д޸ǰżһ(޸ڼΪ)ȶšٸݡٶһţ
+ͬΪż˵ƵһĿգԡ
+
+ݰֱstd::atomicдreleaseдÿ֣acquireȡֻҪ
+ĳдκһ֣ٶʱһܿǴдõš
+C++ڴģⲻݾҲդ(ThreadSanitizerդ)
+ThreadSanitizer󱨣x86acquire/releaseĶдͨmov
+ֻһдʱstore()wait-freeģд֮ͨϵCAS⡣
+lock-freeģдԽƵԽࡣTƽơ
+*/
+
+template<typename T>
+class alignas(64) seqlock
+{
+  static_assert(std::is_trivially_copyable<T>::value,"seqlock<T> requires a trivially copyable T");
+
+  typedef std::uintptr_t word;
+  static constexpr std::size_t word_count=(sizeof(T)+sizeof(word)-1)/sizeof(word);
+
+  std::atomic<std::uint64_t> seq{0};  // ʾд
+  std::atomic<word> data[word_count];
+
+  void write_words(T const& value)
+  {
+    word buffer[word_count]={};
+    std::memcpy(buffer,&value,sizeof(T));
+    for(std::size_t i=0;i<word_count;++i)
+      data[i].store(buffer[i],std::memory_order_release);  // 1 ݿɼ
+  }
+
+  std::uint64_t begin_write()
+  {
+    std::uint64_t s=seq.load(std::memory_order_relaxed);
+    unsigned spins=0;
+    for(;;)
+    {
+      if(!(s&1) && seq.compare_exchange_weak(s,s+1,std::memory_order_acquire,std::memory_order_relaxed))
+        break;
+      if(++spins>64)
+        std::this_thread::yield();  // һд߿ܱ
+      else
+        detail::cpu_relax();
+      s=seq.load(std::memory_order_relaxed);
+    }
+    return s+1;
+  }
+
+  void end_write(std::uint64_t odd)
+  {
+    seq.store(odd+1,std::memory_order_release);  // 2 µżſɼ
+  }
+
+public:
+  explicit seqlock(T const& initial=T())
+  {
+    write_words(initial);
+  }
+
+  seqlock(seqlock const&)=delete;
+  seqlock& operator=(seqlock const&)=delete;
+
+  /**ԶȡһΣдʱfalseȴ*/
+  bool try_load(T& out) const
+  {
+    std::uint64_t const before=seq.load(std::memory_order_acquire);
+    if(before&1)
+      return false;
+    word buffer[word_count];
+    for(std::size_t i=0;i<word_count;++i)
+      buffer[i]=data[i].load(std::memory_order_acquire);  // 3 1ԣݾһ
+    if(seq.load(std::memory_order_relaxed)!=before)
+      return false;
+    std::memcpy(&out,buffer,sizeof(T));
+    return true;
+  }
+
+  /**ȡһĿգҪʱ*/
+  T load() const
+  {
+    T value;
+    unsigned spins=0;
+    while(!try_load(value))
+    {
+      if(++spins>64)
+        std::this_thread::yield();  // ддһʱ
+      else
+        detail::cpu_relax();
+    }
+    return value;
+  }
+
+  void store(T const& value)
+  {
+    std::uint64_t const odd=begin_write();
+    write_words(value);
+    end_write(odd);
+  }
+
+  /**д߻¶ȡǰֵf(T&)޸ĺд*/
+  template<typename Function>
+  void modify(Function f)
+  {
+    std::uint64_t const odd=begin_write();
+    word buffer[word_count];
+    for(std::size_t i=0;i<word_count;++i)
+      buffer[i]=data[i].load(std::memory_order_relaxed);
+    T value;
+    std::memcpy(&value,buffer,sizeof(T));
+    try
+    {
+      f(value);
+    }
+    catch(...)
+    {
+      end_write(odd);  // ݻûиĶָֻż
+      throw;
+    }
+    write_words(value);
+    end_write(odd);
+  }
+
+  /**ɵд*/
+  std::uint64_t version() const
+  {
+    return seq.load(std::memory_order_acquire)/2;
+  }
+};
+
+#endif // SEQLOCK_H_INCLUDED
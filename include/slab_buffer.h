@@ -0,0 +1,371 @@
+#ifndef SLAB_BUFFER_H_INCLUDED
+#define SLAB_BUFFER_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+process_connections()data.payloadֵp.set_value()ǰֿһΣ
+64KBݰ⿽ռ˴󲿷CPUĻɹ̶СĿɣ
+buffer_poolаslab䣬üùصã
+buffer_sliceĳеһΣbuffer_chainɶε(ɢ/ۼͼ)
+slicechainֻüݣԿֱͨpromise/futureݣ
+ʱٰѸֱӽwritev()/sendmsg()
+Ѿȥֽڲٱ޸ģֻгchunk_writer̻߳ڿβ׷ݡ
+*/
+
+class buffer_chain;
+
+class buffer_pool
+{
+public:
+  struct chunk
+  {
+    std::atomic<unsigned> refs;
+    buffer_pool* owner;
+    chunk* next_free;
+
+    char* data() { return reinterpret_cast<char*>(this)+header_size(); }
+    static std::size_t header_size() { return (sizeof(chunk)+63)&~std::size_t(63); }
+  };
+
+private:
+  std::size_t const chunk_bytes;
+  std::size_t const chunks_per_slab;
+  std::mutex m;
+  chunk* free_list;
+  std::vector<char*> slabs;
+  std::atomic<std::size_t> refs;  // 1(buffer_pool)+ûй黹Ŀ
+
+  void grow()  // ߳m
+  {
+    std::size_t const stride=chunk::header_size()+((chunk_bytes+63)&~std::size_t(63));
+    char* const slab=static_cast<char*>(::operator new(stride*chunks_per_slab,std::align_val_t(64)));
+    slabs.push_back(slab);
+    for(std::size_t i=0;i<chunks_per_slab;++i)
+    {
+      chunk* const c=new(slab+i*stride) chunk;
+      c->owner=this;
+      c->next_free=free_list;
+      free_list=c;
+    }
+  }
+
+  void release_pool()
+  {
+    if(refs.fetch_sub(1,std::memory_order_acq_rel)==1)
+    {
+      for(char* slab : slabs)
+        ::operator delete(slab,std::align_val_t(64));
+      this->~buffer_pool();
+      ::operator delete(this);  // create()
+    }
+  }
+
+  buffer_pool(std::size_t chunk_size,std::size_t chunks_per_slab_):
+    chunk_bytes(chunk_size),chunks_per_slab(chunks_per_slab_ ? chunks_per_slab_ : 1),
+    free_list(nullptr),refs(1)
+  {}
+
+  struct deleter
+  {
+    void operator()(buffer_pool* p) const
+    {
+      p->release_pool();  // пû黹ʱһ黹ʱͷ
+    }
+  };
+
+public:
+  typedef std::unique_ptr<buffer_pool,deleter> pointer;
+
+  /**buffer_poolȥĻ٣ֻͨcreate()*/
+  static pointer create(std::size_t chunk_size=64*1024,std::size_t chunks_per_slab=16)
+  {
+    void* const raw=::operator new(sizeof(buffer_pool));
+    return pointer(new(raw) buffer_pool(chunk_size,chunks_per_slab));
+  }
+
+  buffer_pool(buffer_pool const&)=delete;
+  buffer_pool& operator=(buffer_pool const&)=delete;
+
+  std::size_t chunk_size() const { return chunk_bytes; }
+
+  /**һüΪ1Ŀ*/
+  chunk* acquire()
+  {
+    chunk* c;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      if(!free_list)
+        grow();
+      c=free_list;
+      free_list=c->next_free;
+    }
+    refs.fetch_add(1,std::memory_order_relaxed);
+    c->refs.store(1,std::memory_order_relaxed);
+    return c;
+  }
+
+  static void add_ref(chunk* c)
+  {
+    c->refs.fetch_add(1,std::memory_order_relaxed);
+  }
+
+  static void release(chunk* c)
+  {
+    if(c->refs.fetch_sub(1,std::memory_order_acq_rel)!=1)
+      return;
+    buffer_pool* const pool=c->owner;
+    {
+      std::lock_guard<std::mutex> lk(pool->m);
+      c->next_free=pool->free_list;
+      pool->free_list=c;
+    }
+    pool->release_pool();
+  }
+
+  /**Ŀ۲츴*/
+  std::size_t chunks_allocated()
+  {
+    std::lock_guard<std::mutex> lk(m);
+    return slabs.size()*chunks_per_slab;
+  }
+
+  template<typename Filler>
+  buffer_chain make(std::size_t size,Filler fill);
+  buffer_chain copy_from(void const* data,std::size_t size);
+};
+
+/**еһֻݣʱֻӿü*/
+class buffer_slice
+{
+  buffer_pool::chunk* c;
+  std::size_t offset;
+  std::size_t length;
+
+public:
+  buffer_slice(): c(nullptr),offset(0),length(0) {}
+
+  /**ӹcһ*/
+  buffer_slice(buffer_pool::chunk* c_,std::size_t offset_,std::size_t length_):
+    c(c_),offset(offset_),length(length_)
+  {}
+
+  buffer_slice(buffer_slice const& other):
+    c(other.c),offset(other.offset),length(other.length)
+  {
+    if(c)
+      buffer_pool::add_ref(c);
+  }
+
+  buffer_slice(buffer_slice&& other) noexcept:
+    c(other.c),offset(other.offset),length(other.length)
+  {
+    other.c=nullptr;
+    other.length=0;
+  }
+
+  buffer_slice& operator=(buffer_slice other) noexcept
+  {
+    std::swap(c,other.c);
+    std::swap(offset,other.offset);
+    std::swap(length,other.length);
+    return *this;
+  }
+
+  ~buffer_slice()
+  {
+    if(c)
+      buffer_pool::release(c);
+  }
+
+  char const* data() const { return c->data()+offset; }
+  std::size_t size() const { return length; }
+
+  buffer_slice sub(std::size_t off,std::size_t len) const
+  {
+    if(!c)
+      return buffer_slice();
+    buffer_pool::add_ref(c);
+    return buffer_slice(c,offset+off,len);
+  }
+
+  /**nextǷڱ֮(ͬһ)ǵĻοԺϲ*/
+  bool adjacent(buffer_slice const& next) const
+  {
+    return c && c==next.c && offset+length==next.offset;
+  }
+
+  void extend(std::size_t n) { length+=n; }
+};
+
+/**ɶɵ߼Ļ*/
+class buffer_chain
+{
+  std::vector<buffer_slice> parts;
+  std::size_t bytes;
+
+public:
+  buffer_chain(): bytes(0) {}
+
+  std::size_t size() const { return bytes; }
+  bool empty() const { return bytes==0; }
+  std::vector<buffer_slice> const& slices() const { return parts; }
+
+  void append(buffer_slice s)
+  {
+    if(!s.size())
+      return;
+    bytes+=s.size();
+    if(!parts.empty() && parts.back().adjacent(s))
+      parts.back().extend(s.size());  // һʱֱӺϲs֮ͷ
+    else
+      parts.push_back(std::move(s));
+  }
+
+  void append(buffer_chain const& other)
+  {
+    for(auto const& s : other.parts)
+      append(s);
+  }
+
+  /**[offset, offset+len)ӦУ*/
+  buffer_chain sub(std::size_t offset,std::size_t len) const
+  {
+    buffer_chain res;
+    for(auto const& s : parts)
+    {
+      if(!len)
+        break;
+      if(offset>=s.size())
+      {
+        offset-=s.size();
+        continue;
+      }
+      std::size_t const n=std::min(len,s.size()-offset);
+      res.append(s.sub(offset,n));
+      offset=0;
+      len-=n;
+    }
+    return res;
+  }
+
+  /**ͷnֽ*/
+  void consume(std::size_t n)
+  {
+    std::size_t whole=0;
+    bytes-=n;
+    while(whole<parts.size() && n>=parts[whole].size())
+      n-=parts[whole++].size();
+    parts.erase(parts.begin(),parts.begin()+whole);
+    if(n)
+      parts.front()=parts.front().sub(n,parts.front().size()-n);
+  }
+
+  /**[offset, offset+len)outڶȡݰͷС*/
+  void copy_to(char* out,std::size_t offset,std::size_t len) const
+  {
+    for(auto const& s : parts)
+    {
+      if(!len)
+        break;
+      if(offset>=s.size())
+      {
+        offset-=s.size();
+        continue;
+      }
+      std::size_t const n=std::min(len,s.size()-offset);
+      std::memcpy(out,s.data()+offset,n);
+      out+=n;
+      offset=0;
+      len-=n;
+    }
+  }
+
+  std::vector<char> to_vector() const
+  {
+    std::vector<char> res(bytes);
+    copy_to(res.data(),0,bytes);
+    return res;
+  }
+};
+
+/**¿β׷ݣֻһ߳ʹãѾcommit()ĲֿԷĽ߳*/
+class chunk_writer
+{
+  buffer_pool* pool;
+  buffer_pool::chunk* c;
+  std::size_t used;
+
+public:
+  explicit chunk_writer(buffer_pool& pool_): pool(&pool_),c(nullptr),used(0) {}
+
+  ~chunk_writer()
+  {
+    if(c)
+      buffer_pool::release(c);
+  }
+
+  chunk_writer(chunk_writer const&)=delete;
+  chunk_writer& operator=(chunk_writer const&)=delete;
+
+  /**ǰʣռʼλúʹСдʱԶһ¿*/
+  char* tail()
+  {
+    if(!c || used==pool->chunk_size())
+    {
+      if(c)
+        buffer_pool::release(c);
+      c=pool->acquire();
+      used=0;
+    }
+    return c->data()+used;
+  }
+
+  std::size_t room() const { return c ? pool->chunk_size()-used : 0; }
+
+  /**Ѹдtail()nֽڱֻһ*/
+  buffer_slice commit(std::size_t n)
+  {
+    buffer_pool::add_ref(c);
+    buffer_slice res(c,used,n);
+    used+=n;
+    return res;
+  }
+};
+
+/**sizeֽڣfill(char* p, std::size_t offset, std::size_t len)*/
+template<typename Filler>
+buffer_chain buffer_pool::make(std::size_t size,Filler fill)
+{
+  buffer_chain res;
+  chunk_writer writer(*this);
+  std::size_t offset=0;
+  while(offset<size)
+  {
+    char* const p=writer.tail();
+    std::size_t const n=std::min(writer.room(),size-offset);
+    fill(p,offset,n);
+    res.append(writer.commit(n));
+    offset+=n;
+  }
+  return res;
+}
+
+inline buffer_chain buffer_pool::copy_from(void const* data,std::size_t size)
+{
+  char const* const src=static_cast<char const*>(data);
+  return make(size,[src](char* p,std::size_t offset,std::size_t len)
+  {
+    std::memcpy(p,src+offset,len);
+  });
+}
+
+#endif // SLAB_BUFFER_H_INCLUDED
@@ -0,0 +1,185 @@
+#ifndef SPIN_MUTEX_H_INCLUDED
+#define SPIN_MUTEX_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+add_to_list()threadsafe_stack::push()threadsafe_queue::try_pop()ٽֻмʮ룬
+std::mutexһ߳futex˯ߣһνҪ΢롣
+
+spin_mutex: ֻ˯ߣֻصΪٳԻȡ(test-and-test-and-set)
+            ÿʧܺpauseĴӱ(ָ˱ܣ)޺óCPU
+            ֻʺٽ̡ܶ߳ĳϡ
+adaptive_mutex: һʱ䣬òfutex˯(Linuxƽ̨˻Ϊyield)
+            Ԥ㰴ʵҪĴԶ(glibc
+            PTHREAD_MUTEX_ADAPTIVE_NP)ֻһӲ߳ʱ
+
+߶LockableҪ󣬿std::lock_guardstd::lockstd::scoped_lock
+std::condition_variable_any
+*/
+
+namespace detail
+{
+  inline void cpu_relax()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+}
+
+class spin_mutex
+{
+  std::atomic<bool> locked{false};
+
+  static constexpr unsigned max_backoff=1024;
+
+public:
+  spin_mutex()=default;
+  spin_mutex(spin_mutex const&)=delete;
+  spin_mutex& operator=(spin_mutex const&)=delete;
+
+  void lock()
+  {
+    unsigned backoff=1;
+    for(;;)
+    {
+      if(!locked.exchange(true,std::memory_order_acquire))
+        return;
+      while(locked.load(std::memory_order_relaxed))  // 1 ֻȴûں֮ش
+      {
+        if(backoff<=max_backoff)
+        {
+          for(unsigned i=0;i<backoff;++i)
+            detail::cpu_relax();
+          backoff<<=1;
+        }
+        else
+          std::this_thread::yield();  // ߿ܱ
+      }
+    }
+  }
+
+  bool try_lock()
+  {
+    return !locked.load(std::memory_order_relaxed) && !locked.exchange(true,std::memory_order_acquire);
+  }
+
+  void unlock()
+  {
+    locked.store(false,std::memory_order_release);
+  }
+};
+
+class adaptive_mutex
+{
+  std::atomic<std::uint32_t> state{0};  // 0 У1 2 ҿ߳˯
+  std::atomic<std::uint32_t> spin_budget{initial_budget};
+
+  static constexpr std::uint32_t initial_budget=100;
+  static constexpr std::uint32_t max_budget=4000;
+  static constexpr std::uint32_t min_spins=16;
+
+  static bool may_spin()
+  {
+    static bool const multi_core=std::thread::hardware_concurrency()>1;
+    return multi_core;
+  }
+
+  void wait(std::uint32_t expected)
+  {
+#ifdef __linux__
+    syscall(SYS_futex,reinterpret_cast<std::uint32_t*>(&state),FUTEX_WAIT_PRIVATE,expected,nullptr,nullptr,0);
+#else
+    (void)expected;
+    std::this_thread::yield();
+#endif
+  }
+
+  void wake_one()
+  {
+#ifdef __linux__
+    syscall(SYS_futex,reinterpret_cast<std::uint32_t*>(&state),FUTEX_WAKE_PRIVATE,1,nullptr,nullptr,0);
+#endif
+  }
+
+  bool spin()
+  {
+    std::uint32_t const budget=spin_budget.load(std::memory_order_relaxed);
+    std::uint32_t limit=budget*2;
+    if(limit<min_spins)  // һԤлȥ
+      limit=min_spins;
+    if(limit>max_budget)
+      limit=max_budget;
+    std::uint32_t spins=0;
+    unsigned backoff=1;
+    bool acquired=false;
+    while(spins<limit)
+    {
+      std::uint32_t current=state.load(std::memory_order_relaxed);
+      if(current==0 && state.compare_exchange_weak(current,1,std::memory_order_acquire,std::memory_order_relaxed))
+      {
+        acquired=true;
+        break;
+      }
+      if(current==2)  // Ѿ߳˯ߣ˵ʱУ
+        break;
+      for(unsigned i=0;i<backoff && spins<limit;++i,++spins)
+        detail::cpu_relax();
+      if(backoff<64)
+        backoff<<=1;
+    }
+    // 2 ԤʵҪ£ûõʱ0£
+    std::uint32_t const target=acquired ? spins : 0;
+    spin_budget.store(budget+(static_cast<std::int32_t>(target)-static_cast<std::int32_t>(budget))/8,
+                      std::memory_order_relaxed);
+    return acquired;
+  }
+
+public:
+  adaptive_mutex()=default;
+  adaptive_mutex(adaptive_mutex const&)=delete;
+  adaptive_mutex& operator=(adaptive_mutex const&)=delete;
+
+  void lock()
+  {
+    std::uint32_t expected=0;
+    if(state.compare_exchange_strong(expected,1,std::memory_order_acquire,std::memory_order_relaxed))
+      return;
+    if(may_spin() && spin())
+      return;
+    while(state.exchange(2,std::memory_order_acquire)!=0)  // 3 еȴߣunlock()ʱŻȥ
+      wait(2);
+  }
+
+  bool try_lock()
+  {
+    std::uint32_t expected=0;
+    return state.compare_exchange_strong(expected,1,std::memory_order_acquire,std::memory_order_relaxed);
+  }
+
+  void unlock()
+  {
+    if(state.exchange(0,std::memory_order_release)==2)
+      wake_one();
+  }
+
+  /**ǰԤ㣬ڹ۲ӦЧ*/
+  std::uint32_t current_spin_budget() const { return spin_budget.load(std::memory_order_relaxed); }
+};
+
+#endif // SPIN_MUTEX_H_INCLUDED
@@ -0,0 +1,220 @@
+#ifndef STOP_TOKEN_H_INCLUDED
+#define STOP_TOKEN_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/*
+C++20std::stop_source/std::stop_tokenļ򻯰汾߳ѭ
+stop_token::stop_requested()ֻһԭӶϵ߳ͨ
+stop_callbackǼһصrequest_stop()ʱɻصѡ
+stop_callbackʱصһִ߳Уִ꣬Իص
+õľֲ֮Ͳٱʡ
+*/
+
+class stop_token;
+class stop_source;
+
+namespace detail
+{
+  struct stop_callback_base
+  {
+    void (*invoke)(stop_callback_base*);
+    stop_callback_base* prev=nullptr;
+    stop_callback_base* next=nullptr;
+    bool linked=false;
+  };
+
+  class stop_state
+  {
+    std::atomic<bool> stopped{false};
+    std::mutex m;
+    std::condition_variable done_cond;
+    stop_callback_base* head=nullptr;
+    stop_callback_base* running=nullptr;  // ִеĻص
+    std::thread::id stopper;
+
+  public:
+    bool stop_requested() const
+    {
+      return stopped.load(std::memory_order_acquire);
+    }
+
+    bool request_stop()
+    {
+      std::unique_lock<std::mutex> lk(m);
+      if(stopped.load(std::memory_order_relaxed))
+        return false;
+      stopped.store(true,std::memory_order_release);
+      stopper=std::this_thread::get_id();
+      while(head)
+      {
+        stop_callback_base* const cb=head;
+        head=cb->next;
+        if(head)
+          head->prev=nullptr;
+        cb->linked=false;
+        running=cb;
+        lk.unlock();
+        cb->invoke(cb);  // 1 صִУɵȥ
+        lk.lock();
+        running=nullptr;
+        done_cond.notify_all();
+      }
+      return true;
+    }
+
+    /**ѾֹͣʱǼǲfalseɵ߾Ƿֱִ*/
+    bool try_add(stop_callback_base* cb)
+    {
+      std::lock_guard<std::mutex> lk(m);
+      if(stopped.load(std::memory_order_relaxed))
+        return false;
+      cb->prev=nullptr;
+      cb->next=head;
+      if(head)
+        head->prev=cb;
+      head=cb;
+      cb->linked=true;
+      return true;
+    }
+
+    void remove(stop_callback_base* cb)
+    {
+      std::unique_lock<std::mutex> lk(m);
+      if(cb->linked)
+      {
+        if(cb->prev)
+          cb->prev->next=cb->next;
+        else
+          head=cb->next;
+        if(cb->next)
+          cb->next->prev=cb->prev;
+        cb->linked=false;
+        return;
+      }
+      if(running==cb && stopper!=std::this_thread::get_id())  // صԼԼʱܵ
+        done_cond.wait(lk,[&]{return running!=cb;});
+    }
+  };
+}
+
+class stop_token
+{
+  std::shared_ptr<detail::stop_state> state;
+
+  friend class stop_source;
+  template<typename Callback> friend class stop_callback;
+  template<typename Lock,typename Predicate>
+  friend bool interruptible_wait(std::condition_variable&,Lock&,stop_token const&,Predicate);
+
+  explicit stop_token(std::shared_ptr<detail::stop_state> state_): state(std::move(state_)) {}
+
+public:
+  stop_token() {}
+
+  bool stop_requested() const { return state && state->stop_requested(); }
+  bool stop_possible() const { return state!=nullptr; }
+};
+
+class stop_source
+{
+  std::shared_ptr<detail::stop_state> state;
+
+public:
+  stop_source(): state(std::make_shared<detail::stop_state>()) {}
+
+  stop_token get_token() const { return stop_token(state); }
+  bool stop_requested() const { return state->stop_requested(); }
+
+  /**ֻеһε÷trueǼǹĻصڵִ߳*/
+  bool request_stop() { return state->request_stop(); }
+};
+
+/**Ǽһrequest_stop()ʱִеĻصѾֹͣʱڹ캯ֱִ*/
+template<typename Callback>
+class stop_callback: private detail::stop_callback_base
+{
+  std::shared_ptr<detail::stop_state> state;
+  Callback callback;
+
+  static void call(detail::stop_callback_base* base)
+  {
+    static_cast<stop_callback*>(base)->callback();
+  }
+
+public:
+  template<typename C>
+  stop_callback(stop_token const& token,C&& cb):
+    state(token.state),callback(std::forward<C>(cb))
+  {
+    invoke=&stop_callback::call;
+    if(state && !state->try_add(this))
+      callback();
+  }
+
+  ~stop_callback()
+  {
+    if(state)
+      state->remove(this);
+  }
+
+  stop_callback(stop_callback const&)=delete;
+  stop_callback& operator=(stop_callback const&)=delete;
+};
+
+template<typename Callback>
+stop_callback(stop_token const&,Callback) -> stop_callback<Callback>;
+
+/**
+cv.wait(lk, pred)һֹͣʱҲ᷵أֵpred()Ľ
+lkס֪ͨcvǸrequest_stop()ڻص
+ԲҪڳʱrequest_stop()
+*/
+template<typename Lock,typename Predicate>
+bool interruptible_wait(std::condition_variable& cv,Lock& lk,stop_token const& token,Predicate pred)
+{
+  if(!token.state)
+  {
+    cv.wait(lk,pred);
+    return true;
+  }
+  auto* const mutex=lk.mutex();
+  auto wake=[&cv,mutex]
+  {
+    std::lock_guard<typename Lock::mutex_type> guard(*mutex);  // 2 ڵȴ߼־û˯ʱ֪ͨ
+    cv.notify_all();
+  };
+  struct waker: detail::stop_callback_base
+  {
+    decltype(wake)* f;
+    static void call(detail::stop_callback_base* base) { (*static_cast<waker*>(base)->f)(); }
+  } w;
+  w.invoke=&waker::call;
+  w.f=&wake;
+  if(!token.state->try_add(&w))  // Ѿֹͣڳlkʱִлص
+    return pred();
+  {
+    struct unlink_guard  // 3 pred()׳쳣ʱwҲҪrequest_stop()Ѿٵջ֡
+    {
+      Lock& lk;
+      detail::stop_state& state;
+      detail::stop_callback_base* cb;
+
+      ~unlink_guard()
+      {
+        lk.unlock();  // صڵȷſٳ
+        state.remove(cb);
+        lk.lock();
+      }
+    } const guard{lk,*token.state,&w};
+    cv.wait(lk,[&]{return pred() || token.stop_requested();});
+  }
+  return pred();  // ſڼֱˣ¼
+}
+
+#endif // STOP_TOKEN_H_INCLUDED
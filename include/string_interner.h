@@ -0,0 +1,190 @@
+#ifndef STRING_INTERNER_H_INCLUDED
+#define STRING_INTERNER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+/*
+Ķַ(ǩ)Էһstd::stringʱÿһ鵥Ķڴ棬
+ټڵ㣬Ŀַstring_internerÿַͬ
+ֻһΣһ32λıţ
+  ı:   ˳׷1MBĿÿַǰһֽڵĳ(DNS255ֽ)
+  ¼:   е{ϣֵ,λ}ÿ8ֽڣֿ䣻
+  ϣ: Ѱַ̽ı飬ÿ4ֽڣװӲ3/4
+Ŵ0ʼ䣬߿ñΪ±꣬ݰзԼ
+
+intern()find()ֻһдߵ(ɵ߼)ıͼ¼һдͲƶ
+õrelease/acquireı֮󣬲ҲԵoperator[]hash_of()
+ַܵɾֻstring_internerͷţҪʱɵ߰ѻҪ
+ַŽһµstring_interner(dns_compact_map::compact())
+*/
+
+class string_interner
+{
+public:
+  static constexpr std::uint32_t npos=0xffffffffu;
+  static constexpr std::size_t max_length=255;
+
+  static std::uint32_t hash(std::string_view s)
+  {
+    std::uint32_t h=2166136261u;  // FNV-1a
+    for(unsigned char c : s)
+    {
+      h^=c;
+      h*=16777619u;
+    }
+    return h;
+  }
+
+private:
+  struct record
+  {
+    std::uint32_t hash;
+    std::uint32_t location;  // <<block_bits | ƫ
+  };
+
+  static constexpr unsigned block_bits=20;
+  static constexpr std::size_t block_size=std::size_t(1)<<block_bits;
+  static constexpr std::size_t max_blocks=std::size_t(1)<<(32-block_bits);
+  static constexpr unsigned chunk_bits=16;
+  static constexpr std::size_t chunk_size=std::size_t(1)<<chunk_bits;
+  static constexpr std::size_t max_chunks=4096;
+
+  std::unique_ptr<char[]> blocks[max_blocks];
+  std::unique_ptr<record[]> chunks[max_chunks];
+  std::size_t block_count=0;
+  std::size_t block_used=block_size;
+  std::uint32_t count=0;
+  std::vector<std::uint32_t> table;  // ţղΪnposС2
+
+  record const& at(std::uint32_t id) const
+  {
+    return chunks[id>>chunk_bits][id&(chunk_size-1)];
+  }
+
+  char const* text(std::uint32_t location) const
+  {
+    return blocks[location>>block_bits].get()+(location&(block_size-1));
+  }
+
+  /**sڵĲۣûʱӦ÷sĿղ*/
+  std::size_t slot(std::string_view s,std::uint32_t h) const
+  {
+    std::size_t const mask=table.size()-1;
+    for(std::size_t i=h&mask;;i=(i+1)&mask)
+    {
+      std::uint32_t const id=table[i];
+      if(id==npos || (at(id).hash==h && (*this)[id]==s))
+        return i;
+    }
+  }
+
+  void grow()
+  {
+    std::vector<std::uint32_t> bigger(table.size()*2,npos);
+    std::size_t const mask=bigger.size()-1;
+    for(std::uint32_t id : table)
+    {
+      if(id==npos)
+        continue;
+      std::size_t i=at(id).hash&mask;  // 1 ¼йϣֵ¼
+      while(bigger[i]!=npos)
+        i=(i+1)&mask;
+      bigger[i]=id;
+    }
+    table.swap(bigger);
+  }
+
+  std::uint32_t store_text(std::string_view s)
+  {
+    if(block_used+1+s.size()>block_size)
+    {
+      if(block_count==max_blocks)
+        throw std::length_error("string_interner: out of text blocks");
+      blocks[block_count++].reset(new char[block_size]);
+      block_used=0;
+    }
+    char* const p=blocks[block_count-1].get()+block_used;
+    p[0]=char(static_cast<unsigned char>(s.size()));
+    std::memcpy(p+1,s.data(),s.size());
+    std::uint32_t const location=std::uint32_t((block_count-1)<<block_bits | block_used);
+    block_used+=1+s.size();
+    return location;
+  }
+
+public:
+  string_interner(): table(16,npos)
+  {}
+
+  string_interner(string_interner const&)=delete;
+  string_interner& operator=(string_interner const&)=delete;
+
+  /**ҵ½sı*/
+  std::uint32_t intern(std::string_view s)
+  {
+    if(s.size()>max_length)
+      throw std::length_error("string_interner: string too long");
+    std::uint32_t const h=hash(s);
+    std::size_t i=slot(s,h);
+    if(table[i]!=npos)
+      return table[i];
+    std::size_t const c=count>>chunk_bits;
+    if(c>=max_chunks)
+      throw std::length_error("string_interner: too many strings");
+    if(!chunks[c])
+      chunks[c].reset(new record[chunk_size]);
+    chunks[c][count&(chunk_size-1)]=record{h,store_text(s)};
+    if((std::size_t(count)+1)*4>table.size()*3)
+    {
+      grow();
+      i=slot(s,h);
+    }
+    table[i]=count;
+    return count++;
+  }
+
+  /**sıţûʱnpos*/
+  std::uint32_t find(std::string_view s) const
+  {
+    if(s.size()>max_length)
+      return npos;
+    return table[slot(s,hash(s))];
+  }
+
+  std::string_view operator[](std::uint32_t id) const
+  {
+    char const* const p=text(at(id).location);
+    return std::string_view(p+1,static_cast<unsigned char>(p[0]));
+  }
+
+  std::uint32_t hash_of(std::uint32_t id) const
+  {
+    return at(id).hash;
+  }
+
+  std::size_t size() const
+  {
+    return count;
+  }
+
+  /**idռõֽıͳֽڡһ¼һϣ*/
+  std::size_t bytes_of(std::uint32_t id) const
+  {
+    return 1+(*this)[id].size()+sizeof(record)+sizeof(std::uint32_t);
+  }
+
+  /**ѷı顢¼͹ϣֽ϶*/
+  std::size_t bytes() const
+  {
+    std::size_t const used_chunks=(std::size_t(count)+chunk_size-1)>>chunk_bits;
+    return sizeof(*this)+block_count*block_size+used_chunks*chunk_size*sizeof(record)+
+           table.capacity()*sizeof(std::uint32_t);
+  }
+};
+
+#endif // STRING_INTERNER_H_INCLUDED
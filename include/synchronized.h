@@ -0,0 +1,163 @@
+#ifndef SYNCHRONIZED_H_INCLUDED
+#define SYNCHRONIZED_H_INCLUDED
+
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/*
+data_wrapper::process_data()some_data&⺯malicious_function()ܰѵַ
+ʹãֻķҲҪռsynchronized<T,Mutex>ݺͻ
+һֻṩַʷʽ
+  with_lock(f)/with_rlock(f): ڵffķֵûָ룬ֵֻܰ
+  wlock()/rlock(): زɸƵlocked_ptrͳжã
+                   ͨݵĴ붼ڣ
+  acquire_locked(a,b): ַĹ̶˳ͬʱס󣬲Ϊ˳෴
+Mutexlock_shared()ʱ(std::shared_mutexdistributed_shared_mutex)rlock()with_rlock()
+ȡֻ߿ͬʱУ˻Ϊռ
+
+C++ûֹfذô浽𴦣ֻ÷Ҫá
+*/
+
+namespace detail
+{
+  template<typename Mutex,typename=void>
+  struct is_shared_lockable: std::false_type
+  {};
+
+  template<typename Mutex>
+  struct is_shared_lockable<Mutex,std::void_t<decltype(std::declval<Mutex&>().lock_shared()),
+                                              decltype(std::declval<Mutex&>().unlock_shared())>>: std::true_type
+  {};
+}
+
+/**ָ룬unlock()ʱͷ*/
+template<typename T,typename Lock>
+class locked_ptr
+{
+  T* data;
+  Lock lk;
+
+public:
+  locked_ptr(T& data_,Lock lk_): data(&data_),lk(std::move(lk_)) {}
+
+  locked_ptr(locked_ptr&& other) noexcept: data(other.data),lk(std::move(other.lk))
+  {
+    other.data=nullptr;
+  }
+
+  locked_ptr& operator=(locked_ptr&& other) noexcept
+  {
+    data=other.data;
+    lk=std::move(other.lk);
+    other.data=nullptr;
+    return *this;
+  }
+
+  locked_ptr(locked_ptr const&)=delete;
+  locked_ptr& operator=(locked_ptr const&)=delete;
+
+  T* operator->() const { return data; }
+  T& operator*() const { return *data; }
+  explicit operator bool() const { return data!=nullptr; }
+
+  /**ǰͷ֮ٷ*/
+  void unlock()
+  {
+    data=nullptr;
+    lk.unlock();
+  }
+};
+
+template<typename T,typename Mutex=std::mutex>
+class synchronized
+{
+  static constexpr bool shared=detail::is_shared_lockable<Mutex>::value;
+
+  mutable Mutex m;
+  T data;
+
+  template<typename Function,typename Data>
+  static auto invoke_locked(Function& f,Data& d) -> decltype(f(d))
+  {
+    typedef decltype(f(d)) result;
+    static_assert(!std::is_reference<result>::value && !std::is_pointer<result>::value,
+                  "with_lock: returning a reference or pointer would let the protected data escape the lock");
+    return f(d);
+  }
+
+public:
+  typedef locked_ptr<T,std::unique_lock<Mutex>> write_ptr;
+  typedef locked_ptr<T const,typename std::conditional<shared,std::shared_lock<Mutex>,std::unique_lock<Mutex>>::type> read_ptr;
+
+  synchronized()=default;
+
+  template<typename... Args>
+  explicit synchronized(std::in_place_t,Args&&... args): data(std::forward<Args>(args)...) {}
+
+  explicit synchronized(T const& value): data(value) {}
+  explicit synchronized(T&& value): data(std::move(value)) {}
+
+  synchronized(synchronized const&)=delete;
+  synchronized& operator=(synchronized const&)=delete;
+
+  write_ptr wlock()
+  {
+    return write_ptr(data,std::unique_lock<Mutex>(m));
+  }
+
+  read_ptr rlock() const
+  {
+    return read_ptr(data,typename std::conditional<shared,std::shared_lock<Mutex>,std::unique_lock<Mutex>>::type(m));
+  }
+
+  /**ڶռڵf(T&)fĽ*/
+  template<typename Function>
+  auto with_lock(Function f) -> decltype(f(std::declval<T&>()))
+  {
+    std::lock_guard<Mutex> lk(m);
+    return invoke_locked(f,data);
+  }
+
+  /**ڶڵf(T const&)Mutexֹ֧ʱԺ߲*/
+  template<typename Function>
+  auto with_rlock(Function f) const -> decltype(f(std::declval<T const&>()))
+  {
+    read_ptr p=rlock();
+    return invoke_locked(f,*p);
+  }
+
+  /**ڶڸһ*/
+  T copy() const
+  {
+    return *rlock();
+  }
+};
+
+/**
+ͬʱռסabַСǸ̷ֱ߳acquire_locked(x,y)
+acquire_locked(y,x)Ҳabͬһʱ׳std::logic_error
+*/
+template<typename T1,typename M1,typename T2,typename M2>
+std::pair<typename synchronized<T1,M1>::write_ptr,typename synchronized<T2,M2>::write_ptr>
+acquire_locked(synchronized<T1,M1>& a,synchronized<T2,M2>& b)
+{
+  void const* const pa=&a;
+  void const* const pb=&b;
+  if(pa==pb)
+    throw std::logic_error("acquire_locked: the same object cannot be locked twice");
+  if(std::less<void const*>()(pb,pa))
+  {
+    auto lb=b.wlock();
+    auto la=a.wlock();
+    return {std::move(la),std::move(lb)};
+  }
+  auto la=a.wlock();
+  auto lb=b.wlock();
+  return {std::move(la),std::move(lb)};
+}
+
+#endif // SYNCHRONIZED_H_INCLUDED
@@ -0,0 +1,143 @@
+#ifndef THREAD_GROUP_H_INCLUDED
+#define THREAD_GROUP_H_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "stop_token.h"
+
+/*
+scoped_thread(2.3)thread_guard(2.1)ֻһ̡߳thread_groupһ
+̣߳һstop_source̺߳ĵһstop_token(std::jthread
+ͬ)ѭstop_requested()ʱinterruptible_wait()
+stop_and_join()ֹͣͬʱȴ̣߳join()ʱǰ߳
+סͳƣ󱨸ֹͣÿ߳˳ʱ䡣
+*/
+
+class thread_group
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  struct shutdown_report
+  {
+    clock::duration total{};  // request_stop()һ߳˳
+    std::vector<clock::duration> per_thread;  // create_thread()˳
+    std::size_t slowest=0;
+  };
+
+private:
+  stop_source source;
+  std::vector<std::thread> threads;
+  std::mutex m;
+  std::condition_variable exited_cond;
+  std::vector<clock::time_point> exit_times;
+  std::size_t running=0;
+  clock::time_point stop_time;
+
+  void on_exit(std::size_t index)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    exit_times[index]=clock::now();
+    if(--running==0)
+      exited_cond.notify_all();
+  }
+
+public:
+  thread_group() {}
+
+  ~thread_group()
+  {
+    stop_and_join();
+  }
+
+  thread_group(thread_group const&)=delete;
+  thread_group& operator=(thread_group const&)=delete;
+
+  /**f(stop_token, args...)ɵʱstop_tokenΪһ룬f(args...)*/
+  template<typename Function,typename... Args>
+  void create_thread(Function&& f,Args&&... args)
+  {
+    std::size_t index;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      index=exit_times.size();
+      exit_times.push_back(clock::time_point());
+      ++running;
+    }
+    auto body=[this,index,token=source.get_token(),func=std::forward<Function>(f),
+               params=std::make_tuple(std::forward<Args>(args)...)]() mutable
+    {
+      struct exit_guard  // ̺߳׳쳣ʱҲҪ¼˳
+      {
+        thread_group* group;
+        std::size_t index;
+        ~exit_guard() { group->on_exit(index); }
+      } guard{this,index};
+      if constexpr(std::is_invocable_v<decltype(func)&&,stop_token,Args...>)
+        std::apply(std::move(func),std::tuple_cat(std::make_tuple(token),std::move(params)));
+      else
+        std::apply(std::move(func),std::move(params));
+    };
+    try
+    {
+      threads.push_back(std::thread(std::move(body)));
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lk(m);
+      exit_times.pop_back();
+      --running;
+      throw;
+    }
+  }
+
+  stop_token get_token() const { return source.get_token(); }
+
+  void request_stop()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m);
+      if(!source.stop_requested())
+        stop_time=clock::now();
+    }
+    source.request_stop();
+  }
+
+  /**ֹͣ߳˳*/
+  shutdown_report stop_and_join()
+  {
+    request_stop();
+    shutdown_report report;
+    {
+      std::unique_lock<std::mutex> lk(m);
+      exited_cond.wait(lk,[this]{return running==0;});
+      report.per_thread.reserve(exit_times.size());
+      for(std::size_t i=0;i<exit_times.size();++i)
+      {
+        clock::duration const latency=exit_times[i]>stop_time ? exit_times[i]-stop_time : clock::duration::zero();
+        report.per_thread.push_back(latency);
+        if(latency>report.per_thread[report.slowest])
+          report.slowest=i;
+        if(latency>report.total)
+          report.total=latency;
+      }
+    }
+    for(auto& t : threads)
+      if(t.joinable())  // ߳Ѿ꣬join()ֻǻԴ
+        t.join();
+    return report;
+  }
+
+  std::size_t size() const { return threads.size(); }
+};
+
+#endif // THREAD_GROUP_H_INCLUDED
@@ -0,0 +1,235 @@
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+std::async(std::launch::async, ...)ͨÿεöᴴһ̣߳ǧ첽
+ͬʱʱ߳ԶԶCPU󲿷ʱ䶼ڴ̺߳лϣ
+std::launch::deferredȫûвСù̶Ĺ߳(ĬΪ
+std::thread::hardware_concurrency())ִasync_on()԰
+̳߳ءڵֱִ߳Уӳٵget()ʱִС
+*/
+
+/**ֻƶĿɵöװstd::functionҪɿŲstd::packaged_task*/
+class function_wrapper
+{
+  struct impl_base
+  {
+    virtual void call()=0;
+    virtual ~impl_base() {}
+  };
+
+  template<typename F>
+  struct impl_type: impl_base
+  {
+    F f;
+    impl_type(F&& f_): f(std::move(f_)) {}
+    void call() { f(); }
+  };
+
+  std::unique_ptr<impl_base> impl;
+public:
+  function_wrapper() = default;
+
+  template<typename F>
+  function_wrapper(F&& f):
+    impl(new impl_type<F>(std::move(f)))
+  {}
+
+  void operator()() { impl->call(); }
+
+  function_wrapper(function_wrapper&& other) noexcept:
+    impl(std::move(other.impl))
+  {}
+
+  function_wrapper& operator=(function_wrapper&& other) noexcept
+  {
+    impl=std::move(other.impl);
+    return *this;
+  }
+
+  function_wrapper(const function_wrapper&)=delete;
+  function_wrapper& operator=(const function_wrapper&)=delete;
+};
+
+/**̶̳߳߳أύ˳ִ*/
+class thread_pool
+{
+  mutable std::mutex mut;
+  std::condition_variable work_cond;
+  std::deque<function_wrapper> work_queue;
+  bool done;
+  std::atomic<std::size_t> queued;  // ύûʼִеҲܶ
+  std::size_t const saturation_limit;
+  std::vector<std::thread> threads;
+
+  void worker_thread()
+  {
+    for(;;)
+    {
+      function_wrapper task;
+      {
+        std::unique_lock<std::mutex> lk(mut);
+        work_cond.wait(lk,[this]{return done || !work_queue.empty();});
+        if(work_queue.empty())  // 1 ֻdoneҶѾʱ˳
+          return;
+        task=std::move(work_queue.front());
+        work_queue.pop_front();
+      }
+      queued.fetch_sub(1,std::memory_order_relaxed);
+      task();
+    }
+  }
+
+public:
+  static unsigned default_thread_count()
+  {
+    unsigned const hardware_threads=std::thread::hardware_concurrency();
+    return hardware_threads != 0 ? hardware_threads : 2;
+  }
+
+  /**saturation_limit_: Ŷﵽֵʱsaturated()trueĬΪ߳*/
+  explicit thread_pool(unsigned thread_count=default_thread_count(),
+                       std::size_t saturation_limit_=0):
+    done(false),queued(0),
+    saturation_limit(saturation_limit_ ? saturation_limit_ : thread_count)
+  {
+    threads.reserve(thread_count);
+    try
+    {
+      for(unsigned i=0;i<thread_count;++i)
+        threads.push_back(std::thread(&thread_pool::worker_thread,this));
+    }
+    catch(...)
+    {
+      shutdown();
+      throw;
+    }
+  }
+
+  ~thread_pool()
+  {
+    shutdown();
+  }
+
+  thread_pool(thread_pool const&)=delete;
+  thread_pool& operator=(thread_pool const&)=delete;
+
+  template<typename FunctionType>
+  std::future<std::invoke_result_t<FunctionType&>> submit(FunctionType f)
+  {
+    typedef std::invoke_result_t<FunctionType&> result_type;
+    std::packaged_task<result_type()> task(std::move(f));
+    std::future<result_type> res(task.get_future());
+    {
+      std::lock_guard<std::mutex> lk(mut);
+      work_queue.push_back(function_wrapper(std::move(task)));
+      queued.fetch_add(1,std::memory_order_relaxed);  // ӣȡ̼߳һʱһѾ
+    }
+    work_cond.notify_one();
+    return res;
+  }
+
+  /**ڵǰִ߳һŶӵ񣬵ȴ߳̿Խ˰æɻǸɵ*/
+  bool run_pending_task()
+  {
+    function_wrapper task;
+    {
+      std::lock_guard<std::mutex> lk(mut);
+      if(work_queue.empty())
+        return false;
+      task=std::move(work_queue.front());
+      work_queue.pop_front();
+    }
+    queued.fetch_sub(1,std::memory_order_relaxed);
+    task();
+    return true;
+  }
+
+  std::size_t pending() const
+  {
+    return queued.load(std::memory_order_relaxed);
+  }
+
+  bool saturated() const
+  {
+    return pending() >= saturation_limit;
+  }
+
+  unsigned size() const
+  {
+    return static_cast<unsigned>(threads.size());
+  }
+
+private:
+  void shutdown()
+  {
+    {
+      std::lock_guard<std::mutex> lk(mut);
+      done=true;
+    }
+    work_cond.notify_all();
+    for(auto& t : threads)
+      if(t.joinable())
+        t.join();
+  }
+};
+
+/*
+ԣ
+pool                 ǽִ̳߳
+inline_if_saturated  ̳߳ػѹ񳬹saturation_limitʱֱڵִ߳У
+                     صfutureѾȲöҲڳ
+                     еȴʱй̶߳ռ
+deferred             ͬstd::launch::deferredfuturewait()get()ʱִ
+*/
+enum class launch_policy
+{
+  pool,
+  inline_if_saturated,
+  deferred
+};
+
+/**std::asyncͬ(ֳֵ֧Աָstd::ref)ֻexecutorִ*/
+template<typename Executor,typename Function,typename... Args>
+std::future<std::invoke_result_t<std::decay_t<Function>,std::decay_t<Args>...>>
+async_on(Executor& executor,launch_policy policy,Function&& f,Args&&... args)
+{
+  typedef std::invoke_result_t<std::decay_t<Function>,std::decay_t<Args>...> result_type;
+  auto bound=[func=std::forward<Function>(f),
+              params=std::make_tuple(std::forward<Args>(args)...)]() mutable -> result_type
+  {
+    return std::apply(std::move(func),std::move(params));
+  };
+
+  switch(policy)
+  {
+  case launch_policy::deferred:
+    return std::async(std::launch::deferred,std::move(bound));
+  case launch_policy::inline_if_saturated:
+    if(executor.saturated())
+    {
+      std::packaged_task<result_type()> task(std::move(bound));
+      std::future<result_type> res(task.get_future());
+      task();  // 쳣ᱣfutureУ뽻̳߳ʱΪһ
+      return res;
+    }
+    break;
+  case launch_policy::pool:
+    break;
+  }
+  return executor.submit(std::move(bound));
+}
+
+#endif // THREAD_POOL_H_INCLUDED
@@ -0,0 +1,205 @@
+#ifndef THREADSAFE_PRIORITY_QUEUE_H_INCLUDED
+#define THREADSAFE_PRIORITY_QUEUE_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "per_thread.h"  // detail::thread_random()
+
+/*
+threadsafe_queueϸȽȳҪȴʱֻ
+std::priority_queueֻصһȫthreadsafe_priority_queue<T,Compare>
+һɳڵĶ(MultiQueue)ڲkԴĶѣ
+  push():  ѡһѷŽȥס˾ͻһ(try_lock)ζʧܲĳһϣ
+  pop:     ѡѣstd::lockͬʱסȽ϶Ѷȡŵһ("ѡ")
+           ѶΪʱһѡkζΪղҡ
+ӿthreadsafe_queueͬ(push/wait_and_pop/try_pop)Compareĺstd::priority_queue
+ͬCompare(a,b)Ϊtrueʾaȼbֹʱʱstd::greater
+
+˳ǽƵģȡԪزһȫŵġѡʱȡԪȫԪе
+(ǰ滹жٸŵԪ)ΪO(k)ԺܸߵĸʲO(k log k)Ԫظ
+߳޹ءҪÿζȽѣpopʹھʱҲ
+ֻtry_lockһֻڶмȡʱʱȡĲһʣ
+Ԫŵġk=1ʱ˻ΪϸȶСĬkΪӲ߳
+
+Ԫظtry_pop()ȴӼԤһԪȥңֻҪpush()Ѿأ
+try_pop()ͲԪشʱfalse
+*/
+
+template<typename T,typename Compare=std::less<T>>
+class threadsafe_priority_queue
+{
+  struct alignas(64) sub_heap
+  {
+    std::mutex m;
+    std::vector<T> heap;  // std::push_heap/pop_heapάfront()ŵԪ
+  };
+
+  std::unique_ptr<sub_heap[]> heaps;
+  std::size_t const heap_count;
+  Compare comp;
+  alignas(64) std::atomic<std::size_t> count{0};  // ѾŽѡûбԤԪظ
+  std::atomic<unsigned> sleepers{0};
+  std::mutex wait_mutex;
+  std::condition_variable wait_cond;
+
+  sub_heap& random_heap()
+  {
+    return heaps[detail::thread_random()%heap_count];
+  }
+
+  void insert(T&& value)
+  {
+    for(unsigned attempt=0;attempt<4;++attempt)
+    {
+      sub_heap& h=random_heap();
+      std::unique_lock<std::mutex> lk(h.m,std::try_to_lock);
+      if(lk.owns_lock())
+      {
+        push_locked(h,std::move(value));
+        return;
+      }
+    }
+    sub_heap& h=random_heap();
+    std::lock_guard<std::mutex> lk(h.m);
+    push_locked(h,std::move(value));
+  }
+
+  void push_locked(sub_heap& h,T&& value)
+  {
+    h.heap.push_back(std::move(value));
+    std::push_heap(h.heap.begin(),h.heap.end(),comp);
+  }
+
+  T pop_locked(sub_heap& h)
+  {
+    std::pop_heap(h.heap.begin(),h.heap.end(),comp);
+    T value(std::move(h.heap.back()));
+    h.heap.pop_back();
+    return value;
+  }
+
+  /**ӼԤһԪأΪ0ʱfalse*/
+  bool reserve()
+  {
+    std::size_t n=count.load(std::memory_order_relaxed);
+    while(n && !count.compare_exchange_weak(n,n-1,std::memory_order_relaxed))
+      ;
+    return n!=0;
+  }
+
+  /**ȡһѾԤԪأһĳ*/
+  T take()
+  {
+    if(heap_count>1)
+    {
+      for(std::size_t attempt=0;attempt<heap_count;++attempt)  // ѶΪʱһѡ
+      {
+        std::uint64_t const r=detail::thread_random();
+        std::size_t const i=r%heap_count;
+        std::size_t const j=(i+1+(r>>32)%(heap_count-1))%heap_count;  // 1 iͬһ
+        std::unique_lock<std::mutex> first(heaps[i].m,std::defer_lock);
+        std::unique_lock<std::mutex> second(heaps[j].m,std::defer_lock);
+        std::lock(first,second);  // 2 ʱҲȽѣֻһʱûϽ
+        sub_heap* best=heaps[i].heap.empty() ? nullptr : &heaps[i];
+        if(!heaps[j].heap.empty() && (!best || comp(best->heap.front(),heaps[j].heap.front())))
+          best=&heaps[j];
+        if(best)
+          return pop_locked(*best);
+      }
+    }
+    for(std::size_t start=detail::thread_random();;++start)  // 3 ѡĶǿնѣѾˣ
+    {
+      sub_heap& h=heaps[start%heap_count];
+      std::lock_guard<std::mutex> lk(h.m);
+      if(!h.heap.empty())
+        return pop_locked(h);
+    }
+  }
+
+public:
+  static std::size_t default_queue_count()
+  {
+    unsigned const hardware_threads=std::thread::hardware_concurrency();
+    return hardware_threads!=0 ? 2*hardware_threads : 4;
+  }
+
+  explicit threadsafe_priority_queue(std::size_t queues=default_queue_count(),Compare comp_=Compare()):
+    heaps(new sub_heap[queues ? queues : 1]),heap_count(queues ? queues : 1),comp(std::move(comp_))
+  {}
+
+  threadsafe_priority_queue(threadsafe_priority_queue const&)=delete;
+  threadsafe_priority_queue& operator=(threadsafe_priority_queue const&)=delete;
+
+  void push(T new_value)
+  {
+    insert(std::move(new_value));
+    count.fetch_add(1,std::memory_order_seq_cst);  // 4 ȷŽټwait_and_pop()е5
+    if(sleepers.load(std::memory_order_seq_cst))
+    {
+      std::lock_guard<std::mutex> lk(wait_mutex);
+      wait_cond.notify_one();
+    }
+  }
+
+  void wait_and_pop(T& value)
+  {
+    while(!reserve())
+    {
+      std::unique_lock<std::mutex> lk(wait_mutex);
+      sleepers.fetch_add(1,std::memory_order_seq_cst);  // 5 ȵǼټpush()©֪ͨ
+      wait_cond.wait(lk,[this]{return count.load(std::memory_order_seq_cst)!=0;});
+      sleepers.fetch_sub(1,std::memory_order_relaxed);
+    }
+    value=take();
+  }
+
+  std::shared_ptr<T> wait_and_pop()
+  {
+    T value;
+    wait_and_pop(value);
+    return std::make_shared<T>(std::move(value));
+  }
+
+  bool try_pop(T& value)
+  {
+    if(!reserve())
+      return false;
+    value=take();
+    return true;
+  }
+
+  std::shared_ptr<T> try_pop()
+  {
+    if(!reserve())
+      return std::shared_ptr<T>();
+    return std::make_shared<T>(take());
+  }
+
+  /**޸ʱֻǽֵ*/
+  std::size_t size() const
+  {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  bool empty() const
+  {
+    return size()==0;
+  }
+
+  std::size_t queue_count() const
+  {
+    return heap_count;
+  }
+};
+
+#endif // THREADSAFE_PRIORITY_QUEUE_H_INCLUDED
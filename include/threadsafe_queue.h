@@ -0,0 +1,170 @@
+#ifndef THREADSAFE_QUEUE_H_INCLUDED
+#define THREADSAFE_QUEUE_H_INCLUDED
+
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <utility>
+
+#include "container_policies.h"
+
+/*
+4.5 ̰߳ȫСOptionscontainer_policies.hеĲԣĬͬstd::mutex
+std::dequeÿpush()notify_one()std::shared_ptr<T>
+capacity<N>ʱpush()ڶʱȴtry_push()falsenotify_noneʱûwait_and_pop*()
+*/
+
+template<typename T,typename... Options>
+class threadsafe_queue
+{
+  typedef detail::container_policies<policy::notify_always,Options...> policies;
+public:
+  typedef typename policies::lock_type mutex_type;
+  typedef detail::result_type<typename policies::result,T> result_type;
+  static constexpr std::size_t capacity=policies::capacity;
+private:
+  mutable mutex_type mut;  // 1 ǿɱ
+  std::queue<T,typename policies::template storage_type<T>> data_queue;
+  detail::waiters<typename policies::notify,mutex_type> data_cond;
+  detail::waiters<std::conditional_t<capacity!=0,typename policies::notify,policy::notify_none>,mutex_type> space_cond;  // ֻнвŵȴλ
+
+  void push_locked(T&& new_value)
+  {
+    data_queue.push(std::move(new_value));
+    data_cond.notify_one();
+  }
+
+  void pop_locked()
+  {
+    data_queue.pop();
+    space_cond.notify_one();
+  }
+public:
+  threadsafe_queue()
+  {}
+  threadsafe_queue(threadsafe_queue const& other)
+  {
+    //ֵʱֹڿֵ
+    std::lock_guard<mutex_type> lk(other.mut);
+    data_queue=other.data_queue;
+  }
+
+  void push(T new_value)
+  {
+    std::unique_lock<mutex_type> lk(mut);
+    if constexpr(capacity!=0)
+    {
+      static_assert(policies::notifies,"a bounded queue without notification can only try_push()");
+      space_cond.wait(lk,[this]{return data_queue.size()<capacity;});
+    }
+    push_locked(std::move(new_value));
+  }
+
+  /**нʱfalse*/
+  bool try_push(T new_value)
+  {
+    std::lock_guard<mutex_type> lk(mut);
+    if constexpr(capacity!=0)
+      if(data_queue.size()>=capacity)
+        return false;
+    push_locked(std::move(new_value));
+    return true;
+  }
+
+  void wait_and_pop(T& value)
+  {
+    static_assert(policies::notifies,"wait_and_pop() needs a notification policy");
+    std::unique_lock<mutex_type> lk(mut);
+    data_cond.wait(lk,[this]{return !data_queue.empty();});
+    value=std::move(data_queue.front());
+    pop_locked();
+  }
+
+  result_type wait_and_pop()
+  {
+    static_assert(policies::notifies,"wait_and_pop() needs a notification policy");
+    std::unique_lock<mutex_type> lk(mut);
+    data_cond.wait(lk,[this]{return !data_queue.empty();});
+    result_type res(detail::make_result<typename policies::result,T>(std::move_if_noexcept(data_queue.front())));
+    pop_locked();
+    return res;
+  }
+
+  /**ȴtimeoutʱfalse*/
+  template<typename Rep,typename Period>
+  bool wait_and_pop_for(T& value,std::chrono::duration<Rep,Period> timeout)
+  {
+    static_assert(policies::notifies,"wait_and_pop_for() needs a notification policy");
+    std::unique_lock<mutex_type> lk(mut);
+    if(!data_cond.wait_for(lk,timeout,[this]{return !data_queue.empty();}))
+      return false;
+    value=std::move(data_queue.front());
+    pop_locked();
+    return true;
+  }
+
+  /**ͬϣʱtimers(timer_wheel.hеtimer_service)ͳһȴʱ*/
+  template<typename Rep,typename Period,typename Timers>
+  bool wait_and_pop_for(T& value,std::chrono::duration<Rep,Period> timeout,Timers& timers)
+  {
+    static_assert(policies::notifies,"wait_and_pop_for() needs a notification policy");
+    bool timed_out=false;
+    auto const h=timers.arm_after(
+      std::chrono::duration_cast<typename Timers::duration>(timeout),
+      [this,&timed_out]
+      {
+        std::lock_guard<mutex_type> lk(mut);
+        timed_out=true;
+        data_cond.notify_all();  // ֪ĸȴ߳ʱˣȫ¼
+      });
+    bool popped=false;
+    {
+      std::unique_lock<mutex_type> lk(mut);
+      data_cond.wait(lk,[&]{return timed_out || !data_queue.empty();});
+      if(!data_queue.empty())
+      {
+        value=std::move(data_queue.front());
+        pop_locked();
+        popped=true;
+      }
+    }
+    timers.cancel(h);  // صִʱ֮timed_outſ
+    return popped;
+  }
+
+  bool try_pop(T& value)
+  {
+    std::lock_guard<mutex_type> lk(mut);
+    if(data_queue.empty())
+      return false;
+    value=std::move(data_queue.front());
+    pop_locked();
+    return true;
+  }
+
+  result_type try_pop()
+  {
+    std::lock_guard<mutex_type> lk(mut);
+    if(data_queue.empty())
+      return result_type();
+    result_type res(detail::make_result<typename policies::result,T>(std::move_if_noexcept(data_queue.front())));
+    pop_locked();
+    return res;
+  }
+
+  bool empty() const
+  {
+    std::lock_guard<mutex_type> lk(mut);
+    return data_queue.empty();
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<mutex_type> lk(mut);
+    return data_queue.size();
+  }
+};
+
+#endif // THREADSAFE_QUEUE_H_INCLUDED
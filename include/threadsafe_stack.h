@@ -0,0 +1,138 @@
+#ifndef THREADSAFE_STACK_H_INCLUDED
+#define THREADSAFE_STACK_H_INCLUDED
+
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stack>
+#include <utility>
+
+#include "container_policies.h"
+
+/*
+3.5 ̰߳ȫĶջ3.2ȡʾͻ׼ʹá
+pop()top()pop()ϲһӿڱջΪʱ׳empty_stack
+֪ͨpop()ķͿòԲãcontainer_policies.h
+*/
+
+struct empty_stack: std::exception
+{
+  const char* what() const throw() {
+	return "empty stack!";
+  };
+};
+
+struct full_stack: std::exception
+{
+  const char* what() const throw() {
+	return "full stack!";
+  };
+};
+
+/**
+̰߳ȫջOptionscontainer_policies.hеĲԣĬΪstd::mutexstd::deque
+ûpop()std::shared_ptr<T>Ϊ˼ݣthreadsafe_stack<T,Mutex>еMutex
+(instrumented_mutex<>LockableҪ)ͬpolicy::lock<Mutex>
+capacity<N>ʱջʱpush()׳full_stacktry_push()falsenotify_always
+notify_waitersʱwait_and_pop()
+*/
+template<typename T,typename... Options>
+class threadsafe_stack
+{
+  typedef detail::container_policies<policy::notify_none,Options...> policies;
+public:
+  typedef typename policies::lock_type mutex_type;
+  typedef detail::result_type<typename policies::result,T> result_type;
+  static constexpr std::size_t capacity=policies::capacity;
+private:
+  std::stack<T,typename policies::template storage_type<T>> data;
+  mutable mutex_type m;
+  detail::waiters<typename policies::notify,mutex_type> data_cond;
+
+  bool full() const
+  {
+    if constexpr(capacity!=0)
+      return data.size()>=capacity;
+    else
+      return false;
+  }
+
+  result_type pop_top()
+  {
+    result_type res(detail::make_result<typename policies::result,T>(std::move_if_noexcept(data.top())));  // ޸Ķջǰֵ
+    data.pop();
+    return res;
+  }
+
+public:
+  threadsafe_stack(){}
+
+  threadsafe_stack(const threadsafe_stack& other)
+  {
+    std::lock_guard<mutex_type> lock(other.m);
+    data = other.data; // 1 ڹ캯еִп
+  }
+
+  threadsafe_stack& operator=(const threadsafe_stack&) = delete;
+
+  void push(T new_value)
+  {
+    std::lock_guard<mutex_type> lock(m);
+    if(full()) throw full_stack();
+    data.push(std::move(new_value));
+    data_cond.notify_one();
+  }
+
+  /**нջʱfalse*/
+  bool try_push(T new_value)
+  {
+    std::lock_guard<mutex_type> lock(m);
+    if(full())
+      return false;
+    data.push(std::move(new_value));
+    data_cond.notify_one();
+    return true;
+  }
+
+  result_type pop()
+  {
+    std::lock_guard<mutex_type> lock(m);
+    if(data.empty()) throw empty_stack(); // ڵpopǰջǷΪ
+    return pop_top();
+  }
+
+  void pop(T& value)
+  {
+    std::lock_guard<mutex_type> lock(m);
+    if(data.empty()) throw empty_stack();
+
+    value=std::move(data.top());
+    data.pop();
+  }
+
+  /**ջΪʱȴҪ֪ͨ*/
+  result_type wait_and_pop()
+  {
+    static_assert(policies::notifies,"wait_and_pop() needs policy::notify_always or policy::notify_waiters");
+    std::unique_lock<mutex_type> lock(m);
+    data_cond.wait(lock,[this]{return !data.empty();});
+    return pop_top();
+  }
+
+  void wait_and_pop(T& value)
+  {
+    static_assert(policies::notifies,"wait_and_pop() needs policy::notify_always or policy::notify_waiters");
+    std::unique_lock<mutex_type> lock(m);
+    data_cond.wait(lock,[this]{return !data.empty();});
+    value=std::move(data.top());
+    data.pop();
+  }
+
+  bool empty() const
+  {
+    std::lock_guard<mutex_type> lock(m);
+    return data.empty();
+  }
+};
+
+#endif // THREADSAFE_STACK_H_INCLUDED
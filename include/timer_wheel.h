@@ -0,0 +1,429 @@
+#ifndef TIMER_WHEEL_H_INCLUDED
+#define TIMER_WHEEL_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "pending_table.h"  // request_timeout
+
+/*
+4.3ڵwait_for(35ms)ÿζһʱȴʮԴŽֹʱʱ
+ÿȴҪںһʱѽֹʱ伯еһֲʱϣ
+0256ۣÿһtick1~364ۣÿ۷ֱ𸲸2^82^142^20tick
+ʱʱֱ䵽ĳһĳӺȡO(1)(˫)
+ͲתһȦʱһӦĶʱ·䵽棬ͬһtickڵĶʱ
+һλȫ2^26tickĶʱȷ߲㣬ʱ·䡣
+
+timer_wheeḷ߳advance(now)ƽԿüʱ
+timer_serviceרŵ߳ʵʱƽһtimer_wheel
+صӵִ֮Уcancel()֮صִ֤(ִʱ)
+*/
+
+template<typename Clock=std::chrono::steady_clock>
+class timer_wheel
+{
+public:
+  typedef typename Clock::time_point time_point;
+  typedef typename Clock::duration duration;
+  typedef std::function<void()> callback;
+
+  struct handle
+  {
+    std::uint32_t index=~0u;
+    std::uint32_t generation=0;
+  };
+
+private:
+  static constexpr unsigned root_bits=8;
+  static constexpr unsigned level_bits=6;
+  static constexpr unsigned levels=4;
+  static constexpr std::uint32_t root_size=1u<<root_bits;
+  static constexpr std::uint32_t level_size=1u<<level_bits;
+  static constexpr std::uint64_t max_delta=(std::uint64_t(1)<<(root_bits+(levels-1)*level_bits))-1;
+  static constexpr std::uint32_t nil=~0u;
+
+  enum class node_state: unsigned char { free, armed, firing };
+
+  struct node
+  {
+    std::uint64_t expiry;
+    std::uint32_t prev;
+    std::uint32_t next;
+    std::uint32_t slot;
+    std::uint32_t generation;
+    node_state state;
+    callback cb;
+  };
+
+  std::mutex m;
+  std::condition_variable fired_cond;
+  std::vector<node> nodes;  // ±껥ӣʱʧЧ
+  std::uint32_t free_head;
+  std::vector<std::uint32_t> slots;  // root_size+(levels-1)*level_sizeͷ
+  std::uint64_t current;  // һҪtick
+  std::size_t armed_count;
+  std::thread::id firing_thread;
+  time_point const origin;
+  duration const resolution;
+
+  std::uint64_t to_tick(time_point t) const  // ȡʱǰ
+  {
+    if(t<=origin)
+      return 0;
+    auto const d=t-origin;
+    return static_cast<std::uint64_t>((d+resolution-duration(1))/resolution);
+  }
+
+  std::uint32_t slot_for(std::uint64_t expiry) const
+  {
+    std::uint64_t const when=expiry<current ? current : expiry;
+    std::uint64_t delta=when-current;
+    std::uint64_t e=when;
+    if(delta>max_delta)  // ߲ķΧȷԶλ
+    {
+      delta=max_delta;
+      e=current+max_delta;
+    }
+    if(delta<root_size)
+      return static_cast<std::uint32_t>(e&(root_size-1));
+    unsigned shift=root_bits;
+    for(unsigned level=1;level<levels;++level,shift+=level_bits)
+    {
+      if(delta<(std::uint64_t(1)<<(shift+level_bits)) || level==levels-1)
+        return root_size+(level-1)*level_size+static_cast<std::uint32_t>((e>>shift)&(level_size-1));
+    }
+    return 0;  // ᵽ
+  }
+
+  void link(std::uint32_t i)
+  {
+    node& n=nodes[i];
+    n.slot=slot_for(n.expiry);
+    n.prev=nil;
+    n.next=slots[n.slot];
+    if(n.next!=nil)
+      nodes[n.next].prev=i;
+    slots[n.slot]=i;
+  }
+
+  void unlink(std::uint32_t i)
+  {
+    node& n=nodes[i];
+    if(n.prev!=nil)
+      nodes[n.prev].next=n.next;
+    else
+      slots[n.slot]=n.next;
+    if(n.next!=nil)
+      nodes[n.next].prev=n.prev;
+  }
+
+  void release(std::uint32_t i)
+  {
+    node& n=nodes[i];
+    n.state=node_state::free;
+    n.cb=nullptr;
+    ++n.generation;  // ɵhandleӴʧЧ
+    n.next=free_head;
+    free_head=i;
+  }
+
+  /**ϲһĶʱ·䣬ظòĲۺţΪ0˵һҲתһȦ*/
+  std::uint32_t cascade(unsigned level,unsigned shift)
+  {
+    std::uint32_t const index=static_cast<std::uint32_t>((current>>shift)&(level_size-1));
+    std::uint32_t& head=slots[root_size+(level-1)*level_size+index];
+    std::uint32_t i=head;
+    head=nil;
+    while(i!=nil)
+    {
+      std::uint32_t const next=nodes[i].next;
+      link(i);
+      i=next;
+    }
+    return index;
+  }
+
+  void collect_expired(std::vector<std::uint32_t>& expired)
+  {
+    if((current&(root_size-1))==0 && current)
+    {
+      unsigned shift=root_bits;
+      for(unsigned level=1;level<levels;++level,shift+=level_bits)
+        if(cascade(level,shift)!=0)
+          break;
+    }
+    std::uint32_t& head=slots[current&(root_size-1)];
+    std::uint32_t i=head;
+    head=nil;
+    while(i!=nil)
+    {
+      std::uint32_t const next=nodes[i].next;
+      if(nodes[i].expiry<=current)
+      {
+        nodes[i].state=node_state::firing;
+        --armed_count;
+        expired.push_back(i);
+      }
+      else
+        link(i);  // Ӧ÷·Ż
+      i=next;
+    }
+  }
+
+public:
+  /**resolutionһtickĳȣͬһtickڵڵĶʱһ𴥷*/
+  explicit timer_wheel(duration resolution_=std::chrono::milliseconds(1),
+                       time_point origin_=Clock::now()):
+    free_head(nil),slots(root_size+(levels-1)*level_size,nil),
+    current(0),armed_count(0),origin(origin_),resolution(resolution_)
+  {}
+
+  timer_wheel(timer_wheel const&)=delete;
+  timer_wheel& operator=(timer_wheel const&)=delete;
+
+  handle arm(time_point deadline,callback cb)
+  {
+    std::lock_guard<std::mutex> lk(m);
+    std::uint32_t i=free_head;
+    if(i==nil)
+    {
+      i=static_cast<std::uint32_t>(nodes.size());
+      nodes.emplace_back();
+      nodes.back().generation=0;
+    }
+    else
+      free_head=nodes[i].next;
+    node& n=nodes[i];
+    n.expiry=to_tick(deadline);
+    n.state=node_state::armed;
+    n.cb=std::move(cb);
+    link(i);
+    ++armed_count;
+    return handle{i,n.generation};
+  }
+
+  handle arm_after(duration timeout,callback cb)
+  {
+    return arm(Clock::now()+timeout,std::move(cb));
+  }
+
+  /**ʱûұȡʱtrue߳ϴʱȻصٷfalse*/
+  bool cancel(handle h)
+  {
+    std::unique_lock<std::mutex> lk(m);
+    if(h.index>=nodes.size() || nodes[h.index].generation!=h.generation)
+      return false;
+    node& n=nodes[h.index];
+    if(n.state==node_state::armed)
+    {
+      unlink(h.index);
+      --armed_count;
+      release(h.index);
+      return true;
+    }
+    if(firing_thread!=std::this_thread::get_id())  // ԼĻصȡԼʱܵ
+      fired_cond.wait(lk,[&]{return nodes[h.index].generation!=h.generation;});
+    return false;
+  }
+
+  /**now֮ǰڵĶʱشĸ*/
+  std::size_t advance(time_point now)
+  {
+    std::vector<std::uint32_t> expired;
+    std::unique_lock<std::mutex> lk(m);
+    std::uint64_t const target=now<origin ? 0 : static_cast<std::uint64_t>((now-origin)/resolution);
+    while(current<=target)
+    {
+      if(!armed_count)  // ǿյģֱмtick
+      {
+        current=target+1;
+        break;
+      }
+      collect_expired(expired);
+      ++current;
+    }
+    firing_thread=std::this_thread::get_id();
+    for(std::uint32_t i : expired)
+    {
+      callback cb=std::move(nodes[i].cb);
+      lk.unlock();
+      cb();
+      lk.lock();
+      release(i);
+      fired_cond.notify_all();
+    }
+    firing_thread=std::thread::id();
+    return expired.size();
+  }
+
+  /**жʱ(Ҫ·ϲ㶨ʱ)ʱ㣬ûжʱʱtime_point::max()*/
+  time_point next_expiry()
+  {
+    std::lock_guard<std::mutex> lk(m);
+    if(!armed_count)
+      return time_point::max();
+    std::uint64_t tick=(current|(root_size-1))+1;  // 0תһȦλ
+    for(std::uint64_t t=current;t<tick;++t)
+    {
+      if(slots[t&(root_size-1)]!=nil)
+      {
+        tick=t;
+        break;
+      }
+    }
+    return origin+resolution*static_cast<typename duration::rep>(tick);
+  }
+
+  std::size_t size()
+  {
+    std::lock_guard<std::mutex> lk(m);
+    return armed_count;
+  }
+};
+
+/**רŵ߳ƽʱֻ֣Ķʱʱ*/
+template<typename Clock=std::chrono::steady_clock>
+class timer_service
+{
+public:
+  typedef typename timer_wheel<Clock>::time_point time_point;
+  typedef typename timer_wheel<Clock>::duration duration;
+  typedef typename timer_wheel<Clock>::callback callback;
+  typedef typename timer_wheel<Clock>::handle handle;
+
+private:
+  timer_wheel<Clock> wheel;
+  std::mutex m;
+  std::condition_variable cond;
+  bool done;
+  time_point wake_at;
+  std::atomic<std::size_t> wakeups;
+  std::thread thread;
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lk(m);
+    while(!done)
+    {
+      wake_at=wheel.next_expiry();  // mʱ㣬֮arm()Ķʱ߳̽
+      if(wake_at==time_point::max())
+        cond.wait(lk);
+      else
+        cond.wait_until(lk,wake_at);
+      if(done)
+        break;
+      lk.unlock();
+      wheel.advance(Clock::now());
+      wakeups.fetch_add(1,std::memory_order_relaxed);
+      lk.lock();
+    }
+  }
+
+public:
+  explicit timer_service(duration resolution=std::chrono::milliseconds(1)):
+    wheel(resolution),done(false),wake_at(time_point::max()),wakeups(0),
+    thread(&timer_service::run,this)
+  {}
+
+  ~timer_service()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m);
+      done=true;
+    }
+    cond.notify_one();
+    thread.join();
+  }
+
+  handle arm(time_point deadline,callback cb)
+  {
+    handle const h=wheel.arm(deadline,std::move(cb));
+    std::lock_guard<std::mutex> lk(m);
+    if(deadline<wake_at)
+    {
+      wake_at=deadline;
+      cond.notify_one();
+    }
+    return h;
+  }
+
+  handle arm_after(duration timeout,callback cb)
+  {
+    return arm(Clock::now()+timeout,std::move(cb));
+  }
+
+  bool cancel(handle h)
+  {
+    return wheel.cancel(h);
+  }
+
+  std::size_t size() { return wheel.size(); }
+
+  /**߳Ĵͬһʱ̵ڵĶʱֻһ*/
+  std::size_t wakeup_count() const { return wakeups.load(std::memory_order_relaxed); }
+};
+
+/*
+ȴfutureһûѽֹʱ佻ʱ֣ԻpromiseһǼǽֹʱ䣬
+ڻûж־ʹrequest_timeoutȴֱ߳get()Ҫʱȴ
+*/
+template<typename T>
+class deadline_promise
+{
+  struct shared_state
+  {
+    std::atomic<bool> satisfied{false};
+    std::promise<T> promise;
+  };
+
+  std::shared_ptr<shared_state> state;
+  std::function<void()> cancel_timer;
+
+public:
+  template<typename Timers>
+  deadline_promise(Timers& timers,typename Timers::time_point deadline):
+    state(std::make_shared<shared_state>())
+  {
+    std::weak_ptr<shared_state> const weak=state;
+    auto const h=timers.arm(deadline,[weak]
+    {
+      if(auto const s=weak.lock())
+        if(!s->satisfied.exchange(true))
+          s->promise.set_exception(std::make_exception_ptr(request_timeout()));
+    });
+    cancel_timer=[&timers,h]{timers.cancel(h);};
+  }
+
+  deadline_promise(deadline_promise&&)=default;
+  deadline_promise& operator=(deadline_promise&&)=default;
+
+  ~deadline_promise()
+  {
+    if(cancel_timer)
+      cancel_timer();
+  }
+
+  std::future<T> get_future() { return state->promise.get_future(); }
+
+  /**Ѿʱ򷵻falseֵ*/
+  bool set_value(T value)
+  {
+    if(state->satisfied.exchange(true))
+      return false;
+    state->promise.set_value(std::move(value));
+    cancel_timer();
+    cancel_timer=nullptr;
+    return true;
+  }
+};
+
+#endif // TIMER_WHEEL_H_INCLUDED
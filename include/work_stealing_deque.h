@@ -0,0 +1,175 @@
+#ifndef WORK_STEALING_DEQUE_H_INCLUDED
+#define WORK_STEALING_DEQUE_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "epoch_domain.h"
+
+/*
+εÿ߳һԼУԼеĵײҲӵײȡ
+(ȳղڻ)ԼĶпˣٴӱ̶߳еĶ͵һ
+(ϵͨҲһ)threadsafe_queue/threadsafe_stackÿβҪ
+work_stealing_dequeChaseCLev˫˶(L˸C++11ڴ汾)
+  push()/pop()ֻ߳(owner)ãûоʱֻͨĶдһseq_cst
+  steal()κ̵߳ãtopϵcompare_exchange˭õԪأ
+  ֻʣһԪʱpop()steal()compare_exchangetopֻһɹ
+ʱpush()һ飬ܻȡڶepoch_domainգ
+steal()pin()ı¶ȡ顣
+
+ԪбΪstd::atomic<T>ȡ߿ܶǵĲֵۣcompare_exchange
+ʧܺTҪƽƣָͨ±ꡣ
+*/
+
+template<typename T>
+class work_stealing_deque
+{
+  static_assert(std::is_trivially_copyable<T>::value,"work_stealing_deque holds trivially copyable values such as pointers");
+
+  struct buffer
+  {
+    std::int64_t const mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+
+    explicit buffer(std::int64_t capacity): mask(capacity-1),slots(new std::atomic<T>[capacity])
+    {}
+
+    std::int64_t capacity() const
+    {
+      return mask+1;
+    }
+
+    T get(std::int64_t i) const
+    {
+      return slots[i&mask].load(std::memory_order_relaxed);
+    }
+
+    void put(std::int64_t i,T value)
+    {
+      slots[i&mask].store(value,std::memory_order_relaxed);
+    }
+  };
+
+  alignas(64) std::atomic<std::int64_t> top{0};     // ȡߴȡֻ
+  alignas(64) std::atomic<std::int64_t> bottom{0};  // ֻownerд
+  std::atomic<buffer*> array;
+  epoch_domain reclaim;
+
+  buffer* grow(buffer* old,std::int64_t t,std::int64_t b)
+  {
+    buffer* const bigger=new buffer(old->capacity()*2);
+    for(std::int64_t i=t;i<b;++i)
+      bigger->put(i,old->get(i));
+    array.store(bigger,std::memory_order_release);  // 1 ֮ȡ߶ʱҲõƵԪ
+    reclaim.retire(old);  // [t,b)ݲٸı䣬ڶȡõֵȻȷ
+    return bigger;
+  }
+
+public:
+  enum class steal_result
+  {
+    stolen,
+    empty,
+    lost_race  // ȡ߻ownerͬһԪʧܣԻһ
+  };
+
+  /**initial_capacityȡΪ2*/
+  explicit work_stealing_deque(std::size_t initial_capacity=64)
+  {
+    std::int64_t capacity=2;
+    while(capacity<std::int64_t(initial_capacity))
+      capacity*=2;
+    array.store(new buffer(capacity),std::memory_order_relaxed);
+  }
+
+  work_stealing_deque(work_stealing_deque const&)=delete;
+  work_stealing_deque& operator=(work_stealing_deque const&)=delete;
+
+  /**÷֤ʱû߳ʹ*/
+  ~work_stealing_deque()
+  {
+    delete array.load(std::memory_order_relaxed);
+  }
+
+  /**ֻowner*/
+  void push(T value)
+  {
+    std::int64_t const b=bottom.load(std::memory_order_relaxed);
+    std::int64_t const t=top.load(std::memory_order_acquire);
+    buffer* a=array.load(std::memory_order_relaxed);
+    if(b-t>=a->capacity())
+      a=grow(a,t,b);
+    a->put(b,value);
+    bottom.store(b+1,std::memory_order_release);  // 2 steal()bottomԣȡ߿õдԪ
+  }
+
+  /**ֻownerãӵײȡpush()ԪأΪʱfalse*/
+  bool pop(T& value)
+  {
+    std::int64_t const b=bottom.load(std::memory_order_relaxed)-1;
+    buffer* const a=array.load(std::memory_order_relaxed);
+    bottom.store(b,std::memory_order_seq_cst);  // 3 ռסbٶtopsteal()ȶtopٶbottomDekkerʽ
+    std::int64_t t=top.load(std::memory_order_seq_cst);
+    if(t>b)  // Ѿ
+    {
+      bottom.store(b+1,std::memory_order_relaxed);
+      return false;
+    }
+    value=a->get(b);
+    if(t<b)  // ʣֹһȡb
+      return true;
+    bool const won=top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);  // 4 һԪأȡ
+    bottom.store(b+1,std::memory_order_relaxed);
+    return won;
+  }
+
+  /**κ̶߳ԵãӶȡpush()Ԫ*/
+  steal_result steal(T& value)
+  {
+    std::int64_t t=top.load(std::memory_order_seq_cst);
+    std::int64_t const b=bottom.load(std::memory_order_seq_cst);
+    if(t>=b)
+      return steal_result::empty;
+    auto const guard=reclaim.pin();  // 5 ownerͬʱ飬pin()֮鲻ᱻͷ
+    T const candidate=array.load(std::memory_order_acquire)->get(t);
+    if(!top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed))
+      return steal_result::lost_race;
+    value=candidate;
+    return steal_result::stolen;
+  }
+
+  /**steal()ֱɹΪ*/
+  bool try_steal(T& value)
+  {
+    for(;;)
+    {
+      steal_result const r=steal(value);
+      if(r!=steal_result::lost_race)
+        return r==steal_result::stolen;
+    }
+  }
+
+  /**ֵ߳̿ͬʱ޸*/
+  std::size_t size() const
+  {
+    std::int64_t const b=bottom.load(std::memory_order_relaxed);
+    std::int64_t const t=top.load(std::memory_order_relaxed);
+    return b>t ? std::size_t(b-t) : 0;
+  }
+
+  bool empty() const
+  {
+    return size()==0;
+  }
+
+  /**ǰֻowner*/
+  std::size_t capacity() const
+  {
+    return std::size_t(array.load(std::memory_order_relaxed)->capacity());
+  }
+};
+
+#endif // WORK_STEALING_DEQUE_H_INCLUDED